@@ -19,6 +19,8 @@
 # CONFIG+=rtmidi     To build with RtMidi support
 # CONFIG+=record_support
 # CONFIG+=debugger
+# CONFIG+=debug_rt_alloc   To report heap allocations made in the invalue/outvalue callbacks
+# CONFIG+=debug_structure_index   To check the editor's structure index against a full rebuild after each edit
 # To support HTML5 via the <html> element in the csd using the Qt WebEngine
 # (preferably use Qt 5.8 or later):
 # CONFIG+=html_webengine
@@ -61,6 +63,16 @@ debugger {
 }
 message("Building for Csound 6.")
 
+debug_rt_alloc {
+    DEFINES += QCS_DEBUG_RT_ALLOC
+    message("Counting operator new calls in value callbacks.")
+}
+
+debug_structure_index {
+    DEFINES += QCS_DEBUG_STRUCTURE_INDEX
+    message("Checking the structure index after each edit.")
+}
+
 
 QT += concurrent network widgets printsupport
 DEFINES += USE_QT5
@@ -68,40 +68,8 @@ BaseDocument::~BaseDocument()
 
 /* Returns the number of panels
  */
-int BaseDocument::parseAndRemoveWidgetText(QString &text)
+int BaseDocument::loadWidgetPanels(const QStringList &xmlPanels, const QString &presets)
 {
-
-	QStringList xmlPanels;
-    while(true) {
-        auto panelStart = text.indexOf("<bsbPanel");
-        if(panelStart < 0) {
-            QDEBUG "Didn't find any more panels";
-            break;
-        }
-        auto panelEnd = text.indexOf("</bsbPanel>", panelStart);
-        if(panelEnd < 0) {
-            QDEBUG << "Did not find matching </bsbPanel> tag";
-            return 0;
-        }
-        auto panel = text.mid(panelStart, panelEnd+11-panelStart);
-        xmlPanels << panel;
-        text.remove(panelStart, panelEnd+11-panelStart);
-
-    }
-    /*
-    while (text.contains("<bsbPanel") && text.contains("</bsbPanel>")) {
-		QString panel = text.right(text.size()-text.indexOf("<bsbPanel"));
-		panel.resize(panel.indexOf("</bsbPanel>") + 11);
-        if (text.indexOf("</bsbPanel>") + 11 < text.size() &&
-                text[text.indexOf("</bsbPanel>") + 13] == '\n')
-			text.remove(text.indexOf("</bsbPanel>") + 13, 1); //remove final line break
-        if (text.indexOf("<bsbPanel") > 0 && text[text.indexOf("<bsbPanel") - 1] == '\n')
-			text.remove(text.indexOf("<bsbPanel") - 1, 1); //remove initial line break
-		text.remove(text.indexOf("<bsbPanel"), panel.size());
-		xmlPanels << panel;
-		// TODO enable creation of several panels
-	}
-    */
 	if (!xmlPanels.isEmpty()) {
 		//FIXME allow multiple layouts
         auto t0 = std::chrono::high_resolution_clock::now();
@@ -109,46 +77,15 @@ int BaseDocument::parseAndRemoveWidgetText(QString &text)
         auto t1 = std::chrono::high_resolution_clock::now();
         auto diff = std::chrono::duration<double, std::milli>(t1-t0).count();
         QDEBUG << "loadXmlWidgets" << diff << "ms";
-
-        m_widgetLayouts[0]->markHistory();
-        auto presetsStart = text.indexOf("<bsbPresets>");
-        if(presetsStart >= 0) {
-            auto presetsEnd = text.indexOf("</bsbPresets>", presetsStart);
-            if(presetsEnd < 0) {
-                QDEBUG << "Missing </bsbPresets> tag";
-            }
-            else {
-                auto presetsSize = presetsEnd - presetsStart + 13;
-                auto presets = text.mid(presetsStart, presetsSize);
-                m_widgetLayouts[0]->loadXmlPresets(presets);
-                text.remove(presetsStart, presetsSize);
-            }
-        }
-        /*
-        if (text.contains("<bsbPresets>") && text.contains("</bsbPresets>")) {
-			QString presets = text.right(text.size()-text.indexOf("<bsbPresets>"));
-			presets.resize(presets.indexOf("</bsbPresets>") + 13);
-            if (text.indexOf("</bsbPresets>") + 13 < text.size() &&
-                    text[text.indexOf("</bsbPresets>") + 15] == '\n') {
-                //remove final line break
-                text.remove(text.indexOf("</bsbPresets>") + 15, 1);
-            }
-            if (text.indexOf("<bsbPresets>") > 0
-                    && text[text.indexOf("<bsbPresets>") - 1] == '\n') {
-                // remove initial line break
-                text.remove(text.indexOf("<bsbPresets>") - 1, 1);
-            }
-			text.remove(text.indexOf("<bsbPresets>"), presets.size());
-            // FIXME allow multiple
-			m_widgetLayouts[0]->loadXmlPresets(presets);
-		}
-        */
     }
     else {
         QString defaultPanel = "<bsbPanel><visible>true</visible><x>100</x><y>100</y>"
                                "<width>320</width><height>240</height></bsbPanel>";
 		m_widgetLayouts[0]->loadXmlWidgets(defaultPanel);
-		m_widgetLayouts[0]->markHistory();
+	}
+	m_widgetLayouts[0]->markHistory();
+	if (!presets.isEmpty()) {
+		m_widgetLayouts[0]->loadXmlPresets(presets);
 	}
 	return xmlPanels.size();
 }
@@ -184,7 +121,7 @@ void BaseDocument::setAppProperties(AppProperties properties)
 QString BaseDocument::getFullText()
 {
     QStringList parts;
-    parts << m_view->getFullText();
+    parts << spliceExternalScore(m_view->getFullText());
     if (fileName.endsWith(".csd",Qt::CaseInsensitive) || fileName == "") {
         parts << getWidgetsText() ;
         parts << getPresetsText() << "\n";
@@ -201,7 +138,7 @@ QString BaseDocument::getFullText()
 QString BaseDocument::getBasicText()
 {
 	QString text = m_view->getBasicText();
-	return text;
+	return spliceExternalScore(text);
 }
 
 QString BaseDocument::getOrc()
@@ -213,6 +150,38 @@ QString BaseDocument::getOrc()
 QString BaseDocument::getSco()
 {
 	QString text = m_view->getSco();
+	if (!m_externalScore.isEmpty()) {
+		if (text.startsWith(m_externalScoreStub)) {
+			text.remove(0, m_externalScoreStub.size());
+		}
+		text.prepend(m_externalScore);
+	}
+	return text;
+}
+
+void BaseDocument::setExternalScore(QString score, QString stub)
+{
+	m_externalScore = score;
+	m_externalScoreStub = stub;
+}
+
+QString BaseDocument::spliceExternalScore(QString text)
+{
+	if (m_externalScore.isEmpty()) {
+		return text;
+	}
+	int scoreTag = text.indexOf("<CsScore");
+	int bodyStart = scoreTag >= 0 ? text.indexOf('>', scoreTag) + 1 : 0;
+	if (bodyStart <= 0) {
+		QDEBUG << "<CsScore> section not found, external score not included";
+		return text;
+	}
+	if (text.midRef(bodyStart, m_externalScoreStub.size()) == m_externalScoreStub) {
+		text.replace(bodyStart, m_externalScoreStub.size(), m_externalScore);
+	}
+	else {
+		text.insert(bodyStart, m_externalScore);
+	}
 	return text;
 }
 
@@ -333,9 +302,14 @@ void BaseDocument::stopRecording()
 	m_csEngine->stopRecording();
 }
 
-void BaseDocument::queueEvent(QString eventLine, int delay)
+void BaseDocument::queueEvent(QString eventLine, double delay, int tag)
+{
+	m_csEngine->queueEvent(eventLine, delay, tag);
+}
+
+void BaseDocument::cancelEvents(int tag)
 {
-	m_csEngine->queueEvent(eventLine, delay);  //TODO  implement passing of timestamp
+	m_csEngine->cancelEvents(tag);
 }
 
 void BaseDocument::loadTextString(QString &text)
@@ -47,7 +47,7 @@ public:
 	virtual int setTextString(QString &text) = 0;
 	virtual void loadTextString(QString &text);
 	virtual void setFileName(QString name);
-	int parseAndRemoveWidgetText(QString &text);
+	int loadWidgetPanels(const QStringList &xmlPanels, const QString &presets);
 	virtual WidgetLayout* newWidgetLayout();
 	void widgetsVisible(bool visible);
 	void setFlags(int flags);
@@ -58,6 +58,10 @@ public:
 	QString getSco();
 	QString getOptionsText();
 	QString getWidgetsText();
+	// Score kept out of the editor for very large files. It is spliced back
+	// into getFullText(), getBasicText() and getSco()
+	void setExternalScore(QString score, QString stub);
+	bool hasExternalScore() { return !m_externalScore.isEmpty(); }
 	QString getPresetsText();
 	AppProperties getAppProperties();
 	//    void setOpcodeNameList(QStringList opcodeNameList);
@@ -80,10 +84,12 @@ public slots:
 	void stopRecording();
 	//    void playParent(); // Triggered from button, ask parent for options
 	//    void renderParent();
-	void queueEvent(QString line, int delay = 0);
+	void queueEvent(QString line, double delay = 0, int tag = 0); // delay in seconds
+	void cancelEvents(int tag);
 	virtual void registerButton(QuteButton *button) = 0;
 protected:
 	virtual void init(QWidget *parent, OpEntryParser *opcodeTree) = 0;
+	QString spliceExternalScore(QString text);
 	//    virtual BaseView *createView(QWidget *parent, O8pEntryParser *opcodeTree);
 	QString fileName;
 	QList<WidgetLayout *> m_widgetLayouts;
@@ -93,6 +99,8 @@ protected:
 	CsoundEngine *m_csEngine;
     PlayStopStatus m_status;
     QMutex mutex;
+	QString m_externalScore;
+	QString m_externalScoreStub;
 
 };
 
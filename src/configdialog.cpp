@@ -213,6 +213,7 @@ ConfigDialog::ConfigDialog(CsoundQt *parent, Options *options, ConfigLists *conf
 	fontOffsetSpinBox->setValue(m_options->fontOffset);
     tabShortcutActiveCheckBox->setChecked(m_options->tabShortcutActive);
     highlightScoreCheckBox->setChecked(m_options->highlightScore);
+    externalScoreCheckBox->setChecked(m_options->externalScore);
 
 	if (m_options->useAPI)
 		ApiRadioButton->setChecked(true);
@@ -632,6 +633,7 @@ void ConfigDialog::accept()
 	m_options->csdTemplate = templateTextEdit->toPlainText();
     m_options->checkSyntaxBeforeRun = checkSyntaxBeforeRunCheckBox->isChecked();
     m_options->highlightScore = highlightScoreCheckBox->isChecked();
+    m_options->externalScore = externalScoreCheckBox->isChecked();
 
 	//  emit(changeFont());
 	QDialog::accept();
@@ -26,17 +26,29 @@
 #include <QtWidgets>
 
 
-Console::Console(QWidget *parent) : QTextEdit(parent)
+Console::Console(QWidget *parent) : QPlainTextEdit(parent)
 {
 	error = false;
 	errorLine = false;
 	setReadOnly(true);
+	setLineLimit(QCS_CONSOLE_MAX_LINES);
     m_warningColor = QColor("orange");
     rxerr.setPattern("^\\s*error:\\.+line\\ ");
+
+	m_findEdit = new QLineEdit(this);
+	m_findEdit->setPlaceholderText(tr("Find"));
+	m_findEdit->hide();
+	connect(m_findEdit, SIGNAL(textEdited(QString)), this, SLOT(findIncremental(QString)));
+	connect(m_findEdit, SIGNAL(returnPressed()), this, SLOT(findNext()));
+	QShortcut *escape = new QShortcut(QKeySequence(Qt::Key_Escape), m_findEdit);
+	escape->setContext(Qt::WidgetShortcut);
+	connect(escape, SIGNAL(activated()), this, SLOT(hideFind()));
+	FrameScheduler::instance()->addClient(this);
 }
 
 Console::~Console()
 {
+	FrameScheduler::instance()->removeClient(this);
 	disconnect(this, 0,0,0);
 }
 
@@ -44,6 +56,17 @@ void Console::appendMessage(QString msg)
 {
     QMutexLocker locker(&consoleLock);
 	logMessage(msg);
+	m_pendingText += msg;
+}
+
+void Console::flushMessages()
+{
+    QMutexLocker locker(&consoleLock);
+    if (m_pendingText.isEmpty()) {
+        return;
+    }
+    QString msg = m_pendingText;
+    m_pendingText.clear();
 
     /*
     // Filter unnecessary messages
@@ -55,59 +78,92 @@ void Console::appendMessage(QString msg)
 	}
     */
 
-	setTextColor(m_textColor);
-    // if "unexpected token error", remove this newline, otherwise line number stays
-    // in next messageLine
-    if ( msg.contains("(token") )
-		msg.remove("\n");
-	messageLine.append(msg);
-
-    // if (msg.contains("\n")) {
-    if(msg.lastIndexOf(QChar('\n')) >= 0) {
-        // line finished, analyze it now
-        if(rxerr.match(messageLine).hasMatch()) {
-            errorTexts.append(messageLine);
-			errorTexts.last().remove("\n");
-
-			QStringList parts = messageLine.split("line "); // get the line number
-            QString lnr = parts.last().remove(">>>");
-			lnr = lnr.remove(":");
-			lnr = lnr.trimmed();
-			errorLines.append(lnr.toInt());
-			qDebug() << "error line appended --- " << lnr.toInt();
+    // msg can hold everything received during a frame. Each finished line is
+    // classified on its own, but they are all inserted in one edit block.
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    bool editing = false;
+    int start = 0;
+    while (start < msg.size()) {
+        int end = msg.indexOf(QChar('\n'), start);
+        if (end < 0) {
+            messageLine.append(msg.midRef(start));
+            break;
         }
-        else if (messageLine.contains("Line:", Qt::CaseSensitive))  {
-            // as in type erroris in csound6 like  'Line: 54 Loc: 1'
-            errorTexts.append("Error");
-            QStringList parts = messageLine.split(" ");  // get the line number
-            QString lnr = parts[1];                      // 2nd element in the array
-            errorLines.append(lnr.toInt());
-            qDebug() << "error line appended --- " << lnr.toInt();
+        QString line = msg.mid(start, end + 1 - start);
+        start = end + 1;
+        // if "unexpected token error", remove this newline, otherwise line number stays
+        // in next messageLine
+        if (line.contains("(token")) {
+            line.remove("\n");
+            messageLine.append(line);
+            continue;
         }
-        else if (messageLine.startsWith("B ")
-                || messageLine.contains("rtevent", Qt::CaseInsensitive)
-                ||  messageLine.contains("evaluated", Qt::CaseInsensitive)) {
-            setTextColor(QColor("#4040FF"));
-		}
-        else if (messageLine.contains("overall samples out of range")
-                || messageLine.contains("disabled")
-                || messageLine.contains("error", Qt::CaseInsensitive)
-                || messageLine.contains("Found:")
-                || messageLine.contains("Line:")) { // any error
-            setTextColor(m_errorColor);
-		}
-        else if (messageLine.contains("warning", Qt::CaseInsensitive)) {
-            setTextColor(m_warningColor);
-		}
-        else if(messageLine.contains("sread: unexpected char")) {
-            // score error
-            setTextColor(m_errorColor);
+        messageLine.append(line);
+        // line finished, analyze it now
+        if (!editing) {
+            cursor.beginEditBlock();
+            editing = true;
         }
-		insertPlainText(messageLine);
-		setTextColor(m_textColor);
-		moveCursor(QTextCursor::End);
-		messageLine.clear();
+        QTextCharFormat format;
+        QColor color = lineColor(messageLine);
+        if (color.isValid()) {
+            format.setForeground(color);
+        }
+        cursor.insertText(messageLine, format);
+        messageLine.clear();
+    }
+    if (editing) {
+        cursor.endEditBlock();
+        moveCursor(QTextCursor::End);
+    }
+}
+
+QColor Console::lineColor(const QString &line)
+{
+    // Also records the error lines found
+    if(rxerr.match(line).hasMatch()) {
+        QStringList parts = line.split("line "); // get the line number
+        QString lnr = parts.last().remove(">>>");
+        lnr = lnr.remove(":");
+        lnr = lnr.trimmed();
+        addError(lnr.toInt(), QString(line).remove("\n"));
+        qDebug() << "error line appended --- " << lnr.toInt();
+    }
+    else if (line.contains("Line:", Qt::CaseSensitive))  {
+        // as in type erroris in csound6 like  'Line: 54 Loc: 1'
+        QStringList parts = line.split(" ");  // get the line number
+        QString lnr = parts.value(1);         // 2nd element in the array
+        addError(lnr.toInt(), "Error");
+        qDebug() << "error line appended --- " << lnr.toInt();
+    }
+    else if (line.startsWith("B ")
+            || line.contains("rtevent", Qt::CaseInsensitive)
+            ||  line.contains("evaluated", Qt::CaseInsensitive)) {
+        return QColor("#4040FF");
+    }
+    else if (line.contains("overall samples out of range")
+            || line.contains("disabled")
+            || line.contains("error", Qt::CaseInsensitive)
+            || line.contains("Found:")) { // any error
+        return m_errorColor;
+    }
+    else if (line.contains("warning", Qt::CaseInsensitive)) {
+        return m_warningColor;
+    }
+    else if(line.contains("sread: unexpected char")) {
+        // score error
+        return m_errorColor;
+    }
+    return m_textColor;
+}
+
+void Console::addError(int line, QString text)
+{
+	if (m_errors.size() >= QCS_CONSOLE_MAX_ERRORS) {
+		m_errors.removeFirst();
 	}
+	m_errors.append(QPair<int, QString>(line, text));
 }
 
 void Console::setDefaultFont(QFont font)
@@ -122,7 +178,7 @@ void Console::setColors(QColor textColor, QColor bgColor)
     // foreground on light background or the other way around)
 
     // before it was setPalette, but that does not work runtime.
-    auto sheet = QString("QTextEdit { color: %1; background-color: %2 }"
+    auto sheet = QString("QPlainTextEdit { color: %1; background-color: %2 }"
                          ).arg(textColor.name(), bgColor.name());
     this->setStyleSheet(sheet);
 	m_textColor = textColor;
@@ -141,12 +197,77 @@ void Console::setColors(QColor textColor, QColor bgColor)
 
 void Console::reset()
 {
+	consoleLock.lock();
+	m_pendingText.clear();
+	consoleLock.unlock();
 	clear();
-	errorLines.clear();
-	errorTexts.clear();
+	m_errors.clear();
 	error = false;
 }
 
+void Console::setLineLimit(int lines)
+{
+	// The document drops its first blocks when it grows past this
+	document()->setMaximumBlockCount(lines);
+}
+
+void Console::showFind()
+{
+	m_findEdit->show();
+	m_findEdit->selectAll();
+	m_findEdit->setFocus();
+	placeFindEdit();
+}
+
+void Console::hideFind()
+{
+	m_findEdit->hide();
+	setFocus();
+}
+
+void Console::findIncremental(const QString &text)
+{
+	// Search again from the start of the current match, so typing more
+	// characters narrows the match in place
+	QTextCursor cursor = textCursor();
+	cursor.setPosition(cursor.selectionStart());
+	setTextCursor(cursor);
+	if (!text.isEmpty() && !find(text)) {
+		// Wrap around
+		cursor.movePosition(QTextCursor::Start);
+		setTextCursor(cursor);
+		find(text);
+	}
+}
+
+void Console::findNext()
+{
+	QString text = m_findEdit->text();
+	if (!text.isEmpty() && !find(text)) {
+		QTextCursor cursor = textCursor();
+		cursor.movePosition(QTextCursor::Start);
+		setTextCursor(cursor);
+		find(text);
+	}
+}
+
+void Console::resizeEvent(QResizeEvent *event)
+{
+	QPlainTextEdit::resizeEvent(event);
+	placeFindEdit();
+}
+
+void Console::placeFindEdit()
+{
+	// Bottom right corner of the text area
+	if (m_findEdit->isVisible()) {
+		QRect r = viewport()->geometry();
+		int w = qMin(200, r.width());
+		int h = m_findEdit->sizeHint().height();
+		m_findEdit->setGeometry(r.right() - w, r.bottom() - h, w, h);
+	}
+}
+
 void Console::scrollToEnd()
 {
 	moveCursor(QTextCursor::End);
@@ -160,6 +281,7 @@ void Console::setKeyRepeatMode(bool repeat)
 void Console::contextMenuEvent(QContextMenuEvent *event)
 {
 	QMenu *menu = createStandardContextMenu();
+	menu->addAction(tr("Find..."), this, SLOT(showFind()));
 	menu->addAction("Clear", this, SLOT(reset()));
 	menu->exec(event->globalPos());
 	delete menu;
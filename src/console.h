@@ -23,12 +23,23 @@
 #ifndef CONSOLE_H
 #define CONSOLE_H
 
-#include <QTextEdit>
+#include <QPlainTextEdit>
 #include <QDockWidget>
 #include <QtGui>
 
+#include "framescheduler.h"
 
-class Console : public QTextEdit
+// Lines kept by a console, older ones are dropped as new ones arrive
+#define QCS_CONSOLE_MAX_LINES 20000
+// Error lines kept for the editor, independent of the lines displayed
+#define QCS_CONSOLE_MAX_ERRORS 1000
+
+class QLineEdit;
+
+// Plain text console. Only the visible lines are laid out and painted, and
+// the document holds at most QCS_CONSOLE_MAX_LINES lines. Messages are
+// inserted once per frame, however often they arrive.
+class Console : public QPlainTextEdit, public FrameClient
 {
 	Q_OBJECT
 public:
@@ -40,19 +51,31 @@ public:
 	virtual void setColors(QColor textColor, QColor bgColor);
 	void scrollToEnd();
 	void setKeyRepeatMode(bool repeat);
+	void setLineLimit(int lines);
 	//     void refresh();
 
-	QList<int> errorLines;
-	QStringList errorTexts;
+	// Line number and text of the errors found, oldest first
+	QList<QPair<int, QString> > errors() { flushMessages(); return m_errors; }
+	void flushMessages();
+
+	// FrameClient
+	bool frameVisible() { return isVisible(); }
+	void updateFrame() { flushMessages(); }
 
 public slots:
 	virtual void appendMessage(QString msg);
 	void reset();
+	void showFind();
+	void hideFind();
 
 protected:
 	virtual void contextMenuEvent(QContextMenuEvent *event);
 	virtual void keyPressEvent(QKeyEvent *event);
 	virtual void keyReleaseEvent(QKeyEvent *event);
+	virtual void resizeEvent(QResizeEvent *event);
+	QColor lineColor(const QString &line);
+	void addError(int line, QString text);
+	void placeFindEdit();
 
 	bool error;
 	bool errorLine;
@@ -65,9 +88,17 @@ protected:
 
 	bool m_repeatKeys;
     QMutex consoleLock;
+	QString m_pendingText; // Messages not inserted yet
 
     QRegularExpression rxerr;
 
+	QList<QPair<int, QString> > m_errors;
+	QLineEdit *m_findEdit;
+
+protected slots:
+	void findIncremental(const QString &text);
+	void findNext();
+
 signals:
 	void keyPressed(int key);
 	void keyReleased(int key);
@@ -102,7 +133,6 @@ public:
 	ConsoleWidget(QWidget * parent = 0): Console(parent)
 	{
 		setReadOnly(true);
-		setFontItalic(false);
 #ifdef Q_OS_MACOS
         document()->setDefaultFont(QFont("Courier New", 10));
 #else
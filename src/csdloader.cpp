@@ -0,0 +1,171 @@
+/*
+	Copyright (C) 2026 The CsoundQt contributors
+
+	This file is part of CsoundQt.
+
+	CsoundQt is free software; you can redistribute it
+	and/or modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	CsoundQt is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with Csound; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+	02111-1307 USA
+*/
+
+#include "csdloader.h"
+
+#include <QFile>
+#include <QTextCodec>
+#include <QTextDecoder>
+#include <QCoreApplication>
+#include <cstring>
+
+static void appendDecoded(QString &text, QTextDecoder &decoder, const char *begin, const char *end)
+{
+	if (end <= begin)
+		return;
+	QString decoded = decoder.toUnicode(begin, end - begin);
+	if (memchr(begin, '\r', end - begin) != 0) {
+		decoded.replace("\r\n", "\n");
+		decoded.replace('\r', '\n');
+	}
+	text += decoded;
+}
+
+bool CsdLoader::readFile(QString fileName, QString &text, QString *errorString)
+{
+	QFile file(fileName);
+	if (!file.open(QFile::ReadOnly)) {
+		if (errorString)
+			*errorString = file.errorString();
+		return false;
+	}
+	qint64 size = file.size();
+	uchar *mapped = size > 0 ? file.map(0, size) : 0;
+	if (mapped) {
+		text = decode(reinterpret_cast<const char *>(mapped), size);
+		file.unmap(mapped);
+	}
+	else { // Compressed resources and files that can't be mapped
+		QByteArray data = file.readAll();
+		text = decode(data.constData(), data.size());
+	}
+	return true;
+}
+
+QString CsdLoader::decode(const char *data, qint64 size)
+{
+	// Text is decoded in runs of lines, only <CsFileB> sections are split off
+	QString text;
+	text.reserve(size);
+	QTextDecoder decoder(QTextCodec::codecForLocale());
+	const char *end = data + size;
+	const char *runStart = data;
+	const char *pos = data;
+	bool inFileB = false;
+	while (pos < end) {
+		const char *lineEnd = static_cast<const char *>(memchr(pos, '\n', end - pos));
+		lineEnd = lineEnd ? lineEnd + 1 : end;
+		QByteArray line = QByteArray::fromRawData(pos, lineEnd - pos);
+		if (!inFileB && line.contains("<CsFileB ")) {
+			appendDecoded(text, decoder, runStart, pos);
+			runStart = pos;
+			inFileB = true;
+		}
+		pos = lineEnd;
+		if (inFileB && line.contains("</CsFileB>")) {
+			text += QString::fromLatin1(runStart, pos - runStart);
+			runStart = pos;
+			inFileB = false;
+		}
+	}
+	if (inFileB) {
+		text += QString::fromLatin1(runStart, end - runStart);
+	}
+	else {
+		appendDecoded(text, decoder, runStart, end);
+	}
+	if (!text.isEmpty() && !text.endsWith('\n')) {
+		text += '\n';
+	}
+	return text;
+}
+
+CsdParts CsdLoader::split(const QString &text, int externalScoreLines)
+{
+	CsdParts parts;
+	parts.text.reserve(text.size());
+	int copied = 0; // Text before this index has been handled
+	int pos = text.indexOf('<');
+	while (pos >= 0) {
+		QStringRef tag = text.midRef(pos);
+		int end = -1; // End of the section to take out of the text
+		if (tag.startsWith(QLatin1String("<bsbPanel"))) {
+			end = text.indexOf("</bsbPanel>", pos);
+			if (end >= 0) {
+				end += 11;
+				parts.panels << text.mid(pos, end - pos);
+			}
+		}
+		else if (tag.startsWith(QLatin1String("<bsbPresets>"))) {
+			end = text.indexOf("</bsbPresets>", pos);
+			if (end >= 0) {
+				end += 13;
+				if (parts.presets.isEmpty()) {
+					parts.presets = text.mid(pos, end - pos);
+				}
+			}
+		}
+		else if (tag.startsWith(QLatin1String("<EventPanel"))) {
+			end = text.indexOf("</EventPanel>", pos);
+			if (end >= 0) {
+				end += 13;
+				parts.eventPanels << text.mid(pos, end - pos);
+				if (end < text.size() && text[end] == '\n') {
+					end++;
+				}
+			}
+		}
+		else if (tag.startsWith(QLatin1String("<CsScore"))) {
+			// Score bodies are not searched for other sections
+			int bodyStart = text.indexOf('>', pos) + 1;
+			int bodyEnd = bodyStart > 0 ? text.indexOf("</CsScore>", bodyStart) : -1;
+			if (bodyEnd < 0) { // Unterminated, the rest is still searched
+				pos = text.indexOf('<', pos + 1);
+				continue;
+			}
+			int lines = externalScoreLines > 0 ?
+						text.midRef(bodyStart, bodyEnd - bodyStart).count('\n') : 0;
+			if (parts.externalScore.isEmpty() && lines > externalScoreLines) {
+				parts.text += text.midRef(copied, bodyStart - copied);
+				parts.externalScore = text.mid(bodyStart, bodyEnd - bodyStart);
+				parts.externalScoreLines = lines;
+				parts.scoreStub = "\n"
+						+ QCoreApplication::translate("CsdLoader",
+							"; %1 score lines are kept out of the editor (read only).\n"
+							"; They are played and saved before any lines added here.\n")
+						.arg(lines);
+				parts.text += parts.scoreStub;
+				copied = bodyEnd;
+			}
+			pos = text.indexOf('<', bodyEnd + 1);
+			continue;
+		}
+		if (end < 0) {
+			pos = text.indexOf('<', pos + 1);
+			continue;
+		}
+		parts.text += text.midRef(copied, pos - copied);
+		copied = end;
+		pos = text.indexOf('<', end);
+	}
+	parts.text += text.midRef(copied);
+	return parts;
+}
@@ -0,0 +1,56 @@
+/*
+	Copyright (C) 2026 The CsoundQt contributors
+
+	This file is part of CsoundQt.
+
+	CsoundQt is free software; you can redistribute it
+	and/or modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	CsoundQt is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with Csound; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+	02111-1307 USA
+*/
+
+#ifndef CSDLOADER_H
+#define CSDLOADER_H
+
+#include <QString>
+#include <QStringList>
+
+// Parts of a csd that are not shown in the text editor
+struct CsdParts {
+	CsdParts() : externalScoreLines(0) {}
+	QString text;  // What goes into the editor
+	QStringList panels;  // <bsbPanel> sections
+	QString presets;  // <bsbPresets> section
+	QStringList eventPanels;  // <EventPanel> sections
+	QString externalScore;  // Score body kept out of the editor (empty if none)
+	QString scoreStub;  // Text left in the editor in place of the external score
+	int externalScoreLines;
+};
+
+// Reading and splitting of csd files in a single pass, so that files with
+// millions of lines don't go through repeated indexOf()/remove() calls.
+class CsdLoader
+{
+public:
+	// Reads a file through a memory map (falling back to readAll() when the
+	// file can't be mapped), normalizing line endings. Embedded <CsFileB>
+	// sections are kept as they are.
+	static bool readFile(QString fileName, QString &text, QString *errorString = 0);
+	static QString decode(const char *data, qint64 size);
+	// Extracts widget panels, presets and live event panels from text.
+	// If externalScoreLines > 0, a <CsScore> body longer than that is
+	// also taken out and replaced by a short comment.
+	static CsdParts split(const QString &text, int externalScoreLines = 0);
+};
+
+#endif // CSDLOADER_H
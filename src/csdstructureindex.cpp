@@ -0,0 +1,709 @@
+/*
+	Copyright (C) 2026 The CsoundQt contributors
+
+	This file is part of CsoundQt.
+
+	CsoundQt is free software; you can redistribute it
+	and/or modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	CsoundQt is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with Csound; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+	02111-1307 USA
+*/
+
+#include "csdstructureindex.h"
+
+#include <QTextBlock>
+#include <QSet>
+
+// Removes ; and // comments that are not inside a string
+static QString stripComment(const QString &text)
+{
+	bool inString = false;
+	for (int i = 0; i < text.size(); i++) {
+		QChar c = text.at(i);
+		if (c == '"') {
+			inString = !inString;
+		}
+		else if (!inString) {
+			if (c == ';' || (c == '/' && i + 1 < text.size() && text.at(i + 1) == '/')) {
+				return text.left(i);
+			}
+		}
+	}
+	return text;
+}
+
+static bool startsWithWord(const QString &text, const QString &word)
+{
+	if (!text.startsWith(word))
+		return false;
+	return text.size() == word.size() || !(text.at(word.size()).isLetterOrNumber()
+										  || text.at(word.size()) == '_');
+}
+
+static int sectionFromTag(const QString &tag)
+{
+	if (tag == "CsOptions")
+		return CsdStructureIndex::OptionsSection;
+	if (tag == "CsInstruments")
+		return CsdStructureIndex::InstrumentsSection;
+	if (tag == "CsScore")
+		return CsdStructureIndex::ScoreSection;
+	if (tag.compare("html", Qt::CaseInsensitive) == 0)
+		return CsdStructureIndex::HtmlSection;
+	return CsdStructureIndex::NoSection;
+}
+
+CsdStructureIndex::CsdStructureIndex(QObject *parent) :
+	QObject(parent), m_structureDirty(true), m_wordsDirty(true)
+{
+	rxWordSplit = QRegularExpression("[" + QRegularExpression::escape("+-*/=#&,\"\'|[]()<>.;:^") + "\\s]");
+	rxSectionTag = QRegularExpression("<(/?)(CsOptions|CsInstruments|CsScore|html)\\b[^>]*>",
+									  QRegularExpression::CaseInsensitiveOption);
+	rxInstr = QRegularExpression("^\\s*instr\\s+(.+?)\\s*$");
+	rxOpcode = QRegularExpression("^\\s*opcode\\s+(\\w+)\\s*,\\s*(.*?)\\s*$");
+	rxLabel = QRegularExpression("^\\s*([A-Za-z_]\\w*):(?=\\s|$)");
+	rxDefine = QRegularExpression("^\\s*#define\\s+(\\w+)");
+	// outputs (optionally typed or arrays), then = or an opcode name
+	rxDeclaration = QRegularExpression(
+				"^\\s*((?:[A-Za-z_]\\w*(?::\\w+)?(?:\\[\\])*\\s*,\\s*)*[A-Za-z_]\\w*(?::\\w+)?(?:\\[\\])*)"
+				"(?:\\s*=(?!=)|\\s+[A-Za-z_]\\w*(?::\\w+)?(?=[\\s(]|$))");
+	rxOutputSplit = QRegularExpression("\\s*,\\s*");
+	rxWordSplit.optimize();
+	rxSectionTag.optimize();
+	rxInstr.optimize();
+	rxOpcode.optimize();
+	rxLabel.optimize();
+	rxDefine.optimize();
+	rxDeclaration.optimize();
+}
+
+CsdStructureIndex::~CsdStructureIndex()
+{
+}
+
+void CsdStructureIndex::setDocument(QTextDocument *document)
+{
+	if (m_document == document)
+		return;
+	if (m_document) {
+		disconnect(m_document, 0, this, 0);
+	}
+	m_document = document;
+	if (m_document) {
+		connect(m_document, SIGNAL(contentsChange(int,int,int)),
+				this, SLOT(contentsChange(int,int,int)));
+	}
+	rebuild();
+}
+
+int CsdStructureIndex::sectionAt(int line)
+{
+	updateStructure();
+	int lo = 0, hi = m_sections.size() - 1, found = -1;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (m_sections[mid].firstLine <= line) {
+			found = mid;
+			lo = mid + 1;
+		}
+		else {
+			hi = mid - 1;
+		}
+	}
+	if (found >= 0 && m_sections[found].lastLine >= line)
+		return m_sections[found].section;
+	return NoSection;
+}
+
+CsdStructureIndex::Span CsdStructureIndex::spanAt(int line)
+{
+	updateStructure();
+	int lo = 0, hi = m_spans.size() - 1, found = -1;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (m_spans[mid].firstLine <= line) {
+			found = mid;
+			lo = mid + 1;
+		}
+		else {
+			hi = mid - 1;
+		}
+	}
+	if (found >= 0 && m_spans[found].lastLine >= line)
+		return m_spans[found];
+	return Span();
+}
+
+QVector<CsdStructureIndex::SectionRange> CsdStructureIndex::sections()
+{
+	updateStructure();
+	return m_sections;
+}
+
+QVector<CsdStructureIndex::Span> CsdStructureIndex::spans()
+{
+	updateStructure();
+	return m_spans;
+}
+
+QStringList CsdStructureIndex::udoNames()
+{
+	updateStructure();
+	return m_udoNames;
+}
+
+QString CsdStructureIndex::udoSignature(QString name)
+{
+	updateStructure();
+	return m_udoSignatures.value(name);
+}
+
+QStringList CsdStructureIndex::macros()
+{
+	updateStructure();
+	return m_macros;
+}
+
+QStringList CsdStructureIndex::globalVariables()
+{
+	updateStructure();
+	return m_globals;
+}
+
+int CsdStructureIndex::labelLine(QString label)
+{
+	updateStructure();
+	return m_labels.value(label, -1);
+}
+
+QStringList CsdStructureIndex::labels(int firstLine, int lastLine)
+{
+	QStringList list;
+	firstLine = qMax(firstLine, 0);
+	lastLine = qMin(lastLine, m_lines.size() - 1);
+	for (int i = firstLine; i <= lastLine; i++) {
+		if (!m_lines[i].label.isEmpty())
+			list << m_lines[i].label;
+	}
+	return list;
+}
+
+QStringList CsdStructureIndex::declaredVariables(int firstLine, int lastLine)
+{
+	QStringList list;
+	QSet<QString> seen;
+	firstLine = qMax(firstLine, 0);
+	lastLine = qMin(lastLine, m_lines.size() - 1);
+	for (int i = firstLine; i <= lastLine; i++) {
+		foreach (const QString &var, m_lines[i].declared) {
+			if (!seen.contains(var)) {
+				seen.insert(var);
+				list << var;
+			}
+		}
+	}
+	return list;
+}
+
+QStringList CsdStructureIndex::words()
+{
+	if (m_wordsDirty) {
+		m_words = m_wordIndex.words();
+		m_wordsDirty = false;
+	}
+	return m_words;
+}
+
+void CsdStructureIndex::contentsChange(int position, int charsRemoved, int charsAdded)
+{
+	Q_UNUSED(charsRemoved);
+	if (!m_document)
+		return;
+	if (m_lines.isEmpty()) {
+		rebuild();
+		return;
+	}
+	QTextBlock firstBlock = m_document->findBlock(position);
+	QTextBlock lastBlock = m_document->findBlock(position + charsAdded);
+	if (!firstBlock.isValid()) {
+		rebuild();
+		return;
+	}
+	if (!lastBlock.isValid()) {
+		lastBlock = m_document->lastBlock();
+	}
+	int first = firstBlock.blockNumber();
+	int newLast = lastBlock.blockNumber();
+	int oldLast = newLast - (m_document->blockCount() - m_lines.size());
+	if (oldLast < first - 1 || oldLast >= m_lines.size()) {
+		rebuild();
+		return;
+	}
+#ifdef QCS_DEBUG_STRUCTURE_INDEX
+	bool wasDirty = m_structureDirty;
+#endif
+	if (replaceLines(first, oldLast, newLast)) {
+		emit structureChanged();
+	}
+#ifdef QCS_DEBUG_STRUCTURE_INDEX
+	if (!wasDirty) {
+		checkStructure(first, oldLast, newLast);
+	}
+#endif
+}
+
+#ifdef QCS_DEBUG_STRUCTURE_INDEX
+// Reports edits that need a full rebuild, and compares the result of an
+// incremental update with a full rebuild
+void CsdStructureIndex::checkStructure(int first, int oldLast, int newLast)
+{
+	if (m_structureDirty) {
+		QDEBUG << "full rebuild after replacing lines" << first << "-" << oldLast
+			   << "with" << first << "-" << newLast << "of" << m_lines.size();
+		return;
+	}
+	QVector<SectionRange> sections = m_sections;
+	QVector<Span> spans = m_spans;
+	QHash<QString, int> labels = m_labels;
+	QStringList udoNames = m_udoNames;
+	QSet<QString> macros(m_macros.begin(), m_macros.end());
+	QSet<QString> globals(m_globals.begin(), m_globals.end());
+	m_structureDirty = true;
+	updateStructure();
+	bool same = sections.size() == m_sections.size() && spans.size() == m_spans.size()
+			&& labels == m_labels && udoNames == m_udoNames
+			&& macros == QSet<QString>(m_macros.begin(), m_macros.end())
+			&& globals == QSet<QString>(m_globals.begin(), m_globals.end());
+	for (int i = 0; same && i < sections.size(); i++) {
+		same = sections[i].section == m_sections[i].section
+				&& sections[i].firstLine == m_sections[i].firstLine
+				&& sections[i].lastLine == m_sections[i].lastLine;
+	}
+	for (int i = 0; same && i < spans.size(); i++) {
+		same = spans[i].firstLine == m_spans[i].firstLine
+				&& spans[i].lastLine == m_spans[i].lastLine
+				&& spans[i].name == m_spans[i].name;
+	}
+	if (!same) {
+		qWarning() << "CsdStructureIndex: incremental update differs from a full rebuild"
+				   << "after replacing lines" << first << "-" << oldLast
+				   << "with" << first << "-" << newLast;
+	}
+}
+#endif
+
+void CsdStructureIndex::rebuild()
+{
+	m_lines.clear();
+	m_wordIndex.clear();
+	m_structureDirty = true;
+	m_wordsDirty = true;
+	if (m_document) {
+		replaceLines(0, -1, m_document->blockCount() - 1);
+	}
+	emit structureChanged();
+}
+
+// Replaces the old lines first..oldLast with the current blocks first..newLast.
+// Returns true if anything the structure is built from changed.
+bool CsdStructureIndex::replaceLines(int first, int oldLast, int newLast)
+{
+	int oldCount = oldLast - first + 1;
+	int newCount = newLast - first + 1;
+	int delta = newCount - oldCount;
+	bool structural = false;
+	QStringList added, removed;
+	QVector<LineInfo> fresh(newCount);
+	QTextBlock block = m_document->findBlockByNumber(first);
+	for (int i = 0; i < newCount && block.isValid(); i++, block = block.next()) {
+		QString text = block.text();
+		uint hash = qHash(text);
+		if (oldCount == newCount && m_lines[first + i].hash == hash) {
+			fresh[i] = m_lines[first + i]; // Only formats changed (e.g. rehighlight)
+			continue;
+		}
+		scanLine(text, fresh[i]);
+		fresh[i].hash = hash;
+		if (oldCount == newCount) {
+			structural = structural || structuralChange(m_lines[first + i], fresh[i]);
+			removeWords(m_lines[first + i], removed);
+			addWords(fresh[i], added);
+		}
+	}
+	if (oldCount != newCount) {
+		// Possibly the whole document: counted first, so the index is
+		// updated in one pass instead of one sorted insertion per word
+		QHash<QString, int> counts;
+		for (int i = first; i <= oldLast; i++) {
+			foreach (const QString &word, m_lines[i].words) {
+				counts[word]--;
+			}
+		}
+		for (int i = 0; i < newCount; i++) {
+			foreach (const QString &word, fresh[i].words) {
+				counts[word]++;
+			}
+		}
+		QHash<QString, int> addedCounts, removedCounts;
+		for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+			if (it.value() > 0)
+				addedCounts.insert(it.key(), it.value());
+			else if (it.value() < 0)
+				removedCounts.insert(it.key(), -it.value());
+		}
+		m_wordIndex.remove(removedCounts, &removed);
+		m_wordIndex.add(addedCounts, &added);
+	}
+	QSet<QString> relocate;
+	if (m_structureDirty) {
+		structural = true;
+	}
+	else {
+		// Header and footer lines kept at the same offset from the start or
+		// the end of the edit: the rest only moves by delta
+		bool fromEnd = false;
+		bool boundaries = !sameBoundaries(first, oldCount, fresh, false);
+		if (boundaries && delta != 0) {
+			fromEnd = true;
+			boundaries = !sameBoundaries(first, oldCount, fresh, true);
+		}
+		if (boundaries) {
+			m_structureDirty = true;
+			structural = true;
+		}
+		else {
+			for (int i = first; i <= oldLast; i++) {
+				structural = structural || (delta != 0 && hasSymbols(m_lines[i]));
+				removeSymbols(m_lines[i], first, oldLast, relocate);
+			}
+			if (delta != 0) {
+				shiftStructure(first, oldLast, delta, fromEnd);
+			}
+		}
+	}
+	m_lines.remove(first, oldCount);
+	m_lines.insert(first, newCount, LineInfo());
+	for (int i = 0; i < newCount; i++) {
+		m_lines[first + i] = fresh[i];
+	}
+	if (!m_structureDirty) {
+		// A label still used elsewhere lost its first line
+		foreach (const QString &label, relocate) {
+			if (!m_labelCounts.contains(label))
+				continue;
+			for (int i = 0; i < m_lines.size(); i++) {
+				if (m_lines[i].label == label) {
+					m_labels[label] = i;
+					break;
+				}
+			}
+		}
+		for (int i = 0; i < newCount; i++) {
+			structural = structural || (delta != 0 && hasSymbols(fresh[i]));
+			addSymbols(fresh[i], first + i);
+		}
+	}
+	if (!added.isEmpty() || !removed.isEmpty()) {
+		// A word can be removed from one line and added in another
+		QSet<QString> both = QSet<QString>(added.begin(), added.end())
+				.intersect(QSet<QString>(removed.begin(), removed.end()));
+		if (!both.isEmpty()) {
+			QStringList filteredAdded, filteredRemoved;
+			foreach (const QString &word, added) {
+				if (!both.contains(word))
+					filteredAdded << word;
+			}
+			foreach (const QString &word, removed) {
+				if (!both.contains(word))
+					filteredRemoved << word;
+			}
+			added = filteredAdded;
+			removed = filteredRemoved;
+		}
+		if (!added.isEmpty() || !removed.isEmpty()) {
+			m_wordsDirty = true;
+			emit wordsChanged(added, removed);
+		}
+	}
+	return structural;
+}
+
+void CsdStructureIndex::scanLine(const QString &text, LineInfo &info)
+{
+	static QSet<QString> keywords = QSet<QString>()
+			<< "if" << "elseif" << "else" << "endif" << "then" << "while" << "until"
+			<< "do" << "od" << "goto" << "igoto" << "kgoto" << "tigoto" << "instr"
+			<< "endin" << "opcode" << "endop" << "return" << "rireturn" << "reinit";
+
+	info.words = text.split(rxWordSplit, SKIP_EMPTY_PARTS);
+	if (text.contains('<')) {
+		QRegularExpressionMatchIterator it = rxSectionTag.globalMatch(text);
+		while (it.hasNext()) {
+			QRegularExpressionMatch match = it.next();
+			int section = sectionFromTag(match.captured(2));
+			if (match.captured(1).isEmpty())
+				info.sectionOpen = section;
+			else
+				info.sectionClose = section;
+		}
+	}
+	QString code = stripComment(text).trimmed();
+	if (code.isEmpty())
+		return;
+	if (code.startsWith('#')) {
+		QRegularExpressionMatch match = rxDefine.match(code);
+		if (match.hasMatch())
+			info.macro = match.captured(1);
+		return;
+	}
+	if (startsWithWord(code, "instr")) {
+		QRegularExpressionMatch match = rxInstr.match(code);
+		if (match.hasMatch()) {
+			info.marker = InstrStart;
+			info.name = match.captured(1).simplified();
+		}
+		return;
+	}
+	if (startsWithWord(code, "opcode")) {
+		QRegularExpressionMatch match = rxOpcode.match(code);
+		if (match.hasMatch()) {
+			info.marker = OpcodeStart;
+			info.name = match.captured(1);
+			info.signature = match.captured(2).simplified();
+		}
+		return;
+	}
+	if (startsWithWord(code, "endin")) {
+		info.marker = InstrEnd;
+		return;
+	}
+	if (startsWithWord(code, "endop")) {
+		info.marker = OpcodeEnd;
+		return;
+	}
+	QRegularExpressionMatch match = rxLabel.match(code);
+	if (match.hasMatch()) {
+		info.label = match.captured(1);
+		code = code.mid(match.capturedEnd()).trimmed();
+	}
+	match = rxDeclaration.match(code);
+	if (!match.hasMatch())
+		return;
+	QStringList outputs = match.captured(1).split(rxOutputSplit, SKIP_EMPTY_PARTS);
+	if (keywords.contains(outputs.first().section(':', 0, 0)))
+		return;
+	foreach (QString output, outputs) {
+		bool typed = output.contains(':');
+		output = output.section(':', 0, 0);
+		int bracket = output.indexOf('[');
+		if (bracket >= 0)
+			output.truncate(bracket);
+		// Untyped names must carry a rate prefix to count as variables
+		if (typed || QString("gikaSfw").contains(output.at(0))) {
+			info.declared << output;
+		}
+	}
+}
+
+void CsdStructureIndex::addWords(const LineInfo &info, QStringList &added)
+{
+	foreach (const QString &word, info.words) {
+		if (m_wordIndex.add(word))
+			added << word;
+	}
+}
+
+void CsdStructureIndex::removeWords(const LineInfo &info, QStringList &removed)
+{
+	foreach (const QString &word, info.words) {
+		if (m_wordIndex.remove(word))
+			removed << word;
+	}
+}
+
+bool CsdStructureIndex::structuralChange(const LineInfo &a, const LineInfo &b)
+{
+	return boundaryChange(a, b)
+			|| a.label != b.label || a.macro != b.macro || a.declared != b.declared;
+}
+
+bool CsdStructureIndex::boundaryChange(const LineInfo &a, const LineInfo &b)
+{
+	return a.sectionOpen != b.sectionOpen || a.sectionClose != b.sectionClose
+			|| a.marker != b.marker || a.name != b.name || a.signature != b.signature;
+}
+
+bool CsdStructureIndex::hasSymbols(const LineInfo &info)
+{
+	return !info.label.isEmpty() || !info.macro.isEmpty() || !info.declared.isEmpty();
+}
+
+// Compares the section tags and instr/opcode markers of the old lines
+// starting at first with the new ones, aligned on the first or last line
+bool CsdStructureIndex::sameBoundaries(int first, int oldCount,
+									   const QVector<LineInfo> &fresh, bool fromEnd)
+{
+	static const LineInfo none;
+	int newCount = fresh.size();
+	int count = qMax(oldCount, newCount);
+	for (int k = 0; k < count; k++) {
+		int o = fromEnd ? oldCount - 1 - k : k;
+		int n = fromEnd ? newCount - 1 - k : k;
+		const LineInfo &a = (o >= 0 && o < oldCount) ? m_lines[first + o] : none;
+		const LineInfo &b = (n >= 0 && n < newCount) ? fresh[n] : none;
+		if (boundaryChange(a, b))
+			return false;
+	}
+	return true;
+}
+
+// Moves sections, spans and labels after an edit of the old lines
+// first..oldLast that added delta lines. Must run before m_lines is updated.
+void CsdStructureIndex::shiftStructure(int first, int oldLast, int delta, bool fromEnd)
+{
+	// Boundary lines inside the edit move with the side they are aligned on.
+	// An unclosed range ends on the line before the next header (or on the
+	// last line), so it also moves when that line is the edge of the edit.
+	int from = fromEnd ? first : oldLast + 1;
+	for (int i = 0; i < m_sections.size(); i++) {
+		SectionRange &section = m_sections[i];
+		bool closed = m_lines[section.lastLine].sectionClose != NoSection;
+		if (section.firstLine >= from)
+			section.firstLine += delta;
+		if (section.lastLine >= (closed ? from : from - 1))
+			section.lastLine += delta;
+	}
+	for (int i = 0; i < m_spans.size(); i++) {
+		Span &span = m_spans[i];
+		int marker = m_lines[span.lastLine].marker;
+		bool closed = marker == InstrEnd || marker == OpcodeEnd;
+		if (span.firstLine >= from)
+			span.firstLine += delta;
+		if (span.lastLine >= (closed ? from : from - 1))
+			span.lastLine += delta;
+	}
+	// Labels inside the edit are removed and added again by replaceLines()
+	for (auto it = m_labels.begin(); it != m_labels.end(); ++it) {
+		if (it.value() > oldLast)
+			it.value() += delta;
+	}
+}
+
+void CsdStructureIndex::addSymbols(const LineInfo &info, int line)
+{
+	if (!info.label.isEmpty()) {
+		if (m_labelCounts[info.label]++ == 0 || line < m_labels.value(info.label))
+			m_labels[info.label] = line;
+	}
+	if (!info.macro.isEmpty()) {
+		if (m_macroCounts[info.macro]++ == 0)
+			m_macros.append(info.macro);
+	}
+	foreach (const QString &var, info.declared) {
+		if (var.startsWith('g') && m_globalCounts[var]++ == 0)
+			m_globals.append(var);
+	}
+}
+
+// Labels that still exist but had their first line in first..oldLast are
+// added to relocate
+void CsdStructureIndex::removeSymbols(const LineInfo &info, int first, int oldLast,
+									  QSet<QString> &relocate)
+{
+	if (!info.label.isEmpty()) {
+		if (--m_labelCounts[info.label] == 0) {
+			m_labelCounts.remove(info.label);
+			m_labels.remove(info.label);
+		}
+		else {
+			int line = m_labels.value(info.label);
+			if (line >= first && line <= oldLast)
+				relocate.insert(info.label);
+		}
+	}
+	if (!info.macro.isEmpty() && --m_macroCounts[info.macro] == 0) {
+		m_macroCounts.remove(info.macro);
+		m_macros.removeOne(info.macro);
+	}
+	foreach (const QString &var, info.declared) {
+		if (var.startsWith('g') && --m_globalCounts[var] == 0) {
+			m_globalCounts.remove(var);
+			m_globals.removeOne(var);
+		}
+	}
+}
+
+void CsdStructureIndex::updateStructure()
+{
+	if (!m_structureDirty)
+		return;
+	m_sections.clear();
+	m_spans.clear();
+	m_udoNames.clear();
+	m_udoSignatures.clear();
+	m_labels.clear();
+	m_labelCounts.clear();
+	m_macros.clear();
+	m_macroCounts.clear();
+	m_globals.clear();
+	m_globalCounts.clear();
+	SectionRange section = {NoSection, -1, -1};
+	Span span;
+	int last = m_lines.size() - 1;
+	for (int i = 0; i <= last; i++) {
+		const LineInfo &info = m_lines[i];
+		if (info.sectionOpen != NoSection) {
+			if (section.firstLine >= 0) { // Unclosed section
+				section.lastLine = i - 1;
+				m_sections.append(section);
+			}
+			section.section = info.sectionOpen;
+			section.firstLine = i;
+		}
+		if (info.sectionClose != NoSection && section.firstLine >= 0) {
+			section.lastLine = i;
+			m_sections.append(section);
+			section.firstLine = -1;
+		}
+		if (info.marker == InstrStart || info.marker == OpcodeStart) {
+			if (span.isValid()) { // Missing endin/endop
+				span.lastLine = i - 1;
+				m_spans.append(span);
+			}
+			span = Span();
+			span.kind = info.marker == InstrStart ? InstrSpan : OpcodeSpan;
+			span.firstLine = i;
+			span.name = info.name;
+			span.signature = info.signature;
+			if (info.marker == OpcodeStart && !m_udoSignatures.contains(info.name)) {
+				m_udoNames.append(info.name);
+				m_udoSignatures.insert(info.name, info.signature);
+			}
+		}
+		else if ((info.marker == InstrEnd || info.marker == OpcodeEnd) && span.isValid()) {
+			span.lastLine = i;
+			m_spans.append(span);
+			span = Span();
+		}
+		addSymbols(info, i);
+	}
+	if (section.firstLine >= 0) {
+		section.lastLine = last;
+		m_sections.append(section);
+	}
+	if (span.isValid()) {
+		span.lastLine = last;
+		m_spans.append(span);
+	}
+	m_structureDirty = false;
+}
@@ -0,0 +1,179 @@
+/*
+	Copyright (C) 2026 The CsoundQt contributors
+
+	This file is part of CsoundQt.
+
+	CsoundQt is free software; you can redistribute it
+	and/or modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	CsoundQt is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with Csound; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+	02111-1307 USA
+*/
+
+#ifndef CSDSTRUCTUREINDEX_H
+#define CSDSTRUCTUREINDEX_H
+
+#include <QObject>
+#include <QPointer>
+#include <QTextDocument>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+
+#include "types.h"
+
+// Structure of a csd (sections, instr/opcode spans, UDOs, labels and
+// variable declarations) kept per block and updated from the document's
+// contentsChange deltas, so only edited lines are rescanned.
+// All line numbers are block numbers (starting at 0).
+class CsdStructureIndex : public QObject
+{
+	Q_OBJECT
+public:
+	enum Section {
+		NoSection = 0,
+		OptionsSection,
+		InstrumentsSection,
+		ScoreSection,
+		HtmlSection
+	};
+
+	enum SpanKind {
+		InstrSpan = 0,
+		OpcodeSpan
+	};
+
+	struct SectionRange {
+		int section;
+		int firstLine;
+		int lastLine;
+	};
+
+	struct Span {
+		Span() : kind(InstrSpan), firstLine(-1), lastLine(-1) {}
+		int kind;
+		int firstLine;
+		int lastLine; // endin/endop line, or last line of the document if unclosed
+		QString name; // instrument number(s)/name or UDO name
+		QString signature; // "outtypes, intypes" for UDOs
+		bool isValid() const { return firstLine >= 0; }
+	};
+
+	CsdStructureIndex(QObject *parent = 0);
+	~CsdStructureIndex();
+
+	void setDocument(QTextDocument *document);
+	QTextDocument *document() { return m_document; }
+
+	int lineCount() const { return m_lines.size(); }
+	int sectionAt(int line);
+	Span spanAt(int line);
+	QVector<SectionRange> sections();
+	QVector<Span> spans();
+
+	QStringList udoNames();
+	QString udoSignature(QString name);
+	QStringList macros();
+	QStringList globalVariables();
+	int labelLine(QString label);
+	QStringList labels(int firstLine, int lastLine);
+	QStringList declaredVariables(int firstLine, int lastLine);
+	QStringList words();
+	int wordCount(const QString &word) const { return m_wordIndex.count(word); }
+	// Words of the document starting with prefix, most used first
+	QVector<CompletionIndex::Entry> completeWord(const QString &prefix, int maxResults = 0) const {
+		return m_wordIndex.complete(prefix, maxResults);
+	}
+
+signals:
+	// Emitted after an edit changed sections, spans or UDOs
+	void structureChanged();
+	// Emitted with the words that appeared or disappeared from the document
+	void wordsChanged(QStringList added, QStringList removed);
+
+private slots:
+	void contentsChange(int position, int charsRemoved, int charsAdded);
+
+private:
+	enum Marker {
+		NoMarker = 0,
+		InstrStart,
+		OpcodeStart,
+		InstrEnd,
+		OpcodeEnd
+	};
+
+	struct LineInfo {
+		LineInfo() : hash(0), sectionOpen(NoSection), sectionClose(NoSection), marker(NoMarker) {}
+		uint hash;
+		qint8 sectionOpen;
+		qint8 sectionClose;
+		qint8 marker;
+		QString name;
+		QString signature;
+		QString label;
+		QString macro;
+		QStringList declared;
+		QStringList words;
+	};
+
+	void rebuild();
+	void scanLine(const QString &text, LineInfo &info);
+	bool replaceLines(int first, int oldLast, int newLast);
+	void addWords(const LineInfo &info, QStringList &added);
+	void removeWords(const LineInfo &info, QStringList &removed);
+	void updateStructure();
+	bool sameBoundaries(int first, int oldCount, const QVector<LineInfo> &fresh, bool fromEnd);
+	void shiftStructure(int first, int oldLast, int delta, bool fromEnd);
+	void addSymbols(const LineInfo &info, int line);
+	void removeSymbols(const LineInfo &info, int first, int oldLast, QSet<QString> &relocate);
+	static bool structuralChange(const LineInfo &a, const LineInfo &b);
+	static bool boundaryChange(const LineInfo &a, const LineInfo &b);
+	static bool hasSymbols(const LineInfo &info);
+#ifdef QCS_DEBUG_STRUCTURE_INDEX
+	void checkStructure(int first, int oldLast, int newLast);
+#endif
+
+	QPointer<QTextDocument> m_document;
+	QVector<LineInfo> m_lines;
+	CompletionIndex m_wordIndex; // every word with its number of occurrences
+
+	// Rebuilt from m_lines when m_structureDirty is set, which only happens
+	// when a section tag or instr/opcode header or footer changes. Other
+	// edits shift the line numbers and update the symbols in place.
+	bool m_structureDirty;
+	QVector<SectionRange> m_sections;
+	QVector<Span> m_spans;
+	QStringList m_udoNames;
+	QHash<QString, QString> m_udoSignatures;
+	QHash<QString, int> m_labels; // first line of each label
+	QHash<QString, int> m_labelCounts;
+	QStringList m_macros;
+	QHash<QString, int> m_macroCounts;
+	QStringList m_globals;
+	QHash<QString, int> m_globalCounts;
+	QStringList m_words;
+	bool m_wordsDirty;
+
+	QRegularExpression rxWordSplit;
+	QRegularExpression rxSectionTag;
+	QRegularExpression rxInstr;
+	QRegularExpression rxOpcode;
+	QRegularExpression rxLabel;
+	QRegularExpression rxDefine;
+	QRegularExpression rxDeclaration;
+	QRegularExpression rxOutputSplit;
+};
+
+#endif // CSDSTRUCTUREINDEX_H
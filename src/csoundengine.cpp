@@ -23,6 +23,8 @@
 
 #include <QtConcurrent>
 #include <QThread>
+#include <cstdlib>
+#include <new>
 
 #ifdef Q_OS_WIN
 #include <ole2.h> // for OleInitialize() FLTK bug workaround
@@ -57,15 +59,13 @@ CsoundEngine::CsoundEngine(ConfigLists *configlists) :
     ud->m_pythonCallback = "";
 #endif
     m_consoleBufferSize = 0;
+    m_droppedMessages = 0;
     m_recording = false;
 #ifndef QCS_DESTROY_CSOUND
     ud->csound=csoundCreate( (void *) ud);
     ud->midiBuffer = csoundCreateCircularBuffer(ud->csound, 1024, sizeof(unsigned char));
     Q_ASSERT(ud->midiBuffer);
 #endif
-    eventQueue.resize(QCS_MAX_EVENTS);
-    eventTimeStamps.resize(QCS_MAX_EVENTS);
-    eventQueueSize = 0;
     m_refreshTime = QCS_QUEUETIMER_DEFAULT_TIME;  // TODO Eventually allow this to be changed
     ud->msgRefreshTime = m_refreshTime*1000;
     ud->runDispatcher = true;
@@ -90,6 +90,54 @@ CsoundEngine::~CsoundEngine()
 }
 
 
+#ifdef QCS_DEBUG_RT_ALLOC
+// Counts operator new calls made while a value callback is running, plus
+// the callbacks' own fallback paths (which build QStrings). Qt containers
+// and C code allocate with malloc and are not seen, so this is a
+// regression check for the known paths, not proof of zero allocations.
+static thread_local bool inValueCallback = false;
+static std::atomic<int> valueCallbackAllocations(0);
+
+void *operator new(std::size_t size)
+{
+    if (inValueCallback) {
+        valueCallbackAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void *p = std::malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+class ValueCallbackScope
+{
+public:
+    ValueCallbackScope() { inValueCallback = true; }
+    ~ValueCallbackScope() { inValueCallback = false; }
+};
+#define QCS_VALUE_CALLBACK_SCOPE ValueCallbackScope valueCallbackScope
+#define QCS_COUNT_CALLBACK_ALLOCATION valueCallbackAllocations.fetch_add(1, std::memory_order_relaxed)
+#else
+#define QCS_VALUE_CALLBACK_SCOPE
+#define QCS_COUNT_CALLBACK_ALLOCATION
+#endif
+
 void CsoundEngine::outputValueCallback (CSOUND *csound,
                                         const char *channelName,
                                         void *channelValuePtr,
@@ -97,12 +145,22 @@ void CsoundEngine::outputValueCallback (CSOUND *csound,
 {
     // Called by the csound running engine when 'outvalue' opcode is used
     // To pass data from Csound to CsoundQt
+    QCS_VALUE_CALLBACK_SCOPE;
     CsoundUserData *ud = (CsoundUserData *) csoundGetHostData(csound);
     if (channelType == &CS_VAR_TYPE_S) {
+        QCS_COUNT_CALLBACK_ALLOCATION;
         ud->csEngine->passOutString(channelName, (const char *) channelValuePtr);
     }
     else if (channelType == &CS_VAR_TYPE_K){
-        ud->csEngine->passOutValue(channelName, *((MYFLT *)channelValuePtr));
+        // Interned channels are stored in their slot and passed to the
+        // widgets by the GUI timer
+        int id = ud->wl->valueChannels.id(channelName);
+        if (id >= 0) {
+            ud->wl->valueChannels.setOutput(id, *((MYFLT *)channelValuePtr));
+        } else {
+            QCS_COUNT_CALLBACK_ALLOCATION;
+            ud->csEngine->passOutValue(channelName, *((MYFLT *)channelValuePtr));
+        }
     } else {
         QDEBUG << "Unsupported type";
     }
@@ -115,8 +173,10 @@ void CsoundEngine::inputValueCallback (CSOUND *csound,
 {
     // Called by the csound running engine when 'invalue' opcode is used
     // To pass data from CsoundQt to Csound
+    QCS_VALUE_CALLBACK_SCOPE;
     CsoundUserData *ud = (CsoundUserData *) csoundGetHostData(csound);
     if (channelType == &CS_VAR_TYPE_S) { // channel is a string channel
+        QCS_COUNT_CALLBACK_ALLOCATION;
         char *string = (char *) channelValuePtr;
         QString newValue = ud->wl->getStringForChannel(channelName);
         int maxlen = csoundGetChannelDatasize(csound, channelName);
@@ -130,30 +190,36 @@ void CsoundEngine::inputValueCallback (CSOUND *csound,
     else if (channelType == &CS_VAR_TYPE_K) {  // Not a string channel
         //FIXME check if mouse tracking is active, and move this from here
         MYFLT *value = (MYFLT *) channelValuePtr;
-        if(!strcmp(channelName, "_Mouse")) {
+        if(!strncmp(channelName, "_Mouse", 6)) {
             const char *suffix = &channelName[6];
+            const QVector<double> &mouseValues = ud->mouseValues;
             if (!strcmp(suffix, "X")) {
-                *value = (MYFLT) ud->mouseValues[0];
+                *value = (MYFLT) mouseValues[0];
             }
             else if (!strcmp(suffix, "Y")) {
-                *value = (MYFLT) ud->mouseValues[1];
+                *value = (MYFLT) mouseValues[1];
             }
             else if(!strcmp(suffix, "RelX")) {
-                *value = (MYFLT) ud->mouseValues[2];
+                *value = (MYFLT) mouseValues[2];
             }
             else if(!strcmp(suffix, "RelY")) {
-                *value = (MYFLT) ud->mouseValues[3];
+                *value = (MYFLT) mouseValues[3];
             }
             else if(!strcmp(suffix, "But1")) {
-                *value = (MYFLT) ud->mouseValues[4];
+                *value = (MYFLT) mouseValues[4];
             }
             else if(!strcmp(suffix, "But2")) {
-                *value = (MYFLT) ud->mouseValues[5];
+                *value = (MYFLT) mouseValues[5];
             }
         }
         else {
-            // QString name(channelName);
-            *value = (MYFLT) ud->wl->getValueForChannel(channelName);
+            int id = ud->wl->valueChannels.id(channelName);
+            if (id >= 0) {
+                *value = ud->wl->valueChannels.input(id);
+            } else {
+                QCS_COUNT_CALLBACK_ALLOCATION;
+                *value = (MYFLT) ud->wl->getValueForChannel(channelName);
+            }
         }
     } else {
         QDEBUG << "Unsupported type";
@@ -355,6 +421,9 @@ void CsoundEngine::readWidgetValues(CsoundUserData *ud)
 {
     MYFLT* pvalue;
 
+    // Channels resolved in setupChannels() only cost a pointer store
+    ud->wl->inputChannels.flush();
+    // Channels created after the start of the run still go through the API
     if (ud->wl->valueMutex.tryLock()) {
         QHash<QString, double>::const_iterator i;
         QHash<QString, double>::const_iterator end = ud->wl->newValues.constEnd();
@@ -382,30 +451,20 @@ void CsoundEngine::readWidgetValues(CsoundUserData *ud)
 
 void CsoundEngine::writeWidgetValues(CsoundUserData *ud)
 {
-    MYFLT* pvalue;
-    for (int i = 0; i < ud->outputChannelNames.size(); i++) {
-        if (ud->outputChannelNames[i] != ""
-                && csoundGetChannelPtr(ud->csound, &pvalue,
-                                       ud->outputChannelNames[i].toLocal8Bit().constData(),
-                                       CSOUND_OUTPUT_CHANNEL | CSOUND_CONTROL_CHANNEL) == 0) {
-            if(ud->previousOutputValues[i] != *pvalue) {
-                ud->wl->setValue(ud->outputChannelNames[i],*pvalue);
-                ud->previousOutputValues[i] = *pvalue;
-            }
+    for (int i = 0; i < ud->outputChannelPointers.size(); i++) {
+        MYFLT value = *ud->outputChannelPointers[i];
+        if(ud->previousOutputValues[i] != value) {
+            ud->wl->setValue(ud->outputChannelNames[i], value);
+            ud->previousOutputValues[i] = value;
         }
     }
-    for (int i = 0; i < ud->outputStringChannelNames.size(); i++) {
-        if (ud->outputStringChannelNames[i] != ""
-                && csoundGetChannelPtr(ud->csound, &pvalue,
-                                       ud->outputStringChannelNames[i].toLocal8Bit().constData(),
-                                       CSOUND_OUTPUT_CHANNEL | CSOUND_STRING_CHANNEL) == 0) {
-            char chanString[2048]; // large enough for long strings in displays
-            csoundGetStringChannel(ud->csound, ud->outputStringChannelNames[i].toLocal8Bit().constData(),
-                                   chanString);
-            if(ud->previousStringOutputValues[i] != QString(chanString)) {
-                ud->wl->setValue(ud->outputStringChannelNames[i],QString(chanString));
-                ud->previousStringOutputValues[i] = QString(chanString);
-            }
+    for (int i = 0; i < ud->outputStringChannelKeys.size(); i++) {
+        char chanString[2048]; // large enough for long strings in displays
+        csoundGetStringChannel(ud->csound, ud->outputStringChannelKeys[i].constData(),
+                               chanString);
+        if(strcmp(ud->previousStringOutputValues[i].constData(), chanString) != 0) {
+            ud->wl->setValue(ud->outputStringChannelNames[i], QString(chanString));
+            ud->previousStringOutputValues[i] = QByteArray(chanString);
         }
     }
 }
@@ -448,15 +507,10 @@ void CsoundEngine::registerConsole(ConsoleWidget *c)
 
 QList<QPair<int, QString> > CsoundEngine::getErrorLines()
 {
-    QList<QPair<int, QString> > list;
     if (consoles.size() > 0) {
-        QList<int> lines = consoles[0]->errorLines;
-        QStringList texts = consoles[0]->errorTexts;
-        for (int i = 0; i < lines.size(); i++) {
-            list.append(QPair<int, QString>(lines[i], texts[i]));
-        }
+        return consoles[0]->errors();
     }
-    return list;
+    return QList<QPair<int, QString> >();
 }
 
 void CsoundEngine::setConsoleBufferSize(int size)
@@ -571,31 +625,60 @@ int CsoundEngine::popKeyReleaseEvent()
     return value;
 }
 
+void CsoundEngine::sendScoreEvent(ScoreEvent *event, qint64 now)
+{
+    CSOUND *csound = ud->csound;
+    if (event->type == 0) {
+        csoundInputMessage(csound, event->line.constData());
+        return;
+    }
+    MYFLT *pfields = event->pfields.data();
+    int count = event->pfields.size();
+    if (event->time > now && count > 1
+            && (event->type == 'i' || event->type == 'f')) {
+        // p2 is relative to the current k-cycle, add what is left of the
+        // delay inside it. With --sample-accurate the event starts on the
+        // exact sample.
+        pfields[1] += (event->time - now) / csoundGetSr(csound);
+    }
+    csoundScoreEvent(csound, event->type, pfields, count);
+}
+
 void CsoundEngine::processEventQueue()
 {
-    // This function should only be called when Csound is running
-    eventMutex.lock();
-    while (eventQueueSize > 0) {
-        eventQueueSize--;
-        m_playMutex.lock();
-#ifdef QCS_DESTROY_CSOUND
-        if (ud->perfThread) {
-            //ScoreEvent is not working
-            //      ud->perfThread->ScoreEvent(0, type, eventElements.size(), pFields);
-            //      qDebug()  << eventQueue[eventQueueSize];
-            ud->perfThread->InputMessage(eventQueue[eventQueueSize].toLatin1());
+    // Called from the performance thread once per k-cycle, without locking
+    // or allocating. New events go into the scheduler, then everything due
+    // before the end of this k-cycle is sent, earliest first.
+    qint64 now = csoundGetCurrentTimeSamples(ud->csound);
+    ScoreEvent *event = m_eventQueue.takeAll();
+    while (event) {
+        ScoreEvent *next = event->next;
+        if (event->cancel) {
+            m_scheduler.removeTagged(event->tag, [this](ScoreEvent *cancelled) {
+                m_eventQueue.retire(cancelled);
+            });
+            m_eventQueue.retire(event);
         }
-        else {
-            QDEBUG << "WARNING: ud->perfThread is NULL";
-        }
-#else
-        if (ud->perfThread) {
-            ud->perfThread->InputMessage(eventQueue[eventQueueSize].toLatin1());
+        else if (!m_scheduler.push(event)) {
+            // Scheduler full, send it on this k-cycle rather than dropping it
+            sendScoreEvent(event, now);
+            m_eventQueue.retire(event);
         }
-#endif
-        m_playMutex.unlock();
+        event = next;
+    }
+    qint64 end = now + csoundGetKsmps(ud->csound);
+    while (!m_scheduler.isEmpty() && m_scheduler.top()->time < end) {
+        event = m_scheduler.pop();
+        sendScoreEvent(event, now);
+        m_eventQueue.retire(event);
     }
-    eventMutex.unlock();
+}
+
+void CsoundEngine::discardEventQueue()
+{
+    // Only call while the performance thread is not running
+    m_eventQueue.discard();
+    m_scheduler.clear();
 }
 
 void CsoundEngine::passOutValue(QString channelName, double value)
@@ -686,25 +769,82 @@ void CsoundEngine::stopRecording()
 #endif
 }
 
-void CsoundEngine::queueEvent(QString eventLine, int delay)
+// Parses a single score statement into numeric p-fields. Returns false for
+// lines only the score parser understands (strings, carry symbols, several
+// statements...), which are then passed as text.
+static bool parseScoreEvent(const QString &eventLine, ScoreEvent *event)
+{
+    QString line = eventLine.trimmed();
+    if (line.isEmpty() || line.contains('\n')) {
+        return false;
+    }
+    QStringList tokens = line.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+    char type = tokens[0][0].toLatin1();
+    if (type != 'i' && type != 'f' && type != 'a' && type != 'q' && type != 'e') {
+        return false;
+    }
+    if (tokens[0].size() > 1) { // e.g. "i1 0 1"
+        tokens[0] = tokens[0].mid(1);
+    }
+    else {
+        tokens.removeFirst();
+    }
+    QVector<MYFLT> pfields;
+    pfields.reserve(tokens.size());
+    for (int i = 0; i < tokens.size(); i++) {
+        if (tokens[i].startsWith(';')) {
+            break;
+        }
+        bool ok;
+        double value = tokens[i].toDouble(&ok);
+        if (!ok) {
+            return false;
+        }
+        pfields << (MYFLT) value;
+    }
+    event->type = type;
+    event->pfields = pfields;
+    return true;
+}
+
+qint64 CsoundEngine::eventTime(double delay)
+{
+    if (delay <= 0) {
+        return -1;
+    }
+    // Counted from now on the performance clock
+    return csoundGetCurrentTimeSamples(ud->csound)
+            + (qint64) (delay * csoundGetSr(ud->csound) + 0.5);
+}
+
+void CsoundEngine::queueEvent(QString eventLine, double delay, int tag)
 {
-    // TODO: implement delayed events
-    (void) delay;
     //   qDebug("CsoundEngine::queueEvent %s", eventLine.toStdString().c_str());
     if (!isRunning()) {
         QMutexLocker lock(&m_messageMutex);
-        messageQueue << tr("Csound is not running! Event ignored.\n");
+        pushMessage(tr("Csound is not running! Event ignored.\n"));
         return;
     }
-    if (eventQueueSize < QCS_MAX_EVENTS) {
-        eventMutex.lock();
-        eventQueue[eventQueueSize] = eventLine;
-        eventQueueSize++;
-        eventMutex.unlock();
+    ScoreEvent *event = new ScoreEvent;
+    if (!parseScoreEvent(eventLine, event)) {
+        // Sent as text on the k-cycle it is due
+        event->line = eventLine.toLatin1();
     }
-    else {
-        qDebug("Warning: event queue full, event not processed");
+    event->time = eventTime(delay);
+    event->tag = tag;
+    m_eventQueue.push(event);
+}
+
+void CsoundEngine::cancelEvents(int tag)
+{
+    if (!isRunning() || tag == 0) {
+        return;
     }
+    // Goes through the queue so that it comes after the events it cancels
+    ScoreEvent *event = new ScoreEvent;
+    event->tag = tag;
+    event->cancel = true;
+    m_eventQueue.push(event);
 }
 
 int CsoundEngine::checkSyntax() {
@@ -718,7 +858,7 @@ int CsoundEngine::checkSyntax() {
     ud->csound = csoundCreate((void *) ud);
     QDEBUG << "$$$ checkSyntax 2";
 
-    eventQueueSize = 0;
+    discardEventQueue();
     ud->msgRefreshTime = m_refreshTime*1000;
     QDir::setCurrent(m_options.fileName1);
     for (int i = 0; i < consoles.size(); i++) {
@@ -772,8 +912,8 @@ int CsoundEngine::runCsound()
     // OleInitialize(NULL); // Do not initialize here but in CsoundQt onbject
     // OleInitialize(NULL);
 #endif
-    eventQueueSize = 0;
     // Flush events gathered while idle.
+    discardEventQueue();
     ud->audioOutputBuffer.allZero();
     ud->msgRefreshTime = m_refreshTime*1000;
     QDir::setCurrent(m_options.fileName1);
@@ -901,16 +1041,19 @@ int CsoundEngine::runCsound()
     ud->outputBufferSize = csoundGetKsmps(ud->csound);
     if (ud->enableWidgets) {
         setupChannels();
+    } else {
+        clearChannels();
     }
     // Do not run the performance thread if the piece is an HTML file,
     // the HTML code must do that.
+    // The audio tap must be sized before the performance thread starts writing to it
+    ud->audioOutputBuffer.resize(ud->numChnls * 2048);
     if (!m_options.fileName1.endsWith(".html", Qt::CaseInsensitive)) {
         ud->perfThread = new CsoundPerformanceThread(ud->csound);
         ud->perfThread->SetProcessCallback(CsoundEngine::csThread, (void*)ud);
         ud->perfThread->Play();
 		m_paused = false;
     }
-    ud->audioOutputBuffer.resize(ud->numChnls * 2048);
     return 0;
 }
 
@@ -954,6 +1097,7 @@ void CsoundEngine::stopCsound()
         csoundMutex.lock();
         pt->SetProcessCallback(nullptr, nullptr);
         QThread::msleep(200);
+        clearChannels();
         QDEBUG << "Destroying csound...";
         // delete pt;
         csoundDestroy(ud->csound);
@@ -1015,8 +1159,18 @@ void CsoundEngine::cleanupCsound()
 #endif
 
     csoundCleanup(ud->csound);
+#ifdef QCS_DEBUG_RT_ALLOC
+    int allocations = valueCallbackAllocations.exchange(0);
+    if (allocations > 0) {
+        queueMessage(tr("CsoundQt: %1 counted allocations in value callbacks\n").arg(allocations));
+    }
+#endif
     flushQueues();
     csoundDestroyMessageBuffer(ud->csound);
+    if (ud->wl) {
+        ud->wl->processNewValues(); // Last outvalue values, before their table goes
+    }
+    clearChannels();
 
 #ifdef QCS_DESTROY_CSOUND
     csoundDestroyCircularBuffer(ud->csound, ud->midiBuffer);
@@ -1030,13 +1184,38 @@ void CsoundEngine::cleanupCsound()
 #endif
 }
 
-void CsoundEngine::setupChannels()
+void CsoundEngine::clearChannels()
 {
-    ud->inputChannelNames.clear();
+    // Resolved pointers are only valid while the Csound instance exists
     ud->outputChannelNames.clear();
-    ud->outputStringChannelNames.clear();
+    ud->outputChannelPointers.clear();
     ud->previousOutputValues.clear();
+    ud->outputStringChannelNames.clear();
+    ud->outputStringChannelKeys.clear();
     ud->previousStringOutputValues.clear();
+    if (ud->wl) {
+        ud->wl->inputChannels.clear();
+        ud->wl->valueChannels.clear();
+    }
+}
+
+bool CsoundEngine::channelPointer(const char *name, int chanType, int direction, MYFLT **pointer)
+{
+    // Asking with type 0 only returns the type and leaves the pointer null,
+    // so the channel is fetched again with its real type and direction
+    *pointer = nullptr;
+    int ret = csoundGetChannelPtr(ud->csound, pointer, name,
+                                  (chanType & CSOUND_CHANNEL_TYPE_MASK) | direction);
+    if (ret != CSOUND_SUCCESS || *pointer == nullptr) {
+        QDEBUG << "Could not get channel pointer for" << name;
+        return false;
+    }
+    return true;
+}
+
+void CsoundEngine::setupChannels()
+{
+    clearChannels();
     csoundSetInputChannelCallback(ud->csound, &CsoundEngine::inputValueCallback);
     csoundSetOutputChannelCallback(ud->csound, &CsoundEngine::outputValueCallback);
     // For chnget/chnset
@@ -1045,7 +1224,11 @@ void CsoundEngine::setupChannels()
     controlChannelInfo_t *entry = channelList;
 
     MYFLT *pvalue;
-    QVector<QuteWidget *> widgets = ud->wl->getWidgets();
+    // A panel that was not shown yet is described without creating its widgets
+    QVector<WidgetDescriptor> widgets = ud->wl->getWidgetChannels();
+    QVector<QString> inputNames;
+    QVector<MYFLT *> inputPointers;
+    QList<QPair<int, double> > initialValues;
     // Set channels values for existing channels (i.e. those declared with chn_*
     // in the csound header
     for (int i = 0; i < numChannels; i++) {
@@ -1053,48 +1236,59 @@ void CsoundEngine::setupChannels()
         // if type is 0, no new channel is created if it does not exist,
         // the returned value is the channel type
         int chanType = csoundGetChannelPtr(ud->csound, &pvalue, entry->name, 0);
+        QString name(entry->name);
+        if (chanType < 0) {
+            entry++;
+            continue;
+        }
         if (chanType & CSOUND_INPUT_CHANNEL) {
-            if ((chanType & CSOUND_CHANNEL_TYPE_MASK) == CSOUND_CONTROL_CHANNEL) {
-                ud->wl->valueMutex.lock();
-                foreach (QuteWidget *w, widgets) {
-                    if (w->getChannelName() == QString(entry->name)) {
-                        ud->wl->newValues.insert(w->getChannelName(), w->getValue());
+            if ((chanType & CSOUND_CHANNEL_TYPE_MASK) == CSOUND_CONTROL_CHANNEL
+                    && channelPointer(entry->name, chanType, CSOUND_INPUT_CHANNEL, &pvalue)) {
+                // Resolve the channel once, values are then published by id
+                int id = inputNames.size();
+                inputNames << name;
+                inputPointers << pvalue;
+                foreach (const WidgetDescriptor &w, widgets) {
+                    if (w.channel == name) {
+                        initialValues << QPair<int, double>(id, w.value);
                     }
-                    if (w->getChannel2Name() == QString(entry->name)) {
-                        ud->wl->newValues.insert(w->getChannel2Name(), w->getValue2());
+                    if (w.channel2 == name) {
+                        initialValues << QPair<int, double>(id, w.value2);
                     }
                 }
-                ud->wl->valueMutex.unlock();
             } else if ((chanType & CSOUND_CHANNEL_TYPE_MASK) ==  CSOUND_STRING_CHANNEL) {
                 ud->wl->stringValueMutex.lock();
-                foreach (QuteWidget *w, widgets) {
-                    if (w->getChannelName() == QString(entry->name)) {
-                        ud->wl->newStringValues.insert(w->getChannelName(), w->getStringValue());
+                foreach (const WidgetDescriptor &w, widgets) {
+                    if (w.channel == name) {
+                        ud->wl->newStringValues.insert(w.channel, w.stringValue);
                     }
                 }
                 ud->wl->stringValueMutex.unlock();
             }
         }
         if (chanType & CSOUND_OUTPUT_CHANNEL) { // Channels can be input and output at the same time
-            if ((chanType & CSOUND_CHANNEL_TYPE_MASK) == CSOUND_CONTROL_CHANNEL) {
-                ud->outputChannelNames << QString(entry->name);
+            if ((chanType & CSOUND_CHANNEL_TYPE_MASK) == CSOUND_CONTROL_CHANNEL
+                    && channelPointer(entry->name, chanType, CSOUND_OUTPUT_CHANNEL, &pvalue)) {
+                ud->outputChannelNames << name;
+                ud->outputChannelPointers << pvalue;
                 ud->previousOutputValues << 0;
-                foreach (QuteWidget *w, widgets) {
-                    if (w->getChannelName() == QString(entry->name)) {
-                        ud->previousOutputValues.last() = w->getValue();
+                foreach (const WidgetDescriptor &w, widgets) {
+                    if (w.channel == name) {
+                        ud->previousOutputValues.last() = w.value;
                         continue;
                     }
-                    if (w->getChannel2Name() == QString(entry->name)) {
-                        ud->previousOutputValues.last() = w->getValue2();
+                    if (w.channel2 == name) {
+                        ud->previousOutputValues.last() = w.value2;
                         continue;
                     }
                 }
             } else if ((chanType & CSOUND_CHANNEL_TYPE_MASK) == CSOUND_STRING_CHANNEL) {
-                ud->outputStringChannelNames << QString(entry->name);
-                ud->previousStringOutputValues << "";
-                foreach (QuteWidget *w, widgets) {
-                    if (w->getChannelName() == QString(entry->name)) {
-                        ud->previousStringOutputValues.last() = w->getStringValue();
+                ud->outputStringChannelNames << name;
+                ud->outputStringChannelKeys << QByteArray(entry->name);
+                ud->previousStringOutputValues << QByteArray();
+                foreach (const WidgetDescriptor &w, widgets) {
+                    if (w.channel == name) {
+                        ud->previousStringOutputValues.last() = w.stringValue.toLocal8Bit();
                         continue;
                     }
                 }
@@ -1103,13 +1297,33 @@ void CsoundEngine::setupChannels()
         entry++;
     }
     csoundDeleteChannelList(ud->csound, channelList);
+    ud->wl->inputChannels.setChannels(inputNames, inputPointers);
+    for (int i = 0; i < initialValues.size(); i++) {
+        ud->wl->inputChannels.publish(initialValues[i].first, initialValues[i].second);
+    }
+
+    // Intern the widget channel names for invalue/outvalue
+    QVector<QString> valueNames;
+    valueNames << "_SetPreset" << "_SetPresetIndex";
+    foreach (const WidgetDescriptor &w, widgets) {
+        QString names[2] = {w.channel, w.channel2};
+        for (int n = 0; n < 2; n++) {
+            if (!names[n].isEmpty() && !valueNames.contains(names[n])) {
+                valueNames << names[n];
+            }
+        }
+    }
+    ud->wl->valueChannels.setChannels(valueNames);
+    for (int i = 0; i < valueNames.size(); i++) {
+        ud->wl->valueChannels.setInput(i, ud->wl->getValueForChannel(valueNames[i]));
+    }
 
     // Force creation of string channels for _Browse widgets
-    foreach (QuteWidget *w, widgets) {
-        if (w->getChannelName().startsWith("_Browse")) {
-            csoundGetChannelPtr(ud->csound, &pvalue, w->getChannelName().toLocal8Bit(),
+    foreach (const WidgetDescriptor &w, widgets) {
+        if (w.channel.startsWith("_Browse")) {
+            csoundGetChannelPtr(ud->csound, &pvalue, w.channel.toLocal8Bit(),
                                 CSOUND_INPUT_CHANNEL | CSOUND_OUTPUT_CHANNEL | CSOUND_STRING_CHANNEL);
-            ud->wl->newStringValues.insert(w->getChannelName(), w->getStringValue());
+            ud->wl->newStringValues.insert(w.channel, w.stringValue);
         }
     }
 }
@@ -1134,31 +1348,19 @@ void CsoundEngine::messageListDispatcher(void *data)
             int count = csoundGetMessageCnt(csound);
             ud_local->csEngine->m_messageMutex.lock();
             for (int i = 0; i< count; i++) {
-                ud_local->csEngine->messageQueue << csoundGetFirstMessage(csound);
+                ud_local->csEngine->pushMessage(csoundGetFirstMessage(csound));
                 // FIXME: Is this thread safe?
                 csoundPopFirstMessage(csound);
             }
             ud_local->csEngine->m_messageMutex.unlock();
         }
-
-        int counter = 0;
-        ud_local->csEngine->m_messageMutex.lock();
-        while ((ud_local->csEngine->m_consoleBufferSize <= 0 ||
-                counter++ < ud_local->csEngine->m_consoleBufferSize)) {
-            if (ud_local->csEngine->messageQueue.isEmpty()) {
-                break;
-            }
-            QString msg = ud_local->csEngine->messageQueue.takeFirst();
+        // Everything gathered during this refresh goes to the consoles as a
+        // single payload, so the GUI thread sees one queued signal
+        QString payload = ud_local->csEngine->takeMessages();
+        if (!payload.isEmpty()) {
             // Must use signals to make things thread safe
-            emit ud_local->csEngine->passMessages(msg);
+            emit ud_local->csEngine->passMessages(payload);
         }
-        if (!ud_local->csEngine->messageQueue.isEmpty()
-                && ud_local->csEngine->m_consoleBufferSize > 0
-                && counter >= ud_local->csEngine->m_consoleBufferSize) {
-            ud_local->csEngine->messageQueue.clear();
-            ud_local->csEngine->messageQueue << "\nCsoundQt: Message buffer overflow. Messages discarded!\n";
-        }
-        ud_local->csEngine->m_messageMutex.unlock();
         QThread::usleep(ud_local->msgRefreshTime);
     }
 }
@@ -1168,28 +1370,51 @@ void CsoundEngine::flushQueues()
     m_messageMutex.lock();
     int count = csoundGetMessageCnt(ud->csound);
     for (int i = 0; i < count; i++) {
-        messageQueue << csoundGetFirstMessage(ud->csound);
+        pushMessage(csoundGetFirstMessage(ud->csound));
         csoundPopFirstMessage(ud->csound);
     }
-
-    while (!messageQueue.isEmpty()) {
-        QString msg = messageQueue.takeFirst();
-        ConsoleWidget *console = nullptr;
+    m_messageMutex.unlock();
+    QString payload = takeMessages();
+    if (!payload.isEmpty()) {
         for (int i = 0; i < consoles.size(); i++) {
-            console = consoles[i];
-            console->appendMessage(msg);
+            consoles[i]->appendMessage(payload);
         }
-        ud->wl->appendMessage(msg);
-
+        ud->wl->appendMessage(payload);
     }
-    m_messageMutex.unlock();
     ud->wl->flushGraphBuffer();
 }
 
+void CsoundEngine::pushMessage(const QString &message)
+{
+    // Keeps the newest m_consoleBufferSize messages, counting the ones that
+    // had to go. m_messageMutex must be held.
+    if (m_consoleBufferSize > 0) {
+        while (messageQueue.size() >= m_consoleBufferSize) {
+            messageQueue.removeFirst();
+            m_droppedMessages++;
+        }
+    }
+    messageQueue << message;
+}
+
+QString CsoundEngine::takeMessages()
+{
+    QMutexLocker lock(&m_messageMutex);
+    QString payload;
+    if (m_droppedMessages > 0) {
+        payload = tr("\nCsoundQt: Message buffer overflow. %1 messages discarded!\n")
+                .arg(m_droppedMessages);
+        m_droppedMessages = 0;
+    }
+    payload += messageQueue.join(QString());
+    messageQueue.clear();
+    return payload;
+}
+
 void CsoundEngine::queueMessage(QString message)
 {
     m_messageMutex.lock();
-    messageQueue << message;
+    pushMessage(message);
     m_messageMutex.unlock();
 }
 
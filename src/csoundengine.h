@@ -89,11 +89,14 @@ struct CsoundUserData {
 	int msgRefreshTime; // In micro seconds
 
 	// Channels are only queried at the start of run, so only channels defined in instr 0 are available
-	QList<QString> inputChannelNames;
-	QList<QString> outputChannelNames;
-	QList<QString> outputStringChannelNames;
-	QList<QVariant> previousOutputValues;
-	QList<QVariant> previousStringOutputValues;
+	// Output channel pointers are resolved once in setupChannels(), input
+	// channels are resolved in the widget layout's ChannelTable.
+	QVector<QString> outputChannelNames;
+	QVector<MYFLT *> outputChannelPointers;
+	QVector<MYFLT> previousOutputValues;
+	QVector<QString> outputStringChannelNames;
+	QVector<QByteArray> outputStringChannelKeys; // Names converted once for the API
+	QVector<QByteArray> previousStringOutputValues;
     QString lastRecordingOutfile;
 
 	void *midiBuffer; //Csound Circular Buffer
@@ -161,6 +164,7 @@ public:
 	int popKeyReleaseEvent();
 
 	void processEventQueue();
+	void discardEventQueue();
 	void passOutValue(QString channelName, double value);
 	void passOutString(QString channelName, QString value);
 	void flushQueues();
@@ -209,7 +213,8 @@ public slots:
 	void pause();
 	int startRecording(int format, QString filename);
 	void stopRecording();
-	void queueEvent(QString eventLine, int delay = 0);
+	void queueEvent(QString eventLine, double delay = 0, int tag = 0); // delay in seconds
+	void cancelEvents(int tag); // Drops the events queued with tag that have not started
 	void keyPressForCsound(int key);  // For key press events from consoles and widget panel
 	void keyReleaseForCsound(int key);
 
@@ -230,7 +235,13 @@ public:
 
 private:
 	void setupChannels();
+	bool channelPointer(const char *name, int chanType, int direction, MYFLT **pointer);
+	void clearChannels();
+	void sendScoreEvent(ScoreEvent *event, qint64 now);
+	qint64 eventTime(double delay);
 	QList <int> getAnsiKeySequence(int key);
+	void pushMessage(const QString &message);
+	QString takeMessages();
 
 	QFuture<void> m_msgUpdateThread;
 	static void messageListDispatcher(void *data); // Function run in updater thread
@@ -241,7 +252,8 @@ private:
 
 	int m_consoleBufferSize;
 	QMutex m_messageMutex; // Protection for message queue
-	QStringList messageQueue;  // Messages from Csound execution
+	QStringList messageQueue;  // Messages from Csound execution, at most m_consoleBufferSize
+	int m_droppedMessages; // Messages discarded since the last dispatch, protected by m_messageMutex
 	QMutex keyMutex; // For keys pressed to pass to Csound from console and widget panel
 	QList <int> keyPressBuffer; // protected by keyMutex
 	QList <int> keyReleaseBuffer; // protected by keyMutex
@@ -250,12 +262,10 @@ private:
 	bool m_paused;
     // To prevent from starting a Csound instance while another is starting or closing
     QMutex m_playMutex;
-	QMutex eventMutex;
     QMutex csoundMutex;
-	QVector<QString> eventQueue;
+	ScoreEventQueue m_eventQueue; // Filled by queueEvent(), drained by the performance thread
+	ScoreEventScheduler m_scheduler; // Delayed events, performance thread only
 	int m_refreshTime; // time in milliseconds for widget value updates (both input and output)
-	QVector<unsigned long> eventTimeStamps;
-	int eventQueueSize;
 
 private slots:
 
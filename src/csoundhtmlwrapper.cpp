@@ -290,6 +290,13 @@ int CsoundHtmlWrapper::scoreEvent(char type, const double *pFields, long numFiel
     return csoundScoreEvent(getCsound(),type, pFields, numFields);
 }
 
+void CsoundHtmlWrapper::scheduleEvent(const QString &eventLine, double delay) {
+    if (!m_csoundEngine) {
+        return;
+    }
+    m_csoundEngine->queueEvent(eventLine, delay);
+}
+
 void CsoundHtmlWrapper::setControlChannel(const QString &name, double value) {
     if (!m_csoundEngine) {
         return;
@@ -68,6 +68,8 @@ public slots:
     void rewindScore();
     int runUtility(const QString &command, int argc, char **argv);
     int scoreEvent(char type, const double *pFields, long numFields);
+    // Sample accurate, delay in seconds from now
+    void scheduleEvent(const QString &eventLine, double delay);
     void setControlChannel(const QString &name, double value);
     int setGlobalEnv(const QString &name, const QString &value);
     void setInput(const QString &name);
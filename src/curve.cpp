@@ -23,20 +23,42 @@
 
 #include "curve.h"
 
+#include <cstring>
+
 // Curve is a straightforward abstract data type for a curve
 
 void Curve::copy(size_t size, MYFLT *data)
 {
 	// set_size must be called prior to this, as bounds are not checked.
-	for (size_t i = 0; i < size; i++)
-		m_data[i] = data[i];
+	memcpy(m_data, data, size * sizeof(MYFLT));
 }
 
-void Curve::destroy()
+void Curve::allocate(size_t capacity)
 {
-	if (m_size != 0) {
-		free(m_data);
+	// The display data and both snapshots get the same capacity, so nothing
+	// needs to be allocated once Csound is drawing
+	m_capacity = capacity;
+	m_data = (MYFLT *) calloc(capacity, sizeof(MYFLT));
+	m_readBuffer = (MYFLT *) calloc(capacity, sizeof(MYFLT));
+	for (int i = 0; i < 2; i++) {
+		m_snapshots[i].data = (MYFLT *) calloc(capacity, sizeof(MYFLT));
+		m_snapshots[i].size = 0;
+		m_snapshots[i].max = m_snapshots[i].min = m_snapshots[i].absmax = 0;
 	}
+	m_flips.store(0);
+	m_readFlips = 0;
+	dirtyNext.store(nullptr);
+	dirtyQueued.store(false);
+}
+
+void Curve::destroy()
+{
+	free(m_data);
+	free(m_readBuffer);
+	free(m_snapshots[0].data);
+	free(m_snapshots[1].data);
+	m_data = m_readBuffer = m_snapshots[0].data = m_snapshots[1].data = nullptr;
+	m_size = m_capacity = 0;
 }
 
 Curve::Curve(MYFLT *data, size_t size, const QString& caption,
@@ -44,9 +66,37 @@ Curve::Curve(MYFLT *data, size_t size, const QString& caption,
 			 MYFLT y_scale, bool dotted_divider, WINDAT *original)
 	: m_caption(caption)
 {
-	m_size = 0;
 	mutex.lock();
-	set_size(size);
+	allocate(size);
+	init(data, size, polarity, max, min, absmax, y_scale, dotted_divider, original);
+	mutex.unlock();
+    qDebug() << "Curve " << m_curveType;
+
+}
+
+void Curve::reset(MYFLT *data, size_t size, const QString& caption,
+				  Polarity polarity, MYFLT max, MYFLT min, MYFLT absmax,
+				  MYFLT y_scale, bool dotted_divider, WINDAT *original)
+{
+	mutex.lock();
+	if (size > m_capacity) {
+		destroy();
+		allocate(size);
+	}
+	else {
+		m_snapshots[0].size = m_snapshots[1].size = 0;
+		m_flips.store(0);
+		m_readFlips = 0;
+	}
+	m_caption = caption;
+	init(data, size, polarity, max, min, absmax, y_scale, dotted_divider, original);
+	mutex.unlock();
+}
+
+void Curve::init(MYFLT *data, size_t size, Polarity polarity, MYFLT max, MYFLT min,
+				 MYFLT absmax, MYFLT y_scale, bool dotted_divider, WINDAT *original)
+{
+	m_size = size;
 	copy(size, data);
 	m_polarity = polarity;
 	m_max = max;
@@ -62,16 +112,20 @@ Curve::Curve(MYFLT *data, size_t size, const QString& caption,
     } else {
         m_curveType = CURVE_AUDIOSIGNAL;
     }
-	mutex.unlock();
-    qDebug() << "Curve " << m_curveType;
+}
 
+size_t Curve::memoryUsage() const
+{
+	// Display data, read buffer and two snapshots
+	return sizeof(Curve) + 4 * m_capacity * sizeof(MYFLT);
 }
 
 Curve::Curve(const Curve& curve)
 	: m_caption(curve.m_caption)
 {
 	mutex.lock();
-	set_size(curve.m_size);
+	allocate(curve.m_capacity);
+	m_size = curve.m_size;
 	copy(curve.m_size, curve.m_data);
 	m_polarity = curve.m_polarity;
 	m_max = curve.m_max;
@@ -79,6 +133,8 @@ Curve::Curve(const Curve& curve)
 	m_absmax = curve.m_absmax;
 	m_y_scale = curve.m_y_scale;
 	m_dotted_divider = curve.m_dotted_divider;
+	m_original = nullptr;
+	m_curveType = curve.m_curveType;
 	mutex.unlock();
 }
 
@@ -87,7 +143,8 @@ Curve& Curve::operator=(const Curve& curve)
 	mutex.lock();
 	if (this != &curve) {
 		destroy();
-		set_size(curve.m_size);
+		allocate(curve.m_capacity);
+		m_size = curve.m_size;
 		copy(curve.m_size, curve.m_data);
 		m_caption = curve.m_caption;
 		m_polarity = curve.m_polarity;
@@ -96,6 +153,8 @@ Curve& Curve::operator=(const Curve& curve)
 		m_absmax = curve.m_absmax;
 		m_y_scale = curve.m_y_scale;
 		m_dotted_divider = curve.m_dotted_divider;
+		m_original = nullptr;
+		m_curveType = curve.m_curveType;
 	}
 	mutex.unlock();
 	return *this;
@@ -108,6 +167,47 @@ Curve::~Curve()
 	mutex.unlock();
 }
 
+void Curve::write(const WINDAT *windat)
+{
+	// Only the Csound thread writes. The fence orders the previous flip before
+	// the writes to the buffer the GUI may still be copying (see readSnapshot)
+	std::atomic_thread_fence(std::memory_order_release);
+	unsigned int flips = m_flips.load(std::memory_order_relaxed);
+	Snapshot &back = m_snapshots[(flips + 1) & 1];
+	size_t size = qMin((size_t) windat->npts, m_capacity);
+	memcpy(back.data, windat->fdata, size * sizeof(MYFLT));
+	back.size = size;
+	back.max = windat->max;
+	back.min = windat->min;
+	back.absmax = windat->absmax;
+	m_flips.store(flips + 1, std::memory_order_release);
+}
+
+bool Curve::readSnapshot()
+{
+	unsigned int flips = m_flips.load(std::memory_order_acquire);
+	if (flips == m_readFlips) {
+		return false;
+	}
+	const Snapshot &front = m_snapshots[flips & 1];
+	size_t size = qMin(front.size, m_capacity);
+	MYFLT max = front.max, min = front.min, absmax = front.absmax;
+	memcpy(m_readBuffer, front.data, size * sizeof(MYFLT));
+	// If Csound flipped again while copying, it may have started writing to
+	// this buffer. Keep the current data, the newer snapshot is read next time.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (m_flips.load(std::memory_order_relaxed) != flips) {
+		return false;
+	}
+	qSwap(m_data, m_readBuffer);
+	m_size = size;
+	m_max = max;
+	m_min = min;
+	m_absmax = absmax;
+	m_readFlips = flips;
+	return true;
+}
+
 size_t Curve::get_size() const
 {
 	return m_size;
@@ -178,13 +278,8 @@ void Curve::set_data(MYFLT * data)
 
 void Curve::set_size(size_t size)
 {
-	if (m_size < size) { // This should happen only once on constructing the curve, as curves should change length
-		if (m_size != 0) {
-			free(m_data);
-		}
-		m_data = (MYFLT *) calloc(size, sizeof(MYFLT));
-	}
-	m_size = size;
+	// Curves don't change length, the size is at most the initial one
+	m_size = qMin(size, m_capacity);
 }
 
 void Curve::set_caption(QString caption)
@@ -50,9 +50,16 @@ public:
 	Curve(const Curve&);
 	Curve &operator=(const Curve&);
 	~Curve();
+	// Reinitializes a curve for a new display, keeping its buffers if they are
+	// large enough. Not safe while Csound may still write to the curve.
+	void reset(MYFLT *, size_t, const QString&, Polarity,
+			   MYFLT, MYFLT, MYFLT, MYFLT, bool, WINDAT *original);
+	size_t capacity() const { return m_capacity; }
+	size_t memoryUsage() const; // Bytes allocated for this curve
 	//    uintptr_t get_id() const;
 	//     MYFLT *get_data() const;
 	MYFLT get_data(int index);
+	const MYFLT *data() const { return m_data; } // get_size() points, GUI thread only
 	size_t get_size() const;      // number of points
     QString get_caption() const; // original caption of curve
     Polarity get_polarity() const; // polarity
@@ -74,11 +81,35 @@ public:
 	void set_y_scale(MYFLT y_scale);    // Y axis scaling factor
 	void setOriginal(WINDAT *windat);
 
+	// Called from the Csound display callback. Copies windat into the back
+	// buffer and makes it the front one, without locking or allocating.
+	// Points beyond the size the curve was created with are dropped.
+	void write(const WINDAT *windat);
+	// Called from the GUI thread. Takes the front buffer if it changed since
+	// the last call, returns false if there was nothing new.
+	bool readSnapshot();
+	unsigned int snapshotCount() const { return m_readFlips; } // Changes when data() does
+
 	bool is_divider_dotted() const; // Add dotted divider when true
 	bool has_same_caption(Curve *) const;
+
+	std::atomic<Curve *> dirtyNext;  // Used by DirtyList
+	std::atomic<bool> dirtyQueued;
+
 private:
 	//    uintptr_t m_id;
-	MYFLT *m_data;
+	MYFLT *m_data; // Data shown, only used from the GUI thread
+	MYFLT *m_readBuffer; // Where readSnapshot() copies to before swapping with m_data
+	// Snapshots written by write(). The front one is m_flips & 1.
+	struct Snapshot {
+		MYFLT *data;
+		size_t size;
+		MYFLT max, min, absmax;
+	};
+	Snapshot m_snapshots[2];
+	size_t m_capacity;
+	std::atomic<unsigned int> m_flips; // Number of snapshots written
+	unsigned int m_readFlips; // Value of m_flips at the last readSnapshot()
 	WINDAT *m_original;
 	size_t m_size;
 	QString m_caption;
@@ -87,6 +118,8 @@ private:
 	MYFLT m_max, m_min, m_absmax, m_y_scale;
 	bool m_dotted_divider;
 	void copy(size_t, MYFLT *);
+	void allocate(size_t capacity);
+	void init(MYFLT *, size_t, Polarity, MYFLT, MYFLT, MYFLT, MYFLT, bool, WINDAT *);
 	void destroy();
     CurveType m_curveType;
 
@@ -40,6 +40,7 @@
 #include "console.h"
 #include "midilearndialog.h"
 #include "qutebutton.h"
+#include "csdloader.h"
 
 #include <QMessageBox>
 
@@ -52,8 +53,8 @@ DocumentPage::DocumentPage(QWidget *parent, OpEntryParser *opcodeTree,
 	m_view->showLineArea(true);
 	m_midiLearn = midiLearn;
     m_colorTheme = "";
-    regexUdo.setPattern("\\n\\s*\\bopcode\\s+(\\w+)\\s*,\\s*[a-zA-Z0\\[\\]]+\\s*,\\s*[a-zA-Z0\\[\\]]+");
     m_parseUdosNeeded = true;
+    m_externalScoreLines = 0;
 	foreach(WidgetLayout* wl, m_widgetLayouts) {
 		connect(wl, SIGNAL(changed()), this, SLOT(setModified()));
         connect(wl, SIGNAL(widgetSelectedSignal(QuteWidget*)),
@@ -103,6 +104,7 @@ int DocumentPage::setTextString(QString &text)
 {
 	int ret = 0;
 	deleteAllLiveEvents();
+	setExternalScore(QString(), QString());
 	if (!fileName.endsWith(".csd") && !fileName.isEmpty()) {
         // Put all text since not a csd file (and not default file which has no name)
         m_view->setFullText(text, true);
@@ -110,10 +112,15 @@ int DocumentPage::setTextString(QString &text)
 		return ret;
 	}
     auto t0 = std::chrono::high_resolution_clock::now();
-    parseAndRemoveWidgetText(text);
+    // Sections not shown in the editor are taken out in a single pass
+    CsdParts parts = CsdLoader::split(text, m_externalScoreLines);
+    loadWidgetPanels(parts.panels, parts.presets);
     auto t1 = std::chrono::high_resolution_clock::now();
     auto diff = std::chrono::duration<double, std::milli>(t1-t0).count();
-    QDEBUG << "parseAndRemoveWidgetText:" << diff << "ms";
+    QDEBUG << "split and load widgets:" << diff << "ms";
+    if (!parts.externalScore.isEmpty()) {
+        QDEBUG << parts.externalScoreLines << "score lines kept out of the editor";
+    }
     /*
     if (text.contains("<MacOptions>") && text.contains("</MacOptions>")) {
 		QString options = text.right(text.size()-text.indexOf("<MacOptions>"));
@@ -185,11 +192,7 @@ int DocumentPage::setTextString(QString &text)
 	}
     */
 	// Load Live Event Panels ------------------------
-    while (text.indexOf("<EventPanel") != -1
-           && text.indexOf("<EventPanel") < text.indexOf("</EventPanel>")) {
-		QString liveEventsText = text.mid(text.indexOf("<EventPanel "),
-										  text.indexOf("</EventPanel>") - text.indexOf("<EventPanel ") + 13
-										  + (text[text.indexOf("</EventPanel>") + 14] == '\n' ? 1:0));
+	foreach (QString liveEventsText, parts.eventPanels) {
 		QDomDocument doc("doc");
 		doc.setContent(liveEventsText);
 		QDomElement panelElement = doc.firstChildElement("EventPanel");
@@ -221,14 +224,14 @@ int DocumentPage::setTextString(QString &text)
 			panel->resize(width, height);
 		}
 		panel->hide();
-		text.remove(liveEventsText);
 	}
 	//  if (m_liveFrames.size() == 0) {
 	//    LiveEventFrame *e = createLiveEventPanel();
 	//    e->setFromText(QString()); // Must set blank for undo history point
     //  }
     // This must be last as some of the text has been removed along the way
-    m_view->setFullText(text,true);
+    m_view->setFullText(parts.text, true);
+    setExternalScore(parts.externalScore, parts.scoreStub);
     m_view->setModified(false);
     // This ensures that modifications triggered later by the maineditor
     // do not set the modified status of the page when a file is first
@@ -257,11 +260,13 @@ void DocumentPage::insertText(QString text, int section)
 
 void DocumentPage::setFullText(QString text)
 {
+	setExternalScore(QString(), QString()); // Replaced by the new text
 	return m_view->setFullText(text);
 }
 
 void DocumentPage::setBasicText(QString text)
 {
+	setExternalScore(QString(), QString()); // Replaced by the new text
 	return m_view->setBasicText(text);
 }
 
@@ -272,6 +277,7 @@ void DocumentPage::setOrc(QString text)
 
 void DocumentPage::setSco(QString text)
 {
+	setExternalScore(QString(), QString()); // Replaced by the new text
 	return m_view->setSco(text);
 }
 
@@ -1607,7 +1613,10 @@ LiveEventFrame * DocumentPage::createLiveEventPanel(QString text)
 			this, SLOT(setPanelLoopEnabled(LiveEventFrame *,bool)));
 	connect(e, SIGNAL(setLoopLengthFromPanel(LiveEventFrame *, double)),
 			this, SLOT(setPanelLoopLength(LiveEventFrame *,double)));
-	connect(e->getSheet(), SIGNAL(sendEvent(QString)),this,SLOT(queueEvent(QString)));
+	connect(e->getSheet(), SIGNAL(sendEvent(QString,double)),this,SLOT(queueEvent(QString,double)));
+	connect(e->getSheet(), SIGNAL(sendLoopEvent(QString,double,int)),
+			this, SLOT(queueEvent(QString,double,int)));
+	connect(e->getSheet(), SIGNAL(cancelLoopEvents(int)), this, SLOT(cancelEvents(int)));
 	connect(e->getSheet(), SIGNAL(modified()),this,SLOT(setModified()));
 	return e;
 }
@@ -1734,20 +1743,10 @@ void DocumentPage::setParsedUDOs(QStringList udos) {
 void DocumentPage::parseUdos(bool force) {
     if(!m_parseUdosNeeded && !force)
         return;
-    auto text = this->getBasicText();
-    QRegularExpressionMatchIterator i = regexUdo.globalMatch(text);
-    int numUdos = m_parsedUdos.size();
-    m_parsedUdos.clear();
-    while(i.hasNext()) {
-        QRegularExpressionMatch match = i.next();
-        QString udoName = match.captured(1);
-        m_parsedUdos.append(udoName);
-    }
-    auto highlighter = m_view->getHighlighter();
-    highlighter->setUDOs(m_parsedUdos);
-    if(numUdos != m_parsedUdos.size()) {
-        highlighter->rehighlight();
-    }
+    // The structure index is kept up to date as the text is edited
+    m_parsedUdos = m_view->getStructureIndex()->udoNames();
+    // Rehighlights the blocks using an opcode that was added or removed
+    m_view->getHighlighter()->setUDOs(m_parsedUdos);
     m_parseUdosNeeded = false;
 }
 
@@ -68,6 +68,8 @@ public:
     void setHighlightingTheme(QString theme);
     void setParsedUDOs(QStringList udos);
     void enableScoreSyntaxHighlighting(bool status);
+    // Scores longer than this are kept out of the editor when loading (0 = never)
+    void setExternalScoreLines(int lines) { m_externalScoreLines = lines; }
     virtual QString getFullText();
 	QString getDotText();
 	QString getMacWidgetsText();
@@ -270,7 +272,7 @@ private:
     QString m_colorTheme;
     QStringList m_parsedUdos;
     bool m_parseUdosNeeded;
-    QRegularExpression regexUdo;
+    int m_externalScoreLines;
 
 private slots:
 	void textChanged();
@@ -65,14 +65,18 @@ DocumentView::DocumentView(QWidget * parent, OpEntryParser *opcodeTree) :
     connect(m_orcEditor, SIGNAL(textChanged()), this, SLOT(textChanged()));
 	connect(m_orcEditor, SIGNAL(cursorPositionChanged()),
             this, SLOT(syntaxCheck()));
+	connect(m_orcEditor, SIGNAL(cursorPositionChanged()),
+            this, SLOT(updateContext()));
 	setFocusProxy(m_mainEditor);  // for comment action from main application
 	internalChange = false;
 
     //  m_highlighter = new Highlighter();
     connect(m_mainEditor, SIGNAL(textChanged()),
             this, SLOT(textChanged()));
-    // connect(m_mainEditor, SIGNAL(cursorPositionChanged()),
-    //        this, SLOT(updateContext()));
+    connect(m_mainEditor, SIGNAL(cursorPositionChanged()),
+            this, SLOT(updateContext()));
+    connect(&m_structure, SIGNAL(structureChanged()),
+            this, SLOT(structureChanged()));
     connect(m_mainEditor, SIGNAL(cursorPositionChanged()),
             this, SLOT(syntaxCheck()));
 	connect(m_mainEditor, SIGNAL(escapePressed()),
@@ -116,6 +120,8 @@ DocumentView::DocumentView(QWidget * parent, OpEntryParser *opcodeTree) :
 	setAcceptDrops(true);
 
 	m_oldCursorPosition = -1; // 0 or positive, if cursor needs to be moved there
+	m_currentContext = DocumentView::NO_CONTEXT;
+	m_contextDirty = true;
     markCurrentPosition();
 
 }
@@ -157,100 +163,51 @@ void DocumentView::print(QPrinter *printer)
 
 void DocumentView::updateContext()
 {
-    // this code is too expensive to be run at EACH keystroke. We need to think of something better
-    // Until then I am disabling it (EM, Nov. 21)
-    return;
-	QStringList contextStart;
-	contextStart << "<CsInstruments>" << "<CsScore" << "<CsOptions>";
-	QTextCursor cursor = m_mainEditor->textCursor();
-	cursor.select(QTextCursor::LineUnderCursor);
-	QString line = cursor.selection().toPlainText().simplified();
-	while (!cursor.atStart()) {
-		foreach(QString startText, contextStart) {
-			if (line.startsWith(startText)) {
-				m_currentContext = contextStart.indexOf(startText) + 1;
-				break;
-			}
-		}
-		cursor.movePosition(QTextCursor::Up);
-		cursor.select(QTextCursor::BlockUnderCursor);
-		line = cursor.selection().toPlainText();
-		cursor.movePosition(QTextCursor::StartOfBlock);
+	// Only looks up the cursor's block in the structure index, so the cost
+	// does not depend on the size of the file
+	QTextEdit *editor = m_viewMode < 2 ? m_mainEditor : m_orcEditor;
+	int line = editor->textCursor().blockNumber();
+	switch (m_structure.sectionAt(line)) {
+	case CsdStructureIndex::InstrumentsSection:
+		m_currentContext = DocumentView::ORC_CONTEXT;
+		break;
+	case CsdStructureIndex::ScoreSection:
+		m_currentContext = DocumentView::SCO_CONTEXT;
+		break;
+	case CsdStructureIndex::OptionsSection:
+		m_currentContext = DocumentView::OPTIONS_CONTEXT;
+		break;
+	default:
+		// A plain orc (or the orc editor in split view) has no section tags
+		m_currentContext = (m_viewMode >= 2 || m_structure.sections().isEmpty()) ?
+					DocumentView::ORC_CONTEXT : DocumentView::NO_CONTEXT;
 	}
 	if (m_currentContext == DocumentView::ORC_CONTEXT) { // Instrument section
-		QString endText = "</CsInstruments>";
-		QTextCursor linecursor = cursor;
-		linecursor.select(QTextCursor::LineUnderCursor);
-		line = linecursor.selection().toPlainText();
-		linecursor.movePosition(QTextCursor::EndOfLine);
-		while (!linecursor.atEnd() && !line.contains(endText)) {
-			cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor);
-			cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
-			linecursor = cursor;
-			linecursor.select(QTextCursor::LineUnderCursor);
-			line = linecursor.selection().toPlainText();
-			linecursor.movePosition(QTextCursor::EndOfLine);
-		}
-		QString orc = cursor.selection().toPlainText();
-        updateOrcContext(orc);
+		updateOrcContext(line);
 	}
 }
 
-void DocumentView::updateOrcContext(QString orc)
+void DocumentView::updateOrcContext(int line)
 {
-    // This is disabled at the moment since updateContext is itself disabled
-    (void) orc;
-	// TODO: add string as context
-	QStringList innerContextStart;
-	innerContextStart << "instr" << "opcode";
-	QTextCursor cursor = m_mainEditor->textCursor();
-	cursor.select(QTextCursor::LineUnderCursor);
-	QString line = cursor.selection().toPlainText().trimmed();
-    while (!cursor.atStart()) {
-		foreach(QString startText, innerContextStart) {
-			if (line.startsWith(startText)) {
-				break;
-			}
-		}
-		cursor.movePosition(QTextCursor::Up);
-		cursor.select(QTextCursor::BlockUnderCursor);
-		line = cursor.selection().toPlainText().trimmed();
-		cursor.movePosition(QTextCursor::StartOfBlock);
-	}
-	cursor.movePosition(QTextCursor::NextBlock);
-	QString endText = "endin";
-	QTextCursor linecursor = cursor;
-	linecursor.select(QTextCursor::LineUnderCursor);
-	line = linecursor.selection().toPlainText().trimmed();
-	linecursor.movePosition(QTextCursor::EndOfLine);
-	while (!linecursor.atEnd() && !line.startsWith(endText)) {
-		cursor.movePosition(QTextCursor::NextBlock, QTextCursor::KeepAnchor);
-		cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
-		linecursor = cursor;
-		linecursor.select(QTextCursor::LineUnderCursor);
-		line = linecursor.selection().toPlainText().trimmed();
-		linecursor.movePosition(QTextCursor::EndOfLine);
-	}
-	QString instr = cursor.selection().toPlainText();
-    auto lines = instr.splitRef("\n", SKIP_EMPTY_PARTS);
-
-    auto rxWordSplit = QRegularExpression("[\\s,+-/\\*\\.\\^\\(\\)\\[\\]$]");
-	m_localVariables.clear();
-    QSet<QString> seen;
-    for(auto line: lines) {
-        line = line.trimmed();
-        if (line.isEmpty() || line.startsWith(";")) {
-			continue;
-		}
-        auto words = line.toString().split(rxWordSplit, SKIP_EMPTY_PARTS);
-        for(auto word: words) {
-            if(!seen.contains(word) && !m_opcodeTree->isOpcode(word)) {
-                seen.insert(word);
-            }
-		}
+	CsdStructureIndex::Span span = m_structure.spanAt(line);
+	if (!m_contextDirty && span.firstLine == m_contextSpan.firstLine
+			&& span.lastLine == m_contextSpan.lastLine) {
+		return;
+	}
+	m_contextSpan = span;
+	m_contextDirty = false;
+	if (span.isValid()) {
+		m_localVariables = m_structure.declaredVariables(span.firstLine, span.lastLine);
+	}
+	else {
+		m_localVariables.clear();
 	}
-    //m_localVariables = QStringList(seen.begin(), seen.end());
-    m_localVariables = seen.values();
+	m_globalVariables = m_structure.globalVariables();
+}
+
+void DocumentView::structureChanged()
+{
+	m_contextDirty = true;
 }
 
 void DocumentView::nextParameter()
@@ -448,14 +405,17 @@ void DocumentView::setViewMode(int mode)
 	case 0: // csd without extra sections
 		m_mainEditor->show();
         m_highlighter.setDocument(m_mainEditor->document());
+        m_structure.setDocument(m_mainEditor->document());
         break;
 	case 1: // full plain text
 		m_mainEditor->show();
 		m_highlighter.setDocument(m_mainEditor->document());
+		m_structure.setDocument(m_mainEditor->document());
 
 		break;
 	default:
 		m_highlighter.setDocument(m_orcEditor->document());
+		m_structure.setDocument(m_orcEditor->document());
 		m_orcEditor->setVisible(m_viewMode & 2);
 		m_scoreEditor->setVisible(m_viewMode & 4);
 		m_optionsEditor->setVisible(m_viewMode & 8);
@@ -840,20 +800,8 @@ void DocumentView::createParenthesisSelection(int pos, bool paired)
 
 
 const QStringList DocumentView::getAllWords() {
-    // All words are parsed at max. each 4 seconds
-    const int minMsecsFromLastParsing = 4000;
-    auto now = QTime::currentTime();
-    int msecs = m_lastWordsUpdate.msecsTo(now);
-    if(m_allWords.isEmpty() || msecs > minMsecsFromLastParsing) {
-        QDEBUG << "Updating all words, time since last update: " << msecs << "msecs";
-        TextEditor *editor = m_mainEditor;
-        QString wholeText = editor->toPlainText();
-        auto allWords = wholeText.split(QRegularExpression("[" + QRegularExpression::escape("+-*/=#&,\"\'|[]()<>.;:^") + "\\s]"), SKIP_EMPTY_PARTS);
-        allWords.removeDuplicates();
-        m_lastWordsUpdate = now;
-        m_allWords = allWords;
-    }
-    return m_allWords;
+    // Words are counted per line as the text is edited
+    return m_structure.words();
 }
 
 
@@ -935,19 +883,25 @@ void DocumentView::autoCompleteAtCursor() {
     }
     else if (cursor.position() > cursor.anchor() && word.size() > 2 && !word.startsWith("\"")) { // Only at the end of the word
         syntaxMenu->clear();
-        foreach(QString var, m_localVariables) {
-            if (var.endsWith(',')) {
-                var.chop(1);
-            }
-            if (var.startsWith(word) && word != var) {
+        // variables declared in the current instrument, globals and macros
+        foreach(QString var, m_localVariables + m_globalVariables + m_structure.macros()) {
+            if (var.startsWith(word) && word != var && !menuWordsSeen.contains(var)) {
                 QAction *a = syntaxMenu->addAction(var, this,
                                                    SLOT(insertAutoCompleteText())); // was: insertParameterText that does not exist any more
                 a->setData(var);
                 showSyntaxMenu = true;
+                menuWordsSeen.insert(var);
             }
         }
-        // opcodes and parameters
+        // opcodes and parameters, the ones used most in this document first
         auto opcodedefs = m_opcodeTree->getMatchingOpcodes(word);
+        std::stable_sort(opcodedefs.begin(), opcodedefs.end(),
+                         [this](const Opcode &a, const Opcode &b) {
+            return m_structure.wordCount(a.opcodeName) > m_structure.wordCount(b.opcodeName);
+        });
+        if (opcodedefs.size() > QCS_MAX_COMPLETIONS) {
+            opcodedefs.resize(QCS_MAX_COMPLETIONS);
+        }
         bool allEqual = true;
         for(int i = 0; i < opcodedefs.size(); i++) {
             if (opcodedefs[i].opcodeName != word) {
@@ -1012,24 +966,23 @@ void DocumentView::autoCompleteAtCursor() {
             syntaxMenu->addSeparator();
         }
         // check for autcompletion from ALL words in text editor
-        auto allWords = getAllWords();
-        QStringList menuWords;
         QString wordlow = word.toLower(); // this must be AFTER the word is corrected
 
         // any word [was: variables ]
         //QRegularExpression rxVariables("\\b(g)?[iakS][a-zA-Z0-9_]+"); // this only matches variable names
         static QRegularExpression rxAnyWord("\\b[A-Za-z][a-zA-Z0-9_]*\\b" ); // any word that starts with a letter
         QRegularExpressionMatch match = rxAnyWord.match(word);
-        for(auto theWord: allWords) {
-            if (word != theWord &&
-                    theWord.toLower().startsWith(wordlow) &&
-                   !menuWordsSeen.contains(theWord)  &&
-                    /* rxVariables.match(word).hasMatch() */
-                    match.hasMatch()    ) {
-                auto a = syntaxMenu->addAction(theWord, this, SLOT(insertAutoCompleteText()));
-                a->setData(theWord);
-                showSyntaxMenu = true;
-                menuWordsSeen.insert(theWord);
+        if (match.hasMatch()) {
+            // one extra, the word being typed is in the document too
+            auto matches = m_structure.completeWord(word, QCS_MAX_COMPLETIONS + 1);
+            for(auto &entry: matches) {
+                const QString &theWord = entry.word;
+                if (word != theWord && !menuWordsSeen.contains(theWord)) {
+                    auto a = syntaxMenu->addAction(theWord, this, SLOT(insertAutoCompleteText()));
+                    a->setData(theWord);
+                    showSyntaxMenu = true;
+                    menuWordsSeen.insert(theWord);
+                }
             }
         }
 
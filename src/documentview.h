@@ -28,10 +28,13 @@
 #include <QtPrintSupport/QPrintDialog>
 
 #include "baseview.h"
+#include "csdstructureindex.h"
 
 #include <QKeyEvent> // For syntax menu class
 #include <QPair>
 
+#define QCS_MAX_COMPLETIONS 30 // Per kind of completion (opcodes, words)
+
 class MySyntaxMenu: public QMenu
 {
 	Q_OBJECT
@@ -99,6 +102,7 @@ public:
 	void createParenthesisSelection(int pos, bool paired=true);
     void setParsedUDOs(QStringList udos);
     Highlighter* getHighlighter() { return &m_highlighter; }
+    CsdStructureIndex* getStructureIndex() { return &m_structure; }
     void gotoLineDialog();
     void markCurrentPosition();
     const QStringList getAllWords();
@@ -119,7 +123,7 @@ public slots:
     void findString(QString query = QString());
 	void evaluate();
 	void updateContext();
-	void updateOrcContext(QString orc);
+	void updateOrcContext(int line);
 	void nextParameter();
 	void prevParameter();
 	void showHoverText();
@@ -188,8 +192,7 @@ private:
 	QString lastReplace;
 	QStringList m_localVariables;
 	QStringList m_globalVariables;
-    QTime m_lastWordsUpdate;
-    QStringList m_allWords;
+    CsdStructureIndex m_structure;
     int m_lastCursorPosition;
     QStringList m_longOptions = {
         "syntax-check-only", "control-rate=", "messagelevel=",
@@ -213,9 +216,12 @@ private:
 		NO_CONTEXT
 	};
 	int m_currentContext;
+	CsdStructureIndex::Span m_contextSpan; // instr/opcode holding the cursor
+	bool m_contextDirty;
 	int m_oldCursorPosition; // if necessary to move back, like after evaluateSection
 
 private slots:
+	void structureChanged();
 	void destroySyntaxMenu();
 	void opcodeHelp();
 	void restoreCursorPosition();
@@ -148,6 +148,9 @@ EventSheet::EventSheet(QWidget *parent) : QTableWidget(parent)
 	m_name = "Events";
 	m_stopScript = false;
 	m_looping = false;
+	m_nextLoopTime = 0.0;
+	static int loopTags = 0;
+	m_loopTag = ++loopTags;
 	createActions();
 	connect(this, SIGNAL(itemSelectionChanged()), this, SLOT(newSelection()));
 	// a bit of a hack to ensure that manual changes to the sheet are stored in the
@@ -430,10 +433,21 @@ void EventSheet::sendEvents()
 {
 	QModelIndexList list;
 	QPair<int, int> rowsRange;
-	if (m_looping && sender() != sendEventsAct) {
-		double time = 1000.0 * m_loopLength * 60.0 /m_tempo;
-		loopTimer.start(time);
-		qDebug() << " EventSheet::sendEvents() " << time;
+	double delay = 0.0;
+	bool loopPass = m_looping && sender() != sendEventsAct;
+	if (loopPass) {
+		// Each pass is queued a little ahead of time with the delay left until
+		// it is due, so the engine starts it on the right sample no matter
+		// when the timer fires.
+		double period = m_loopLength * 60.0 /m_tempo;
+		double now = loopClock.elapsed() / 1000.0;
+		if (m_nextLoopTime < now) { // Too late, restart the loop from now
+			m_nextLoopTime = now;
+		}
+		delay = m_nextLoopTime - now;
+		m_nextLoopTime += period;
+		double lookahead = qMin(period / 2.0, 0.25);
+		loopTimer.start(qMax(0, (int) ((m_nextLoopTime - lookahead - now) * 1000.0)));
 		rowsRange.first = m_loopStart;
 		rowsRange.second = m_loopEnd;
 	}
@@ -442,7 +456,12 @@ void EventSheet::sendEvents()
 	}
 	for (int i = rowsRange.first; i <= rowsRange.second; i++) {
 		//    double number = 0.0;
-		emit sendEvent(getLine(i, true, true, true));  // With tempo scaling
+		if (loopPass) {
+			emit sendLoopEvent(getLine(i, true, true, true), delay, m_loopTag);  // With tempo scaling
+		}
+		else {
+			emit sendEvent(getLine(i, true, true, true), delay);  // With tempo scaling
+		}
 	}
 }
 
@@ -450,7 +469,7 @@ void EventSheet::sendAllEvents()
 {
 	for (int i = 0; i < this->rowCount(); i++) {
 		//    qDebug() << "EventSheet::sendAllEvents() " << i;
-		emit sendEvent(getLine(i, true, true, true));  // With tempo scaling
+		emit sendEvent(getLine(i, true, true, true), 0.0);  // With tempo scaling
 	}
 }
 
@@ -481,7 +500,7 @@ void EventSheet::sendEventsOffset()
 		minTime = 0.0;
 	for (int i = 0; i < selectedRows.size(); i++) {
 		//    double number = 0.0;
-		emit sendEvent(getLine(selectedRows[i], true, true, true, -minTime));  // With tempo scaling
+		emit sendEvent(getLine(selectedRows[i], true, true, true, -minTime), 0.0);  // With tempo scaling
 	}
 }
 
@@ -499,11 +518,17 @@ void EventSheet::setLoopActive(bool loop)
 	if (loop) {
 		if (!m_looping) {
 			m_looping = true;
+			loopClock.start();
+			m_nextLoopTime = 0.0;
 			markLoop(m_loopStart, m_loopEnd);
 			sendEvents();
 		}
 	}
 	else {
+		if (m_looping) {
+			loopTimer.stop();
+			emit cancelLoopEvents(m_loopTag); // The next pass may already be queued
+		}
 		m_looping = false;
 		markLoop(m_loopStart, m_loopEnd);
 	}
@@ -548,13 +573,14 @@ void EventSheet::setLoopRange()
 void EventSheet::stopAllEvents()
 {
 	loopTimer.stop();
+	emit cancelLoopEvents(m_loopTag); // The next pass may already be queued
 	m_looping = false;
 	markLoop();
 	while (!activeInstruments.isEmpty()) {
 		QString event = "i -";
 		event += QString::number(activeInstruments.takeFirst(), 'f', 10);
 		event += " 0 1";
-		emit sendEvent(event);
+		emit sendEvent(event, 0.0);
 	}
 }
 
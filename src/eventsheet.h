@@ -27,6 +27,7 @@
 #include <QStandardItemModel>
 #include <QAction>
 #include <QTimer>
+#include <QElapsedTimer>
 
 class EventSheet : public QTableWidget
 {
@@ -164,6 +165,9 @@ private:
 
 	// Looping
 	QTimer loopTimer;
+	QElapsedTimer loopClock; // Started with the loop, passes are timed against it
+	double m_nextLoopTime; // Time in seconds on loopClock of the next pass
+	int m_loopTag; // Tag of the loop events, cancelled when the loop stops
 	int m_loopStart, m_loopEnd; // Start and end rows for looping (both inclusive)
 	//    QModelIndexList  loopList;
 
@@ -182,7 +186,9 @@ private slots:
 	void runScript();
 
 signals:
-	void sendEvent(QString event);
+	void sendEvent(QString event, double delay); // delay in seconds
+	void sendLoopEvent(QString event, double delay, int tag); // Can be cancelled with the tag
+	void cancelLoopEvents(int tag);
 	void setLoopRangeFromSheet(double start, double end);
 	void setLoopEnabledFromSheet(bool enabled);
 	//    void cellDoubleClicked();
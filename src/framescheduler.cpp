@@ -0,0 +1,138 @@
+/*
+	Copyright (C) 2026 The CsoundQt contributors
+
+	This file is part of CsoundQt.
+
+	CsoundQt is free software; you can redistribute it
+	and/or modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	CsoundQt is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with Csound; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+	02111-1307 USA
+*/
+
+#include "framescheduler.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+#include <QtMath>
+
+FrameScheduler *FrameScheduler::instance()
+{
+	static FrameScheduler *scheduler = new FrameScheduler(qApp);
+	return scheduler;
+}
+
+FrameScheduler::FrameScheduler(QObject *parent) : QObject(parent)
+{
+	m_inFrame = false;
+	m_lastStats = 0;
+	m_frameTime = 0.0;
+	m_divider = 1;
+	m_screenInterval = 16;
+	m_interval = 16;
+	m_clock.start();
+	m_timer.setTimerType(Qt::PreciseTimer);
+	connect(&m_timer, SIGNAL(timeout()), this, SLOT(frame()));
+	connect(qApp, SIGNAL(primaryScreenChanged(QScreen*)), this, SLOT(updateScreenInterval()));
+	updateScreenInterval();
+}
+
+void FrameScheduler::addClient(FrameClient *client)
+{
+	if (m_clients.contains(client))
+		return;
+	m_clients.append(client);
+	m_lastUpdate.append(0);
+	if (!m_timer.isActive()) {
+		m_timer.start(m_interval);
+	}
+}
+
+void FrameScheduler::removeClient(FrameClient *client)
+{
+	int index = m_clients.indexOf(client);
+	if (index < 0)
+		return;
+	if (m_inFrame) { // Compacted at the end of the pass
+		m_clients[index] = nullptr;
+		return;
+	}
+	m_clients.remove(index);
+	m_lastUpdate.remove(index);
+	if (m_clients.isEmpty()) {
+		m_timer.stop();
+	}
+}
+
+void FrameScheduler::updateScreenInterval()
+{
+	QScreen *screen = QGuiApplication::primaryScreen();
+	qreal rate = screen ? screen->refreshRate() : 60.0;
+	if (rate < 30.0 || rate > 240.0) { // Some platforms report 0 or nonsense
+		rate = 60.0;
+	}
+	m_screenInterval = qMax(1, qFloor(1000.0 / rate));
+	setInterval(m_screenInterval * m_divider);
+}
+
+void FrameScheduler::setInterval(int interval)
+{
+	if (interval == m_interval)
+		return;
+	m_interval = interval;
+	if (m_timer.isActive()) {
+		m_timer.start(m_interval);
+	}
+}
+
+void FrameScheduler::frame()
+{
+	qint64 start = m_clock.elapsed();
+	m_inFrame = true;
+	// Clients added during the pass are updated on the next one
+	int count = m_clients.size();
+	for (int i = 0; i < count; i++) {
+		FrameClient *client = m_clients[i];
+		if (client == nullptr)
+			continue;
+		if (!client->frameVisible() && start - m_lastUpdate[i] < QCS_HIDDEN_FRAME_MS)
+			continue;
+		m_lastUpdate[i] = start;
+		client->updateFrame();
+	}
+	m_inFrame = false;
+	for (int i = m_clients.size() - 1; i >= 0; i--) {
+		if (m_clients[i] == nullptr) {
+			m_clients.remove(i);
+			m_lastUpdate.remove(i);
+		}
+	}
+	if (m_clients.isEmpty()) {
+		m_timer.stop();
+	}
+
+	// Back off while the GUI thread can't keep up, come back when it can
+	qint64 now = m_clock.elapsed();
+	m_frameTime = 0.9 * m_frameTime + 0.1 * (now - start);
+	double budget = m_screenInterval * m_divider * 0.5;
+	if (m_frameTime > budget && m_divider < QCS_MAX_FRAME_DIVIDER) {
+		m_divider++;
+	}
+	else if (m_divider > 1 && m_frameTime < budget * 0.25) {
+		m_divider--;
+	}
+	setInterval(m_screenInterval * m_divider);
+	if (now - m_lastStats >= 1000) {
+		m_lastStats = now;
+		emit frameStats(m_frameTime, m_interval);
+	}
+}
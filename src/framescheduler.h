@@ -0,0 +1,85 @@
+/*
+	Copyright (C) 2026 The CsoundQt contributors
+
+	This file is part of CsoundQt.
+
+	CsoundQt is free software; you can redistribute it
+	and/or modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	CsoundQt is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with Csound; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+	02111-1307 USA
+*/
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+
+// Something updated once per display frame by the FrameScheduler
+class FrameClient
+{
+public:
+	virtual ~FrameClient() {}
+	// Hidden clients are only updated once every QCS_HIDDEN_FRAME_MS
+	virtual bool frameVisible() = 0;
+	virtual void updateFrame() = 0;
+};
+
+// Hidden clients still get updated this often so their buffers don't fill up
+#define QCS_HIDDEN_FRAME_MS 1000
+
+// Single timer driving the GUI updates of all widget layouts and consoles.
+// It ticks at the refresh rate of the screen and runs all clients in one
+// pass. When the passes take more than half of the frame, the interval is
+// stretched (up to QCS_MAX_FRAME_DIVIDER frames) until they fit again.
+class FrameScheduler : public QObject
+{
+	Q_OBJECT
+public:
+	static FrameScheduler *instance();
+
+	void addClient(FrameClient *client);
+	void removeClient(FrameClient *client);
+	double frameTime() const { return m_frameTime; } // Average time of a pass in ms
+	int frameInterval() const { return m_interval; } // Current time between passes in ms
+	int screenInterval() const { return m_screenInterval; } // Duration of a display frame in ms
+
+signals:
+	// Emitted about once a second
+	void frameStats(double frameTime, int frameInterval);
+
+private slots:
+	void frame();
+	void updateScreenInterval();
+
+private:
+	FrameScheduler(QObject *parent = 0);
+	void setInterval(int interval);
+
+	QTimer m_timer;
+	QVector<FrameClient *> m_clients;
+	QVector<qint64> m_lastUpdate; // Time of the last update of each client
+	bool m_inFrame;
+	QElapsedTimer m_clock;
+	qint64 m_lastStats;
+	double m_frameTime;
+	int m_screenInterval;
+	int m_divider; // Number of display frames per pass
+	int m_interval;
+};
+
+#define QCS_MAX_FRAME_DIVIDER 8
+
+#endif // FRAMESCHEDULER_H
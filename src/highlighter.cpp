@@ -24,6 +24,7 @@
 
 #include <QDebug>
 #include <QRegularExpression>
+#include <QTextBlock>
 
 
 TextBlockData::TextBlockData()
@@ -466,6 +467,41 @@ Highlighter::Highlighter(QTextDocument *parent)
     rxScoreLetter.setPattern("^\\s*(i|f|e|d|s)");
     rxQuotation.setPattern("\"[^\"]*\"");
 
+    // Every expression used per block is compiled once here
+    rxCsdTag.setPattern("^\\s*<\\/?(CsInstruments|CsOptions|CsoundSynthesizer|CsScore|CsFileB|CsLicense|html).*>");
+    rxDefine.setPattern("^\\s*#define\\s+[_\\w\\ \\t]*#.*#");
+    rxInstrDeclaration.setPattern("^\\s*\\b(instr|opcode)\\s+(\\w+)\\b");
+    rxOperator.setPattern(R"(&&|==|\|\||<|>|<=|>=|!=|\\)");
+    rxWord.setPattern("\\b[\\w:]+\\b");
+    rxPfield.setPattern("\\bp[\\d]+\\b");
+    rxSingleQuotation.setPattern("'[^'']*'");
+    rxPythonKeywords.setPattern("\\b(" + pythonKeywords.join("|") + ")\\b");
+    rxPythonComment.setPattern("#.*");
+    rxHtmlKeywords.setPattern("(" + htmlKeywords.join("|") + ")");
+    rxJsKeywords.setPattern("\\b(" + javascriptKeywords.join("|") + ")\\b");
+    rxHtmlEndTag.setPattern(">$");
+    rxLineComment.setPattern("//.*");
+    rxHtmlCommentStart.setPattern("<!--");
+    rxHtmlCommentEnd.setPattern("-->");
+    for (auto rx: {&commentStartExpression, &commentEndExpression, &rxScoreLetter, &rxQuotation,
+                   &rxCsdTag, &rxDefine, &rxInstrDeclaration, &rxOperator, &rxWord, &rxPfield,
+                   &rxSingleQuotation, &rxPythonKeywords, &rxPythonComment, &rxHtmlKeywords,
+                   &rxJsKeywords, &rxHtmlEndTag, &rxLineComment, &rxHtmlCommentStart,
+                   &rxHtmlCommentEnd, &csoundOptionsRx}) {
+        rx->optimize();
+    }
+
+    // Word lookups done for every word of the orchestra
+    m_instWords = QSet<QString>(instPatterns.begin(), instPatterns.end());
+    m_headerWords = QSet<QString>(headerPatterns.begin(), headerPatterns.end());
+    m_keywordWords = QSet<QString>(keywordLiterals.begin(), keywordLiterals.end());
+    m_ioWords = QSet<QString>(ioPatterns.begin(), ioPatterns.end());
+    for (auto tag: tagPatterns) {
+        if (!tag.startsWith("</")) {
+            m_tagNames.insert(tag.mid(1, tag.size() - 2)); // "<CsScore>" -> "CsScore"
+        }
+    }
+
     // this->setTheme("classic");
 }
 
@@ -476,7 +512,6 @@ Highlighter::~Highlighter()
 
 void Highlighter::setOpcodeNameList(QStringList list)
 {
-	m_opcodeList = list;
     // m_opcodesSet = list.toSet();
     m_opcodesSet = QSet<QString>(list.begin(), list.end());  // Use the newer form for better future compatibility with qt6
     //   setFirstRules();
@@ -534,18 +569,9 @@ void Highlighter::highlightBlock(const QString &text)
     }
     setCurrentBlockUserData(data);
 
-    if(m_theme != "none") {
-        // find previous valid block
-        auto block = currentBlock().previous();
-        while (block.isValid()) {
-            auto userData = static_cast<TextBlockData*>(block.userData());
-            if(userData != nullptr) {
-                data->section = userData->section;
-                break;
-            }
-            block = block.previous();
-        }
-    }
+    // The section is inherited through the block state, so QSyntaxHighlighter
+    // only moves on to the next block when it changes
+    data->section = sectionFromState(previousBlockState());
 
 	switch (m_mode) {
 	case 0:  // Csound mode
@@ -612,14 +638,15 @@ void Highlighter::highlightScore(const QString &text, int start, int end) {
 
 void Highlighter::highlightCsoundBlock(const QString &line)
 {
-    // TODO: rewrite this using QRegularExpression
-    QRegularExpression rx;
     QRegularExpressionMatch rxmatch;
 
 	// text is processed one line at a time
     if(m_theme == "none")
         return;
 
+    auto blockdata = static_cast<TextBlockData*>(currentBlockUserData());
+    setCurrentBlockState(blockState(blockdata->section, false));
+
     int commentIndex = line.indexOf(';'); // try both comment markings
 	if (commentIndex < 0) {
         commentIndex = line.indexOf("//");
@@ -640,10 +667,7 @@ void Highlighter::highlightCsoundBlock(const QString &line)
     int index = 0;
     int length = 0;
 
-    auto blockdata = static_cast<TextBlockData*>(currentBlockUserData());
-
-    rx.setPattern("^\\s*<\\/?(CsInstruments|CsOptions|CsoundSynthesizer|CsScore|CsFileB|CsLicense|html).*>");
-    rxmatch = rx.match(line);
+    rxmatch = rxCsdTag.match(line);
     if(rxmatch.hasMatch()) {
         if(rxmatch.captured(1) == "CsInstruments") {
             blockdata->section = OrchestraSection;
@@ -654,6 +678,7 @@ void Highlighter::highlightCsoundBlock(const QString &line)
         } else {
             blockdata->section = UnknownSection;
         }
+        setCurrentBlockState(blockState(blockdata->section, false));
         setFormat(rxmatch.capturedStart(), rxmatch.capturedLength(), csdtagFormat);
         return;
     }
@@ -680,34 +705,28 @@ void Highlighter::highlightCsoundBlock(const QString &line)
     auto text = QStringRef(&line, 0, commentIndex);
 
     // define
-    rx.setPattern("^\\s*#define\\s+[_\\w\\ \\t]*#.*#");
-    rxmatch = rx.match(text);
+    rxmatch = rxDefine.match(text);
     if(rxmatch.hasMatch()) {
         setFormat(rxmatch.capturedStart(), rxmatch.capturedLength(), macroDefineFormat);
         return;
     }
 
-    rx.setPattern("^\\s*\\b(instr|opcode)\\s+(\\w+)\\b");
-    rxmatch = rx.match(text);
+    rxmatch = rxInstrDeclaration.match(text);
     if(rxmatch.hasMatch()) {
-        auto group = rxmatch.captured(2);
         setFormat(rxmatch.capturedStart(1), rxmatch.capturedLength(1), instFormat);
         setFormat(rxmatch.capturedStart(2), rxmatch.capturedLength(2), nameFormat);
         return;
     }
 
-    rx.setPattern(R"(&&|==|\|\||<|>|<=|>=|!=|\\)");
     index = 0;
-    while((rxmatch=rx.match(text, index)).hasMatch()) {
+    while((rxmatch=rxOperator.match(text, index)).hasMatch()) {
         length = rxmatch.capturedLength();
         setFormat(rxmatch.capturedStart(), length, operatorFormat);
         index = rxmatch.capturedEnd()+1;
     }
 
-    QRegularExpression expressionRx("\\b[\\w:]+\\b");
-    QRegularExpression pfieldRx("\\bp[\\d]+\\b");
     index = 0;
-    while((rxmatch = expressionRx.match(text, index)).hasMatch()) {
+    while((rxmatch = rxWord.match(text, index)).hasMatch()) {
         int wordStart = rxmatch.capturedStart();
         int wordEnd = rxmatch.capturedEnd();
         index = wordEnd;
@@ -723,25 +742,25 @@ void Highlighter::highlightCsoundBlock(const QString &line)
         }
 		wordEnd = (wordEnd > 0 ? wordEnd : text.size());
         QString word = rxmatch.captured();
-        if(pfieldRx.match(word).hasMatch()) {
+        if(rxPfield.match(word).hasMatch()) {
 			setFormat(wordStart, wordEnd - wordStart, pfieldFormat);
 		}
-        else if(instPatterns.contains(word)) {
+        else if(m_instWords.contains(word)) {
 			setFormat(wordStart, wordEnd - wordStart, instFormat);
             break; // was: return. For any case, to go through lines after while loop
 		}
-        else if(tagPatterns.contains("<" + word + ">") && wordStart > 0) {
+        else if(wordStart > 0 && m_tagNames.contains(word)) {
             setFormat(wordStart - (text[wordStart - 1] == '/'? 2: 1),
                       wordEnd - wordStart + (text[wordStart - 1] == '/'? 3: 2),
                       csdtagFormat);
 		}
-        else if(headerPatterns.contains(word)) {
+        else if(m_headerWords.contains(word)) {
             setFormat(wordStart, wordEnd - wordStart, headerFormat);
 		}
-        else if(keywordLiterals.contains(word)) {
+        else if(m_keywordWords.contains(word)) {
             setFormat(wordStart, wordEnd - wordStart, keywordFormat);
 		}
-        else if(ioPatterns.contains(word)) {
+        else if(m_ioWords.contains(word)) {
             setFormat(wordStart, wordEnd - wordStart, ioFormat);
         }
         else if(word[word.size()-1] != ':' && word.contains(":")) {
@@ -756,7 +775,7 @@ void Highlighter::highlightCsoundBlock(const QString &line)
                 setFormat(wordStart, wordEnd - wordStart, errorFormat);
             }
 		}
-        else if(m_parsedUDOs.contains(word)) {
+        else if(m_udoSet.contains(word)) {
             setFormat(wordStart, wordEnd - wordStart, udoFormat);
         }
         else if(deprecatedOpcodes.contains(word)) {
@@ -801,28 +820,24 @@ void Highlighter::highlightCsoundBlock(const QString &line)
     }
 
     // string
-    rx.setPattern("\"[^\"]*\"");
     index = 0;
-    while ((rxmatch = rx.match(text, index)).hasMatch()) {
+    while ((rxmatch = rxQuotation.match(text, index)).hasMatch()) {
         setFormat(rxmatch.capturedStart(), rxmatch.capturedLength(), quotationFormat);
         index = rxmatch.capturedEnd();
     }
 
     //last rules
-    for(auto rule: lastHighlightingRules) {
+    for(const auto &rule: lastHighlightingRules) {
         index = 0;
         while((rxmatch = rule.pattern.match(text, index)).hasMatch()) {
             int group = rule.group;
-            qDebug() << "last rule matched: " << rule.pattern.pattern();
-            setFormat(rxmatch.capturedLength(group), rxmatch.capturedStart(group), rule.format);
+            setFormat(rxmatch.capturedStart(group), rxmatch.capturedLength(group), rule.format);
             index = rxmatch.capturedEnd();
         }
     }
 
-    setCurrentBlockState(0);
-
 	int startIndex = 0;
-    if(previousBlockState() != 1) {
+    if(!inCommentFromState(previousBlockState())) {
         rxmatch = commentStartExpression.match(text, 0);
         startIndex = rxmatch.hasMatch() ? rxmatch.capturedStart() : -1;
     }
@@ -839,7 +854,7 @@ void Highlighter::highlightCsoundBlock(const QString &line)
 		}
 		int commentLength;
 		if (endIndex == -1) {
-            setCurrentBlockState(1);
+            setCurrentBlockState(blockState(blockdata->section, true));
 			commentLength = text.length() - startIndex;
 		} else {
             commentLength = endIndex - startIndex + endMatch.capturedLength();
@@ -853,38 +868,20 @@ void Highlighter::highlightCsoundBlock(const QString &line)
 
 void Highlighter::highlightPythonBlock(const QString &text)
 {
-	QRegExp expression("\\b+\\w\\b+");
-	int index = text.indexOf(expression, 0);
-    for (int i = 0; i < pythonKeywords.size(); i++) {
-        QRegExp expression("\\b+" + pythonKeywords[i] + "\\b+");
-		int index = text.indexOf(expression);
-		while (index >= 0) {
-			int length = expression.matchedLength();
-			setFormat(index, length, keywordFormat);
-			index = text.indexOf(expression, index + length);
-		}
-	}
-	QRegExp strings( QRegExp("\"[^\"]*\""));
-	index = text.indexOf(strings);
-	while (index >= 0) {
-		int length = strings.matchedLength();
-		setFormat(index, length, quotationFormat);
-		index = text.indexOf(strings, index + length);
-	}
-	strings = QRegExp("'[^'']*'");
-	index = text.indexOf(strings);
-	while (index >= 0) {
-		int length = strings.matchedLength();
-		setFormat(index, length, quotationFormat);
-		index = text.indexOf(strings, index + length);
-	}
-	QRegExp expComment("#.*");
-	index = text.indexOf(expComment);
-	while (index >= 0) {
-		int length = expComment.matchedLength();
-		setFormat(index, length, singleLineCommentFormat);
-		index = text.indexOf(expComment, index + length);
-	}
+    formatMatches(text, rxPythonKeywords, keywordFormat);
+    formatMatches(text, rxQuotation, quotationFormat);
+    formatMatches(text, rxSingleQuotation, quotationFormat);
+    formatMatches(text, rxPythonComment, singleLineCommentFormat);
+}
+
+void Highlighter::formatMatches(const QString &text, const QRegularExpression &rx,
+                                const QTextCharFormat &format)
+{
+    QRegularExpressionMatchIterator it = rx.globalMatch(text);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        setFormat(match.capturedStart(), match.capturedLength(), format);
+    }
 }
 
 void Highlighter::highlightXmlBlock(const QString &/*text*/)
@@ -895,88 +892,41 @@ void Highlighter::highlightXmlBlock(const QString &/*text*/)
 
 void Highlighter::highlightHtmlBlock(const QString &text)
 {
-	QRegExp expression("\\b+\\w\\b+");
-	int index = text.indexOf(expression, 0);
-	for (int i = 0; i < htmlKeywords.size(); i++) {
-		QRegExp expression(htmlKeywords[i]);//expression("\\b+" + htmlKeywords[i] + "\\b+");
-		int index = text.indexOf(expression);
-		while (index >= 0) {
-			int length = expression.matchedLength();
-			setFormat(index, length, keywordFormat);
-			index = text.indexOf(expression, index + length);
-		}
-	}
-
-	for (int i=0; i<javascriptKeywords.size(); i++) {
-		QRegExp expression("\\b+" + javascriptKeywords[i] + "\\b+");
-		int index = text.indexOf(expression);
-		while (index >= 0) {
-			int length = expression.matchedLength();
-			setFormat(index, length, jsKeywordFormat); // TODO javascriptformat
-			index = text.indexOf(expression, index + length);
-		}
-	}
+    formatMatches(text, rxHtmlKeywords, keywordFormat);
+    formatMatches(text, rxJsKeywords, jsKeywordFormat); // TODO javascriptformat
+    formatMatches(text, rxHtmlEndTag, keywordFormat);
+    formatMatches(text, rxQuotation, quotationFormat);
+    formatMatches(text, rxSingleQuotation, quotationFormat);
 
-	QRegExp endTag( QRegExp(">$"));
-	index = text.indexOf(endTag);
-	while (index >= 0) {
-		int length = endTag.matchedLength();
-		setFormat(index, length, keywordFormat);
-		index = text.indexOf(endTag, index + length);
-	}
-
-	QRegExp strings( QRegExp("\"[^\"]*\""));
-	index = text.indexOf(strings);
-	while (index >= 0) {
-		int length = strings.matchedLength();
-		setFormat(index, length, quotationFormat);
-		index = text.indexOf(strings, index + length);
-	}
-	strings = QRegExp("'[^'']*'");
-	index = text.indexOf(strings);
-	while (index >= 0) {
-		int length = strings.matchedLength();
-		setFormat(index, length, quotationFormat);
-		index = text.indexOf(strings, index + length);
-	}
 	int commentIndex = -1;
-	QRegExp expComment("//.*"); // TODO: avaoid https://
-	index = text.indexOf(expComment);
+	// TODO: avaoid https://
+	QRegularExpressionMatch match = rxLineComment.match(text);
+	int index = match.hasMatch() ? match.capturedStart() : -1;
 	if (index>0 ) {
 		if (text.at(index-1)!=':') { // clumsy way to avoid addresses like https://
-			while (index >= 0) { // did not manage to do it with regular expression
-				int length = expComment.matchedLength();
-				setFormat(index, length, singleLineCommentFormat);
-				index = text.indexOf(expComment, index + length);
-			}
-			commentIndex = index; // better do other way
+			setFormat(index, text.length() - index, singleLineCommentFormat);
 		}
 	}
 
-//	if (commentIndex >= 0) {
-//		setFormat(commentIndex, text.size() - commentIndex, singleLineCommentFormat);
-////		return;
-//	}
 	if (commentIndex < 0) {
 		commentIndex = text.size() + 1;
 	}
 
     // multiline
     setCurrentBlockState(0);
-    QRegExp htmlCommentStartExpression = QRegExp("<!--");
-	QRegExp htmlCommentEndExpression = QRegExp("-->");
-
 
 	int startIndex = 0;
 	if (previousBlockState() != 1) {
-		startIndex = text.indexOf(htmlCommentStartExpression);
+		match = rxHtmlCommentStart.match(text);
+		startIndex = match.hasMatch() ? match.capturedStart() : -1;
 	}
 
 	while (startIndex >= 0 && startIndex < commentIndex) {
-		int endIndex = text.indexOf(htmlCommentEndExpression, startIndex);
+		QRegularExpressionMatch endMatch = rxHtmlCommentEnd.match(text, startIndex);
+		int endIndex = endMatch.hasMatch() ? endMatch.capturedStart() : -1;
 		if (format(startIndex) == quotationFormat) {
-			startIndex = text.indexOf(htmlCommentStartExpression,
-									  startIndex + 1);
+			match = rxHtmlCommentStart.match(text, startIndex + 1);
+			startIndex = match.hasMatch() ? match.capturedStart() : -1;
 			continue;
 		}
 		int commentLength;
@@ -984,12 +934,11 @@ void Highlighter::highlightHtmlBlock(const QString &text)
             setCurrentBlockState(1);
 			commentLength = text.length() - startIndex;
 		} else {
-			commentLength = endIndex - startIndex
-					+ htmlCommentEndExpression.matchedLength();
+			commentLength = endIndex - startIndex + endMatch.capturedLength();
 		}
 		setFormat(startIndex, commentLength, multiLineCommentFormat);
-		startIndex = text.indexOf(htmlCommentStartExpression,
-								  startIndex + commentLength);
+		match = rxHtmlCommentStart.match(text, startIndex + commentLength);
+		startIndex = match.hasMatch() ? match.capturedStart() : -1;
 	}
 }
 
@@ -1001,6 +950,7 @@ void Highlighter::highlightHtmlBlock(const QString &text)
 void Highlighter::setLastRules()
 {
 	HighlightingRule rule;
+	lastHighlightingRules.clear();
 
     // labels
     rule = {QRegularExpression("^\\s*([a-zA-Z]\\w*):\\s*$"), labelFormat, 1};
@@ -1025,26 +975,28 @@ bool Highlighter::isOpcode(QString name) {
     return m_opcodesSet.contains(name);
 }
 
-int Highlighter::findOpcode(QString opcodeName, int start, int end)
-{
-	//   fprintf(stderr, "%i - %i\n", start, end);
-	Q_ASSERT(m_opcodeList.size() > 0);
-	if (end == -1) {
-		end = m_opcodeList.size() -1;
-	}
-	int pos = ((end - start)/2) + start;
-	if (opcodeName == m_opcodeList[pos])
-		return pos;
-    else if(start == end)
-		return -1;
-    else if(opcodeName < m_opcodeList[pos])
-		return findOpcode(opcodeName, start, pos);
-    else if(opcodeName > m_opcodeList[pos])
-		return findOpcode(opcodeName, pos + 1, end);
-	return -1;
-}
-
 void Highlighter::setUDOs(QStringList udos)
 {
-       m_parsedUDOs = udos;
+    QSet<QString> udoSet(udos.begin(), udos.end());
+    if (udoSet == m_udoSet) {
+        return;
+    }
+    // Only the blocks naming an opcode that was added or removed need new formats
+    QSet<QString> changed = udoSet;
+    changed.unite(m_udoSet);
+    changed.subtract(QSet<QString>(udoSet).intersect(m_udoSet));
+    m_parsedUDOs = udos;
+    m_udoSet = udoSet;
+    if (document() == nullptr || m_mode == 1 || m_mode == 6) {
+        return;
+    }
+    for (QTextBlock block = document()->begin(); block.isValid(); block = block.next()) {
+        QString text = block.text();
+        for (auto name: changed) {
+            if (text.contains(name)) {
+                rehighlightBlock(block);
+                break;
+            }
+        }
+    }
 }
@@ -96,6 +96,18 @@ protected:
 		InTag
 	};
 
+	// Block state in Csound modes: bit 0 is set inside a /* */ comment and
+	// the CSD section the block belongs to is kept above it
+	static int blockState(CsdSection section, bool inComment) {
+		return (section << 1) | (inComment ? 1 : 0);
+	}
+	static CsdSection sectionFromState(int state) {
+		return state < 0 ? UnknownSection : CsdSection(state >> 1);
+	}
+	static bool inCommentFromState(int state) {
+		return state >= 0 && (state & 1);
+	}
+
 
 protected:
 	void highlightBlock(const QString &text);
@@ -104,7 +116,8 @@ protected:
 	void highlightXmlBlock(const QString &text);
 	void highlightHtmlBlock(const QString &text);
     void highlightScore(const QString &text, int start, int end);
-	int findOpcode(QString opcodeName, int start = 0, int end = -1);
+	void formatMatches(const QString &text, const QRegularExpression &rx,
+					   const QTextCharFormat &format);
     bool isOpcode(QString name);
 
 private:
@@ -121,6 +134,10 @@ private:
     QRegularExpression commentEndExpression;
     QRegularExpression rxScoreLetter;
     QRegularExpression rxQuotation;
+    QRegularExpression rxCsdTag, rxDefine, rxInstrDeclaration, rxOperator, rxWord, rxPfield;
+    QRegularExpression rxSingleQuotation, rxPythonKeywords, rxPythonComment;
+    QRegularExpression rxHtmlKeywords, rxJsKeywords, rxHtmlEndTag, rxLineComment;
+    QRegularExpression rxHtmlCommentStart, rxHtmlCommentEnd;
 
     QTextCharFormat csdtagFormat, instFormat, headerFormat;
 	QTextCharFormat irateFormat, krateFormat, arateFormat, girateFormat, gkrateFormat, garateFormat;
@@ -147,6 +164,7 @@ private:
     QStringList operatorPatterns;
 
     QSet<QString> deprecatedOpcodes;
+    QSet<QString> m_instWords, m_headerWords, m_keywordWords, m_ioWords, m_tagNames;
 
 
     QStringList pythonKeywords;  //Python
@@ -156,7 +174,6 @@ private:
 	//     void setFirstRules();
 	void setLastRules();
 
-	QStringList m_opcodeList;
     QSet<QString> m_opcodesSet;
 
     bool colorVariables;
@@ -172,6 +189,7 @@ private:
 	QTextCharFormat m_formats[LastConstruct + 1];
 
     QStringList m_parsedUDOs;
+    QSet<QString> m_udoSet;
 };
 
 #endif
@@ -22,8 +22,8 @@
 
 #include "inspector.h"
 #include "types.h"
-#include <chrono>
 #include <QtGui>
+#include <QtConcurrent>
 
 Inspector::Inspector(QWidget *parent)
 	: QDockWidget(parent)
@@ -40,85 +40,163 @@ Inspector::Inspector(QWidget *parent)
 			this, SLOT(itemChanged(QTreeWidgetItem*, QTreeWidgetItem*)));
 	//  connect(m_treeWidget, SIGNAL(itemDoubleClicked(QTreeWidgetItem*,int)),
 	//          this, SLOT(itemActivated(QTreeWidgetItem*,int)));
-	treeItem1 = new TreeItem(m_treeWidget, QStringList(tr("Opcodes")));
-	treeItem2 = new TreeItem(m_treeWidget, QStringList(tr("Macros")));
-	treeItem3 = new TreeItem(m_treeWidget, QStringList(tr("Instruments")));
-	treeItem4 = new TreeItem(m_treeWidget, QStringList(tr("F-tables")));
-	treeItem5 = new TreeItem(m_treeWidget, QStringList(tr("Score")));
-
-    m_treeWidget->expandItem(treeItem1);    // opcodes
-    m_treeWidget->collapseItem(treeItem2);  // macros
-    m_treeWidget->expandItem(treeItem3);    // instruments
-    m_treeWidget->collapseItem(treeItem4);  // ftables
-    m_treeWidget->collapseItem(treeItem5);    // score
-    rxOpcode.setPattern("\\bopcode\\s+(\\w+),\\s*\\w+\\s*,\\s*\\w+");
-    xinRx.setPattern("\\bxin\\b");
-    // xinRx.setPattern("[akiS]\\w+[,\\w\\d\\s_]+\\bxin\\s*$");
-    xoutRx.setPattern("\\bxout\\s+");
-    // ftableRx1.setPattern("^f\\s*\\d");
-    ftableRx2.setPattern("^\\w*\\s*ftgen");
+	connect(&m_watcher, SIGNAL(finished()), this, SLOT(parsingFinished()));
+	m_pending = false;
+	m_pendingPython = false;
     inspectLabels = false;
+	// Empty outline until the first document is parsed
+	InspectorOutline outline = buildOutline(QString());
+	updateChildren(m_treeWidget->invisibleRootItem(), m_outline.roots, outline.roots);
+	m_outline = outline;
 }
 
 
 Inspector::~Inspector()
 {
+	m_watcher.waitForFinished();
 	delete m_treeWidget;
 }
 
-
 void Inspector::parseText(const QString &text)
 {
-    udosMap.clear();
-    inspectorMutex.lock();
+	startParsing(text, false);
+}
 
-    auto t1 = std::chrono::high_resolution_clock::now();
+void Inspector::parsePythonText(const QString &text)
+{
+	startParsing(text, true);
+}
 
-    bool treeItem1Expanded = true;
-	bool treeItem2Expanded = true;
-	bool treeItem3Expanded = true;
-	bool treeItem4Expanded = true;
-	bool treeItem5Expanded = true;
-    bool insideOrc = false;
-	if  (treeItem1 != 0) {
-		treeItem1Expanded = treeItem1->isExpanded();
-		treeItem2Expanded = treeItem2->isExpanded();
-		treeItem3Expanded = treeItem3->isExpanded();
-		treeItem4Expanded = (treeItem4 != 0 ? treeItem4->isExpanded() : false);
-		treeItem5Expanded = (treeItem5 != 0 ? treeItem5->isExpanded() : false);
+void Inspector::startParsing(const QString &text, bool python)
+{
+	if (m_watcher.isRunning()) {
+		// Only the latest text matters, parse it when the current run is done
+		m_pending = true;
+		m_pendingText = text;
+		m_pendingPython = python;
+		return;
+	}
+	m_watcher.setFuture(QtConcurrent::run(python ? &Inspector::buildPythonOutline
+												 : &Inspector::buildOutline, text));
+}
+
+void Inspector::parsingFinished()
+{
+	InspectorOutline outline = m_watcher.result();
+	// Removing the current item must not make the editor jump to another line
+	m_treeWidget->blockSignals(true);
+	updateChildren(m_treeWidget->invisibleRootItem(), m_outline.roots, outline.roots);
+	m_treeWidget->blockSignals(false);
+	udosMap = outline.udos;
+	m_outline = outline;
+	if (m_pending) {
+		m_pending = false;
+		startParsing(m_pendingText, m_pendingPython);
+		m_pendingText.clear();
+	}
+}
+
+TreeItem *Inspector::createItem(QTreeWidgetItem *parent, int index, const InspectorNode &node)
+{
+	TreeItem *item = new TreeItem((QTreeWidgetItem *) nullptr, QStringList(node.text));
+	item->setLine(node.line);
+	parent->insertChild(index, item);
+	for (int i = 0; i < node.children.size(); i++) {
+		createItem(item, i, node.children[i]);
+	}
+	item->setExpanded(node.expanded);
+	return item;
+}
+
+void Inspector::updateChildren(QTreeWidgetItem *parent, const QVector<InspectorNode> &oldNodes,
+							   const QVector<InspectorNode> &newNodes)
+{
+	// Items are matched by text from both ends so that unchanged items keep
+	// their expanded state when something is added or removed in between.
+	// Only the items in the middle are retitled, created or deleted.
+	int oldCount = oldNodes.size();
+	int newCount = newNodes.size();
+	int prefix = 0;
+	while (prefix < oldCount && prefix < newCount
+		   && oldNodes[prefix].text == newNodes[prefix].text) {
+		prefix++;
+	}
+	int suffix = 0;
+	while (suffix < oldCount - prefix && suffix < newCount - prefix
+		   && oldNodes[oldCount - 1 - suffix].text == newNodes[newCount - 1 - suffix].text) {
+		suffix++;
 	}
-	QHash<QString, bool> instrumentExpanded;  // Remember if instrument is expanded in menu
-	for (int i = 0; i < treeItem3->childCount(); i++) {
-		QTreeWidgetItem * instr = treeItem3->child(i);
-		Q_ASSERT(instr->columnCount() > 0);
-		instrumentExpanded[instr->text(0)] = instr->isExpanded();
+	int oldMiddle = oldCount - prefix - suffix;
+	int newMiddle = newCount - prefix - suffix;
+	int common = qMin(oldMiddle, newMiddle);
+	for (int i = prefix; i < prefix + common; i++) {
+		parent->child(i)->setText(0, newNodes[i].text);
 	}
+	for (int i = common; i < oldMiddle; i++) {
+		delete parent->takeChild(prefix + common);
+	}
+	for (int i = common; i < newMiddle; i++) {
+		createItem(parent, prefix + i, newNodes[prefix + i]);
+	}
+	for (int i = 0; i < newCount; i++) {
+		int oldIndex;
+		if (i < prefix + common) {
+			oldIndex = i;
+		}
+		else if (i >= newCount - suffix) {
+			oldIndex = i - newCount + oldCount;
+		}
+		else {
+			continue; // Created above
+		}
+		const InspectorNode &node = newNodes[i];
+		if (oldNodes[oldIndex] == node) {
+			continue;
+		}
+		TreeItem *item = static_cast<TreeItem *>(parent->child(i));
+		item->setLine(node.line);
+		updateChildren(item, oldNodes[oldIndex].children, node.children);
+	}
+}
+
+InspectorOutline Inspector::buildOutline(const QString &text)
+{
+	// Runs in a worker thread, must not touch any widget
+	static const QRegularExpression rxOpcode("\\bopcode\\s+(\\w+),\\s*\\w+\\s*,\\s*\\w+");
+	static const QRegularExpression xinRx("\\bxin\\b");
+	// xinRx.setPattern("[akiS]\\w+[,\\w\\d\\s_]+\\bxin\\s*$");
+	static const QRegularExpression xoutRx("\\bxout\\s+");
+	// ftableRx1.setPattern("^f\\s*\\d");
+	static const QRegularExpression ftableRx2("^\\w*\\s*ftgen");
+	static const QRegularExpression orcStartRx("^\\s*<CsInstruments>");
+	static const QRegularExpression rxCsScore("^\\s*<CsScore>");
+
+	InspectorOutline outline;
+	QHash<QString, Opcode> &udosMap = outline.udos;
+	outline.roots << InspectorNode(tr("Opcodes"), -1, true)
+				  << InspectorNode(tr("Preprocessor"))
+				  << InspectorNode(tr("Instruments"), -1, true)
+				  << InspectorNode(tr("F-tables"))
+				  << InspectorNode(tr("Score"));
+	InspectorNode &opcodes = outline.roots[0];
+	InspectorNode &preprocessor = outline.roots[1];
+	InspectorNode &instruments = outline.roots[2];
+	InspectorNode &ftables = outline.roots[3];
+	InspectorNode &score = outline.roots[4];
 
-	m_treeWidget->clear();
-	treeItem1 = new TreeItem(m_treeWidget, QStringList(tr("Opcodes")));
-	treeItem1->setLine(-1);
-    treeItem2 = new TreeItem(m_treeWidget, QStringList(tr("Preprocessor")));
-	treeItem2->setLine(-1);
-	treeItem3 = new TreeItem(m_treeWidget, QStringList(tr("Instruments")));
-	treeItem3->setLine(-1);
-    treeItem4 = new TreeItem(m_treeWidget, QStringList(tr("F-tables")));
-	treeItem4->setLine(-1);
-	treeItem5 = new TreeItem(m_treeWidget, QStringList(tr("Score")));
-	treeItem5->setLine(-1);  // This might be overridden below
-    TreeItem *currentInstrument = nullptr;
-    TreeItem *currentItem = treeItem3;
+    bool insideOrc = false;
+    bool insideInstrument = false;
     Opcode *currentOpcode = nullptr;
     int commentIndex = 0;
     bool partOfComment = false;
     int i = 0;
     auto lines = text.splitRef('\n');
     QRegularExpressionMatch match;
-    static QRegularExpression orcStartRx("^\\s*<CsInstruments>");
 
     for(; i<lines.size(); i++) {
         if(orcStartRx.match(lines[i]).hasMatch()) {
             i++;
-            treeItem3->setLine(i);
+            instruments.line = i;
             insideOrc = true;
             break;
         }
@@ -145,169 +223,106 @@ void Inspector::parseText(const QString &text)
                     QDEBUG << "Malformed orchestra, tag" << line << "is invalid";
                 break;
             }
-            if(currentOpcode == nullptr && currentInstrument == nullptr) {
+            if(currentOpcode == nullptr && !insideInstrument) {
                 // we are at instr 0
                 if (line.startsWith("instr ")) {
                     auto instrline = line.mid(6).trimmed().toString();
-                    auto newItem = new TreeItem(treeItem3, QStringList(instrline));
-                    newItem->setLine(i + 1);
-                    currentInstrument = newItem;
-                    currentItem = newItem;
+                    instruments.children << InspectorNode(instrline, i + 1);
+                    insideInstrument = true;
                 }
                 else if(line.startsWith("opcode ") && (match=rxOpcode.match(line)).hasMatch()) {
                     auto opcodeName = match.captured(1);
-                    auto itemtext = line.mid(7).toString();
-                    QStringList columnslist(itemtext);
-                    if (treeItem1->childCount() == 0) { // set line for element to the first one found
-                        treeItem1->setLine(i + 1);
+                    if (opcodes.children.isEmpty()) { // set line for element to the first one found
+                        opcodes.line = i + 1;
                     }
-                    TreeItem *newItem = new TreeItem(treeItem1, columnslist);
-                    newItem->setLine(i + 1);
-                    currentItem = newItem;
+                    opcodes.children << InspectorNode(line.mid(7).toString(), i + 1);
                     udosMap.insert(opcodeName, Opcode(opcodeName));
                     currentOpcode = &udosMap[opcodeName];
                 }
                 else if (line[0] == '#') {
                     if (line.startsWith("#define")) {
-                        QString item = line.mid(8).toString();
-                        if (treeItem2->childCount() == 0) { // set line for element to the first one found
-                            treeItem2->setLine(i + 1);
+                        if (preprocessor.children.isEmpty()) { // set line for element to the first one found
+                            preprocessor.line = i + 1;
                         }
-                        TreeItem *newItem = new TreeItem(treeItem2, QStringList(item));
-                        newItem->setLine(i + 1);
+                        preprocessor.children << InspectorNode(line.mid(8).toString(), i + 1);
                     } else if (line.startsWith("#include")) {
                         // TODO: parse include file
-                        if (treeItem2->childCount() == 0) { // set line for element to the first one found
-                            treeItem2->setLine(i + 1);
+                        if (preprocessor.children.isEmpty()) { // set line for element to the first one found
+                            preprocessor.line = i + 1;
                         }
-                        TreeItem *newItem = new TreeItem(treeItem2, QStringList(line.toString()));
-                        newItem->setLine(i + 1);
-
+                        preprocessor.children << InspectorNode(line.toString(), i + 1);
                     }
                 }
                 else if(ftableRx2.match(line).hasMatch()) {
-                    QStringList columnslist(line.toString());
-                    if (treeItem4->childCount() == 0) { // set line for element to the first one found
-                        treeItem4->setLine(i + 1);
+                    if (ftables.children.isEmpty()) { // set line for element to the first one found
+                        ftables.line = i + 1;
                     }
-                    TreeItem *newItem = new TreeItem(treeItem4, columnslist);
-                    newItem->setLine(i + 1);
+                    ftables.children << InspectorNode(line.toString(), i + 1);
                 }
             }
             else if(currentOpcode != nullptr) {
+                InspectorNode &opcodeNode = opcodes.children.last();
                 if (line == "endop") {
-                    if(currentOpcode != nullptr) {
-                        currentOpcode = nullptr;
-                        currentItem = treeItem3;
-                    }
-                    else {
-                        qDebug() << "endop found outside opcode definition, line" << (i+1);
-                    }
+                    currentOpcode = nullptr;
                 }
                 else if(currentOpcode->inArgs.isEmpty() && (match=xinRx.match(line)).hasMatch()) {
                     currentOpcode->inArgs = line.mid(0, match.capturedStart()).toString().simplified();
-                    QStringList columnslist(currentOpcode->inArgs + " xin");
-                    TreeItem *newItem = new TreeItem(currentItem, columnslist);
-                    newItem->setLine(i + 1);
+                    opcodeNode.children << InspectorNode(currentOpcode->inArgs + " xin", i + 1);
                 }
                 else if(currentOpcode->outArgs.isEmpty() && (match=xoutRx.match(line)).hasMatch()) {
                     currentOpcode->outArgs = line.mid(match.capturedEnd()).toString().simplified();
-                    QStringList columnslist("xout " + currentOpcode->outArgs);
-                    TreeItem *newItem = new TreeItem(currentItem, columnslist);
-                    newItem->setLine(i + 1);
+                    opcodeNode.children << InspectorNode("xout " + currentOpcode->outArgs, i + 1);
                 }
             }
             else if (line == "endin") {
                 // everything between instruments is placed in the main instrument menu
-                currentInstrument = nullptr;
-                currentItem = treeItem3;
+                insideInstrument = false;
             }
         }
     }
 
-
-    static QRegularExpression rxCsScore("^\\s*<CsScore>");
     for(; i< lines.size(); i++) {
         if (rxCsScore.match(lines[i]).hasMatch()) {
-            treeItem5->setLine(i + 1);
-            currentItem = treeItem5;
+            score.line = i + 1;
             break;
         }
     }
-
-	treeItem1->setExpanded(treeItem1Expanded);
-	treeItem2->setExpanded(treeItem2Expanded);
-	treeItem3->setExpanded(treeItem3Expanded);
-	treeItem4->setExpanded(treeItem4Expanded);
-	treeItem5->setExpanded(treeItem5Expanded);
-
-    for (int i = 0; i < treeItem3->childCount(); i++) {
-		QTreeWidgetItem * instr = treeItem3->child(i);
-		if (instrumentExpanded.contains(instr->text(0))) {
-			instr->setExpanded(instrumentExpanded[instr->text(0)]);
-		}
-	}
-    std::chrono::duration<double, std::milli> ms_double = std::chrono::high_resolution_clock::now() - t1;
-    qDebug() << "Inspector::parseText: "<< ms_double.count() << "ms\n";
-    inspectorMutex.unlock();
-
+	return outline;
 }
 
-void Inspector::parsePythonText(const QString &text)
+InspectorOutline Inspector::buildPythonOutline(const QString &text)
 {
-	//  qDebug() << "Inspector:parseText";
-	inspectorMutex.lock();
-	m_treeWidget->clear();
-	treeItem1 = 0;
-	treeItem1 = new TreeItem(m_treeWidget, QStringList(tr("Imports")));
-	treeItem1->setLine(-1);
-	treeItem2 = new TreeItem(m_treeWidget, QStringList(tr("Classes")));
-	treeItem2->setLine(-1);
-	treeItem3 = new TreeItem(m_treeWidget, QStringList(tr("Functions")));
-	treeItem3->setLine(-1);
-	treeItem4 = 0;
-	treeItem5 = 0;
-	TreeItem *currentParent = 0;
+	// Runs in a worker thread, must not touch any widget
+	InspectorOutline outline;
+	outline.roots << InspectorNode(tr("Imports"), -1, true)
+				  << InspectorNode(tr("Classes"), -1, true)
+				  << InspectorNode(tr("Functions"), -1, true);
+	InspectorNode &imports = outline.roots[0];
+	InspectorNode &classes = outline.roots[1];
+	InspectorNode &functions = outline.roots[2];
 	QStringList lines = text.split(QRegExp("[\\n\\r]"));
+	QRegExp methodRx("[\\s]+def ");
+	QRegExp importRx("\\bimport\\b");
 	for (int i = 0; i< lines.size(); i++) {
 		if (lines[i].trimmed().startsWith("class ")) {
-			QStringList columnslist(lines[i].simplified());
-			TreeItem *newItem = new TreeItem(treeItem2, columnslist);
-			currentParent = newItem;
-			m_treeWidget->expandItem(newItem);
-            QFont itemFont = newItem->font(0);
-            itemFont.setBold(true);
-            newItem->setFont(1, itemFont);
-			newItem->setLine(i + 1);
+			classes.children << InspectorNode(lines[i].simplified(), i + 1, true);
 		}
-		else if (lines[i].contains(QRegExp("[\\s]+def "))) {
-			QStringList columnslist(lines[i].simplified());
-			if (currentParent != 0) {
-				TreeItem *newItem = new TreeItem(currentParent, columnslist);
-				newItem->setLine(i + 1);
+		else if (lines[i].contains(methodRx)) {
+			if (!classes.children.isEmpty()) {
+				classes.children.last().children << InspectorNode(lines[i].simplified(), i + 1);
 			}
 		}
-		else if (lines[i].trimmed().contains(QRegExp("\\bimport\\b"))) {
-			QStringList columnslist(lines[i].simplified());
-			TreeItem *newItem = new TreeItem(treeItem1, columnslist);
-			newItem->setLine(i + 1);
+		else if (lines[i].trimmed().contains(importRx)) {
+			imports.children << InspectorNode(lines[i].simplified(), i + 1);
 		}
 		else if (lines[i].trimmed().startsWith("def ")) {
-			QStringList columnslist(lines[i].simplified());
-			TreeItem *newItem = new TreeItem(treeItem3, columnslist);
-			newItem->setLine(i + 1);
+			functions.children << InspectorNode(lines[i].simplified(), i + 1);
 		}
 		else if (lines[i].contains("##")) {
-			QStringList columnslist(lines[i].simplified());
-			TreeItem *newItem = new TreeItem(treeItem3, columnslist);
-            // newItem->setForeground (0, QBrush(Qt::darkGreen) );
-			newItem->setLine(i + 1);
+			functions.children << InspectorNode(lines[i].simplified(), i + 1);
 		}
 	}
-	m_treeWidget->expandItem(treeItem1);
-	m_treeWidget->expandItem(treeItem2);
-	m_treeWidget->expandItem(treeItem3);
-	inspectorMutex.unlock();
+	return outline;
 }
 
 void Inspector::focusInEvent (QFocusEvent * event)
@@ -26,6 +26,7 @@
 #include <QDockWidget>
 #include <QTreeWidget>
 #include <QMutex>
+#include <QFutureWatcher>
 #include "types.h"
 
 class TreeItem : public QTreeWidgetItem
@@ -47,49 +48,73 @@ private:
 };
 
 
+// Outline of a document, built away from the GUI thread and then applied to
+// the tree by updating only the items that differ from the previous one.
+struct InspectorNode
+{
+	InspectorNode(QString t = QString(), int l = -1, bool e = false) : text(t), line(l), expanded(e) {}
+
+	QString text;
+	int line;
+	bool expanded; // Initial state when the item is created
+	QVector<InspectorNode> children;
+
+	bool operator==(const InspectorNode &other) const {
+		return text == other.text && line == other.line && children == other.children;
+	}
+	bool operator!=(const InspectorNode &other) const { return !(*this == other); }
+};
+
+struct InspectorOutline
+{
+	QVector<InspectorNode> roots;
+	QHash<QString, Opcode> udos;
+};
+
 class Inspector : public QDockWidget
 {
 	Q_OBJECT
 public:
 	Inspector(QWidget *parent);
 	~Inspector();
+	// Both parse in a worker thread and update the tree when done
 	void parseText(const QString &text);
 	void parsePythonText(const QString &text);
     QStringList getParsedUDOs() { return m_opcodes; }
     QVector<Opcode*> getUdosVector() { return udosVector; }
     QHash<QString, Opcode>*getUdosMap() { return &udosMap; }
 
+	static InspectorOutline buildOutline(const QString &text);
+	static InspectorOutline buildPythonOutline(const QString &text);
 
 protected:
 	virtual void focusInEvent (QFocusEvent * event);
 	virtual void closeEvent(QCloseEvent * event);
 
 private:
+	void startParsing(const QString &text, bool python);
+	void updateChildren(QTreeWidgetItem *parent, const QVector<InspectorNode> &oldNodes,
+						const QVector<InspectorNode> &newNodes);
+	TreeItem *createItem(QTreeWidgetItem *parent, int index, const InspectorNode &node);
+
 	QTreeWidget *m_treeWidget;
-	TreeItem *treeItem1;
-	TreeItem *treeItem2;
-	TreeItem *treeItem3;
-	TreeItem *treeItem4;
-	TreeItem *treeItem5;
 
-	QMutex inspectorMutex;
+	InspectorOutline m_outline; // What the tree currently shows
+	QFutureWatcher<InspectorOutline> m_watcher;
+	bool m_pending; // Text arrived while parsing
+	QString m_pendingText;
+	bool m_pendingPython;
+
     // QVector<QString> m_opcodes;
     QStringList m_opcodes;
-    QRegExp opcodeRegexp;
-    QRegularExpression rxOpcode;
     bool inspectLabels;
     QHash<QString, Opcode>udosMap;
     QVector<Opcode *>udosVector;
 
-    QRegularExpression xinRx;
-    QRegularExpression xoutRx;
-    QRegularExpression ftableRx1;
-    QRegularExpression ftableRx2;
-
-
 private slots:
 	void itemActivated(QTreeWidgetItem * item, int column = 0);
 	void itemChanged(QTreeWidgetItem * newItem, QTreeWidgetItem * oldItem);
+	void parsingFinished();
 
 signals:
 	void Close(bool visible);
@@ -25,52 +25,102 @@
 #include "algorithm"
 
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QXmlStreamReader>
+
+// Bump when the cache layout or the filtering in readOpcodesXml changes
+#define QCS_OPCODE_CACHE_MAGIC 0x51435343
+#define QCS_OPCODE_CACHE_VERSION 1
 
 void OpEntryParser::parseOpcodesXml(QString opcodeFile) {
-    QDomDocument m_doc("opcodes");
     QFile file(opcodeFile);
     if (!file.open(QIODevice::ReadOnly)) {
         qDebug() << "OpEntryParser::OpEntryParser could not find opcode file:" << opcodeFile;
         return;
     }
-    if (!m_doc.setContent(&file)) {
-        qDebug() << "OpEntryParser::OpEntryParser set content";
-        file.close();
-        return;
+    excludedOpcodes << "|" << "||" << "^" << "+" << "*" << "-" << "/";
+    // Files in the resources have no modification time, hash their contents
+    QByteArray key;
+    QFileInfo info(opcodeFile);
+    if (opcodeFile.startsWith(":") || !info.lastModified().isValid()) {
+        key = QCryptographicHash::hash(file.readAll(), QCryptographicHash::Md5);
+        file.reset();
+    }
+    else {
+        key = QString("%1:%2:%3").arg(info.absoluteFilePath()).arg(info.size())
+                .arg(info.lastModified().toMSecsSinceEpoch()).toUtf8();
+    }
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QString cachePath = cacheDir + "/opcodes-"
+            + QCryptographicHash::hash(opcodeFile.toUtf8(), QCryptographicHash::Md5).toHex()
+            + ".cache";
+
+    QList< QPair<QString, QList<Opcode> > > categories;
+    if (!readOpcodeCache(cachePath, key, categories)) {
+        categories.clear();
+        if (!readOpcodesXml(file, categories)) {
+            qDebug() << "OpEntryParser::OpEntryParser error parsing" << opcodeFile;
+            return;
+        }
+        QDir().mkpath(cacheDir);
+        writeOpcodeCache(cachePath, key, categories);
     }
     file.close();
-    excludedOpcodes << "|" << "||" << "^" << "+" << "*" << "-" << "/";
-    QDomElement docElem = m_doc.documentElement();
-    QList<Opcode> opcodesInCategoryList;
+    for (const auto &category : categories) {
+        for (const Opcode &op : category.second) {
+            addOpcode(op);
+        }
+        opcodeListCategory.append(category.second);
+        categoryList.append(category.first);
+        opcodeCategoryList.append(category);
+    }
+}
 
-    QDomElement cat = docElem.firstChildElement("category");
-    while(!cat.isNull()) {
-        QString catName = cat.attribute("name", "Miscellaneous");
-        opcodesInCategoryList.clear();
-        QDomElement opcode = cat.firstChildElement("opcode");
-        while(!opcode.isNull()) {
-            QDomElement desc = opcode.firstChildElement("desc");
-            QString description = desc.text();
-            QDomElement synop = opcode.firstChildElement("synopsis");
-            while(!synop.isNull()) {
+bool OpEntryParser::readOpcodesXml(QFile &file,
+                                   QList< QPair<QString, QList<Opcode> > > &categories)
+{
+    QXmlStreamReader xml(&file);
+    QString catName, description;
+    QList<Opcode> opcodesInCategoryList;
+    while (!xml.atEnd()) {
+        xml.readNext();
+        if (xml.isStartElement()) {
+            if (xml.name() == QLatin1String("category")) {
+                catName = xml.attributes().value("name").toString();
+                if (catName.isEmpty())
+                    catName = "Miscellaneous";
+                opcodesInCategoryList.clear();
+            }
+            else if (xml.name() == QLatin1String("desc")) {
+                description = xml.readElementText(QXmlStreamReader::IncludeChildElements);
+            }
+            else if (xml.name() == QLatin1String("synopsis")) {
+                // [outargs] <opcodename>name</opcodename> [inargs]
                 Opcode op;
                 op.desc = description;
+                op.isFlag = 0;
                 op.isInstalled = true;
-                QDomElement s = synop.toElement();
-                QDomNode node = s.firstChild();
-                QDomElement elem = node.toElement();
-                if (elem.tagName()=="opcodename") {
-                    op.opcodeName = elem.text().simplified();
-                    op.inArgs = node.nextSibling().toText().data().simplified();
-                }
-                else {
-                    op.outArgs = node.toText().data().simplified();
-                    node = node.nextSibling();
-                    op.opcodeName = node.toElement().text().simplified();
-                    node = node.nextSibling();
-                    if (!node.isNull())
-                        op.inArgs = node.toText().data().simplified();
+                QString before, after;
+                bool seenName = false;
+                while (!xml.atEnd()) {
+                    xml.readNext();
+                    if (xml.isEndElement() && xml.name() == QLatin1String("synopsis"))
+                        break;
+                    if (xml.isStartElement() && xml.name() == QLatin1String("opcodename")) {
+                        op.opcodeName = xml.readElementText(QXmlStreamReader::IncludeChildElements).simplified();
+                        seenName = true;
+                    }
+                    else if (xml.isCharacters()) {
+                        (seenName ? after : before) += xml.text();
+                    }
                 }
+                op.outArgs = before.simplified();
+                op.inArgs = after.simplified();
                 // check if several parenthesis ie description added to inArgs like "(MidiNoteNumber)  (init- or control-rate args only)"
                 // remove, if existing
                 if (op.inArgs.count("(")>1) {
@@ -83,26 +133,93 @@ void OpEntryParser::parseOpcodesXml(QString opcodeFile) {
                 }
                 if (op.opcodeName != "" && excludedOpcodes.count(op.opcodeName) == 0
                         && catName !="Utilities") {
-                    addOpcode(op);
                     opcodesInCategoryList << op;
+                }
+            }
+        }
+        else if (xml.isEndElement()) {
+            if (xml.name() == QLatin1String("category")) {
+                categories.append(QPair<QString, QList<Opcode> >(catName, opcodesInCategoryList));
+            }
+            else if (xml.name() == QLatin1String("opcode")) {
+                description.clear();
+            }
+        }
+    }
+    return !xml.hasError();
+}
 
+bool OpEntryParser::readOpcodeCache(QString cachePath, QByteArray key,
+                                    QList< QPair<QString, QList<Opcode> > > &categories)
+{
+    QFile cache(cachePath);
+    if (!cache.open(QIODevice::ReadOnly) || cache.size() == 0)
+        return false;
+    uchar *mapped = cache.map(0, cache.size());
+    bool valid = false;
+    {
+        // The stream reads straight from the mapping, keep it in this scope
+        QByteArray data = mapped ? QByteArray::fromRawData((const char *) mapped, cache.size())
+                                 : cache.readAll();
+        QDataStream in(data);
+        in.setVersion(QDataStream::Qt_5_6);
+        quint32 magic, version;
+        QByteArray cachedKey;
+        in >> magic >> version >> cachedKey;
+        valid = in.status() == QDataStream::Ok && magic == QCS_OPCODE_CACHE_MAGIC
+                && version == QCS_OPCODE_CACHE_VERSION && cachedKey == key;
+        if (valid) {
+            quint32 categoryCount;
+            in >> categoryCount;
+            for (quint32 i = 0; i < categoryCount && in.status() == QDataStream::Ok; i++) {
+                QString catName;
+                quint32 opcodeCount;
+                in >> catName >> opcodeCount;
+                QList<Opcode> opcodes;
+                for (quint32 j = 0; j < opcodeCount && in.status() == QDataStream::Ok; j++) {
+                    Opcode op;
+                    in >> op.opcodeName >> op.outArgs >> op.inArgs >> op.desc;
+                    op.isFlag = 0;
+                    op.isInstalled = true;
+                    opcodes << op;
                 }
-                synop = synop.nextSiblingElement("synopsis");
+                categories.append(QPair<QString, QList<Opcode> >(catName, opcodes));
             }
-            opcode = opcode.nextSiblingElement("opcode");
+            valid = in.status() == QDataStream::Ok;
+        }
+    }
+    if (mapped)
+        cache.unmap(mapped);
+    return valid;
+}
+
+void OpEntryParser::writeOpcodeCache(QString cachePath, QByteArray key,
+                                     const QList< QPair<QString, QList<Opcode> > > &categories)
+{
+    // Written to a temporary file and renamed, other instances may be reading it
+    QSaveFile cache(cachePath);
+    if (!cache.open(QIODevice::WriteOnly)) {
+        qDebug() << "OpEntryParser::writeOpcodeCache could not write" << cachePath;
+        return;
+    }
+    QDataStream out(&cache);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << quint32(QCS_OPCODE_CACHE_MAGIC) << quint32(QCS_OPCODE_CACHE_VERSION) << key;
+    out << quint32(categories.size());
+    for (const auto &category : categories) {
+        out << category.first << quint32(category.second.size());
+        for (const Opcode &op : category.second) {
+            out << op.opcodeName << op.outArgs << op.inArgs << op.desc;
         }
-        QPair<QString, QList<Opcode> > newCategory(catName, opcodesInCategoryList);
-        opcodeListCategory.append(opcodesInCategoryList);
-        categoryList.append(catName);
-        opcodeCategoryList.append(newCategory);
-        cat = cat.nextSiblingElement("category");
     }
+    cache.commit();
 }
 
 OpEntryParser::OpEntryParser(QString opcodeFile)
 	: m_opcodeFile(opcodeFile)
 {
     m_udosMap = nullptr;
+    m_nameIndexValid = false;
     parseOpcodesXml(opcodeFile);
 	addExtraOpcodes();
 }
@@ -125,6 +242,7 @@ void OpEntryParser::sortOpcodes()
 {
     std::sort(opcodeList.begin(), opcodeList.end(),
               [](const Opcode &a, const Opcode &b) -> bool { return a.opcodeName < b.opcodeName; });
+    m_nameIndexValid = false;
 }
 
 QStringList OpEntryParser::opcodeNameList(bool includeDisabled)
@@ -147,6 +265,26 @@ void OpEntryParser::addOpcode(Opcode opcode)
 {
     opcodeList.append(opcode);
     opcodeMap.insert(opcode.opcodeName, opcode);
+    m_nameIndexValid = false;
+}
+
+void OpEntryParser::updateNameIndex()
+{
+    if (m_nameIndexValid)
+        return;
+    m_nameIndex.clear();
+    m_nameVariants.clear();
+    for (int i = 0; i < opcodeList.size(); i++) {
+        int n = m_nameIndex.indexOf(opcodeList[i].opcodeName);
+        if (n >= 0) {
+            m_nameVariants[m_nameIndex.at(n).value].append(i);
+        }
+        else {
+            m_nameIndex.add(opcodeList[i].opcodeName, 0, m_nameVariants.size());
+            m_nameVariants.append(QVector<int>() << i);
+        }
+    }
+    m_nameIndexValid = true;
 }
 
 void OpEntryParser::addFlag(QString flag, QString desc) {
@@ -154,6 +292,7 @@ void OpEntryParser::addFlag(QString flag, QString desc) {
     opcode.desc = desc;
     opcode.isFlag = 1;
     opcodeList.append(opcode);
+    m_nameIndexValid = false;
 }
 
 
@@ -202,16 +341,16 @@ QVector<Opcode> OpEntryParser::getMatchingOpcodes(QString word, int maxsize)
 {
     // returns a vector of opcode definitions which start with <word>
     // if maxsize is not 0, only a maximum of <maxsize> entries are included
-    int numopcodes = 0;
+    updateNameIndex();
     QVector<Opcode> out;
-	for (int i = 0; i < opcodeList.size(); i++) {
-		if (opcodeList[i].opcodeName.startsWith(word)) {
-            if(maxsize > 0 && numopcodes >= maxsize)
+    auto matches = m_nameIndex.complete(word, 0, Qt::CaseSensitive);
+    for (const auto &match : matches) {
+        for (int index : m_nameVariants[match.value]) {
+            if (maxsize > 0 && out.size() >= maxsize)
                 break;
-            out << opcodeList[i];
-            numopcodes++;
-		}
-	}
+            out << opcodeList[index];
+        }
+    }
     auto it = m_udosMap->constBegin();
     while(it != m_udosMap->constEnd()) {
         if(it->opcodeName.startsWith(word)) {
@@ -251,11 +390,9 @@ QList<Opcode> OpEntryParser::getOpcodeList(int index)
 
 bool OpEntryParser::isOpcode(QString opcodeName)
 {
-    for (int i = 0; i < opcodeList.size();i++)  {
-		if (opcodeName == opcodeList[i].opcodeName) {
-            return true;
-        }
-	}
+    updateNameIndex();
+    if (m_nameIndex.contains(opcodeName))
+        return true;
     if(this->m_udosMap->contains(opcodeName))
         return true;
     return false;
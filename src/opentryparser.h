@@ -25,6 +25,7 @@
 
 #include <QString>
 #include <QStringList>
+#include <QFile>
 #include <QtXml>
 #include "node.h"
 #include "types.h" // For Opcode class
@@ -62,8 +63,19 @@ private:
 	QStringList categoryList;
 	QStringList excludedOpcodes;
     QStringList m_opcodeNameListCache;
+    // Opcode names for prefix lookups, the value of each entry points into
+    // m_nameVariants (all the opcodeList indexes with that name)
+    CompletionIndex m_nameIndex;
+    QVector<QVector<int> > m_nameVariants;
+    bool m_nameIndexValid;
 
 	void addOpcode(Opcode opcode);
+    bool readOpcodesXml(QFile &file, QList< QPair<QString, QList<Opcode> > > &categories);
+    bool readOpcodeCache(QString cachePath, QByteArray key,
+                         QList< QPair<QString, QList<Opcode> > > &categories);
+    void writeOpcodeCache(QString cachePath, QByteArray key,
+                          const QList< QPair<QString, QList<Opcode> > > &categories);
+    void updateNameIndex();
     void addFlag(QString flag, QString description);
 
     QHash<QString, Opcode>*m_udosMap;
@@ -50,6 +50,7 @@ Options::Options(ConfigLists *configlists) :
     highlightingTheme = "light";
     autoPlay = true;
     autoJoin = false;
+    externalScore = false;
 	midiCcToCurrentPageOnly = false;
     saveChanges = true;
     askIfTemporary = false;
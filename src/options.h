@@ -65,6 +65,7 @@ public:
     bool tabShortcutActive;
 
     bool highlightScore;
+    bool externalScore;  // Keep very large scores out of the editor
 
 	bool showWidgetsOnRun;
 	bool showTooltips;
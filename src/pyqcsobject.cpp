@@ -464,24 +464,33 @@ QuteSheet* PyQcsObject::getSheet(int index, QString sheetName)
 
 void PyQcsObject::schedule(QVariant time, QVariant event)
 {
-	qDebug() << "PyQcsObject::schedule" << event;
-	if (time.canConvert<double>())  { // a single event
-		QString eventLine = "i ";
-		if (event.canConvert<QVariantList>()) {
-			QVariantList fields = event.value<QVariantList>();
+	// time is the delay in seconds from now. Events are passed to the engine
+	// scheduler, which starts them on the right sample.
+	if (time.type() == QVariant::List) { // list of events
+		QVariantList times = time.toList();
+		QVariantList events = event.toList();
+		for (int i = 0; i < times.size() && i < events.size(); i++) {
+			schedule(times[i], events[i]);
+		}
+	}
+	else if (time.canConvert<double>())  { // a single event
+		QString eventLine;
+		if (event.type() == QVariant::List) {
+			QVariantList fields = event.toList();
+			eventLine = "i ";
 			for (int f = 0; f < fields.size(); f++) {
-				if (strcmp(fields[f].typeName(), "double") || strcmp(fields[f].typeName(),"int")) {
-					eventLine.append(fields[f].toString() + " ");
+				if (fields[f].type() == QVariant::String) {
+					eventLine.append("\"" + fields[f].toString() + "\" ");
 				}
 				else {
-					eventLine.append("\"" + fields[f].toString() + "\"");
+					eventLine.append(fields[f].toString() + " ");
 				}
 			}
 		}
-		qDebug() << "PyQcsObject::schedule: " << eventLine;
-	}
-	else if (time.canConvert<QVariantList>()) { // list of events
-
+		else {
+			eventLine = event.toString();
+		}
+		m_qcs->sendEvent(eventLine, time.toDouble());
 	}
 }
 
@@ -135,7 +135,7 @@ public slots:
 	QuteSheet* getSheet(int index, QString sheetName);
 
 	//Scheduler
-	void schedule(QVariant time, QVariant event);  // TODO implement receiving lists
+	void schedule(QVariant time, QVariant event); // time is a delay in seconds, or a list of them with a list of events
 	void sendEvent(int index, QString events);
 	void sendEvent(QString events);
 
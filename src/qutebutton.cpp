@@ -75,7 +75,7 @@ void QuteButton::setValue(double value)
 			static_cast<QPushButton *>(m_widget)->setChecked(m_currentValue != 0);
 		}
 	}
-	m_valueChanged = true;
+	markValueChanged();
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
 #endif
@@ -89,7 +89,7 @@ void QuteButton::setValue(QString text)
 #endif
 	if (m_channel.startsWith("_Browse") ||  m_channel.startsWith("_MBrowse") ) {
 		m_stringValue = text;
-		m_valueChanged = true;
+		markValueChanged();
 	}
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
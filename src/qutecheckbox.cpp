@@ -64,7 +64,7 @@ void QuteCheckBox::setValue(double value)
 		m_value = -value;
 		m_currentValue = -value;
 	}
-	m_valueChanged = true;
+	markValueChanged();
 	//  qDebug( ) << "QuteCheckBox::setValue " << value << "---" << m_currentValue;
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
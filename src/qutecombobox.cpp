@@ -278,7 +278,7 @@ void QuteComboBox::indexChanged(int value)
 	widgetLock.lockForRead();
 #endif
 	m_value = value;
-	m_valueChanged = true;
+	markValueChanged();
 	QPair<QString, double> channelValue(m_channel, m_value);
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
@@ -24,6 +24,7 @@
 #include "console.h"
 #include "dockhelp.h"
 #include "documentpage.h"
+#include "framescheduler.h"
 #include "highlighter.h"
 #include "inspector.h"
 #include "opentryparser.h"
@@ -42,6 +43,7 @@
 #include "livecodeeditor.h"
 #include "csoundhtmlview.h"
 #include "risset.h"
+#include "csdloader.h"
 #include <thread>
 
 
@@ -1122,6 +1124,19 @@ void CsoundQt::openExamplesFolder()
     QDesktopServices::openUrl(examplePath);
 }
 
+void CsoundQt::showFrameStats(double frameTime, int frameInterval)
+{
+    // Only when the frame scheduler had to stretch its interval
+    bool slowed = frameInterval > FrameScheduler::instance()->screenInterval();
+    if (slowed) {
+        frameStatsLabel->setText(tr("Widgets: every %1 ms (%2 ms per update)")
+                                 .arg(frameInterval).arg(frameTime, 0, 'f', 1));
+        frameStatsLabel->setToolTip(tr("The widget panels and consoles are updated less often "
+                                       "because updating them takes too long"));
+    }
+    frameStatsLabel->setVisible(slowed);
+}
+
 void CsoundQt::setLineAndColumn(int line, int column)
 {
     QString labelText = QString("%1 : %2, %3 : ").arg(tr("Line")).arg(line).arg(tr("Column"));
@@ -3279,6 +3294,7 @@ void CsoundQt::setCurrentOptionsForPage(DocumentPage *p)
     p->showLineNumbers(m_options->showLineNumberArea);
     p->setHighlightingTheme(m_options->highlightingTheme);
     p->enableScoreSyntaxHighlighting(m_options->highlightScore);
+    p->setExternalScoreLines(m_options->externalScore ? QCS_EXTERNAL_SCORE_LINES : 0);
 
     int flags = m_options->noBuffer ? QCS_NO_COPY_BUFFER : 0;
     flags |= m_options->noPython ? QCS_NO_PYTHON_CALLBACK : 0;
@@ -3435,7 +3451,8 @@ void CsoundQt::updateInspector()
         return; // Retrigger timer, but do no update
     }
     if (!documentPages[curPage]->getFileName().endsWith(".py")) {
-        m_inspector->parseText(documentPages[curPage]->getBasicText());
+        // Editor text only, an external score has no structure to show
+        m_inspector->parseText(documentPages[curPage]->getView()->getBasicText());
     }
     else {
         m_inspector->parsePythonText(documentPages[curPage]->getBasicText());
@@ -5158,6 +5175,12 @@ void CsoundQt::createStatusBar()
     lineAndColumnLabel = new QLabel();
     setLineAndColumn(0,0);
     statusbar->addPermanentWidget(lineAndColumnLabel);
+
+    frameStatsLabel = new QLabel();
+    frameStatsLabel->hide();
+    statusbar->addPermanentWidget(frameStatsLabel);
+    connect(FrameScheduler::instance(), SIGNAL(frameStats(double,int)),
+            this, SLOT(showFrameStats(double,int)));
 }
 
 void CsoundQt::readSettings()
@@ -5287,6 +5310,7 @@ void CsoundQt::readSettings()
     m_options->debugPort = settings.value("debugPort",34711).toInt();
     m_options->tabShortcutActive = settings.value("tabShortcutActive", true).toBool();
     m_options->highlightScore = settings.value("highlightScore", false).toBool();
+    m_options->externalScore = settings.value("externalScore", false).toBool();
 
 
     settings.endGroup();
@@ -5557,6 +5581,7 @@ void CsoundQt::writeSettings(QStringList openFiles, int lastIndex)
         settings.setValue("debugPort", m_options->debugPort);
         settings.setValue("tabShortcutActive", m_options->tabShortcutActive);
         settings.setValue("highlightScore", m_options->highlightScore);
+        settings.setValue("externalScore", m_options->externalScore);
 
         settings.setValue("lastfiles", openFiles);
         settings.setValue("lasttabindex", lastIndex);
@@ -5769,32 +5794,16 @@ int CsoundQt::loadFileFromSystem(QString fileName)
     return loadFile(fileName,m_options->autoPlay);
 }
 
-void changeNewLines(QByteArray &line) {
-    while(line.contains("\r\n")) {
-        line.replace("\r\n", "\n");
-    }
-    while (line.contains("\r")) {
-        line.replace("\r", "\n");
-    }
-}
-
 void fillCompanionSco(QString &fileName, QString &text) {
     auto companionFileName = fileName.replace(".orc", ".sco");
     if (!QFile::exists(companionFileName))
         return;
     text.prepend("<CsoundSynthesizer>\n<CsOptions>\n</CsOptions>\n<CsInstruments>\n");
     text.append("\n</CsInstruments>\n<CsScore>\n");
-    QFile companionFile(companionFileName);
-    if (!companionFile.open(QFile::ReadOnly))
+    QString scoText;
+    if (!CsdLoader::readFile(companionFileName, scoText))
         return;
-    while (!companionFile.atEnd()) {
-        QByteArray line = companionFile.readLine();
-        changeNewLines(line);
-        QTextDecoder decoder(QTextCodec::codecForLocale());
-        text = text + decoder.toUnicode(line);
-        if (!line.endsWith("\n"))
-            text.append("\n");
-    }
+    text.append(scoText);
     text.append("</CsScore>\n</CsoundSynthesizer>\n");
 }
 
@@ -5802,18 +5811,9 @@ void fillCompanionOrc(QString &fileName, QString &text) {
     auto companionFileName = fileName.replace(".sco", ".orc");
     if (!QFile::exists(companionFileName))
         return;
-    QFile companionFlle(companionFileName);
     QString orcText = "";
-    if (!companionFlle.open(QFile::ReadOnly))
+    if (!CsdLoader::readFile(companionFileName, orcText))
         return;
-    while (!companionFlle.atEnd()) {
-        QByteArray line = companionFlle.readLine();
-        changeNewLines(line);
-        QTextDecoder decoder(QTextCodec::codecForLocale());
-        orcText = orcText + decoder.toUnicode(line);
-        if (!line.endsWith("\n"))
-            orcText += "\n";
-    }
     text.prepend("\n</CsInstruments>\n<CsScore>\n");
     text.prepend(orcText);
     text.prepend("<CsoundSynthesizer>\n<CsOptions>\n</CsOptions>\n<CsInstruments>\n");
@@ -5834,41 +5834,17 @@ int CsoundQt::loadFile(QString fileName, bool runNow)
         return index;
     }
     // QDEBUG << "loading file" << fileName;
-    QFile file(fileName);
-    if (!file.open(QFile::ReadOnly)) {
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QString text;
+    QString errorString;
+    if (!CsdLoader::readFile(fileName, text, &errorString)) {
+        QApplication::restoreOverrideCursor();
         QMessageBox::warning(this, tr("CsoundQt"),
                              tr("Cannot read file %1:\n%2.")
                              .arg(fileName)
-                             .arg(file.errorString()));
+                             .arg(errorString));
         return -1;
     }
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-
-    QString text;
-    QStringList lines;
-    bool inEncFile = false;
-    while (!file.atEnd()) {
-        QByteArray line = file.readLine();
-        if (line.contains("<CsFileB ")) {
-            inEncFile = true;
-        }
-        if (!inEncFile) {
-            changeNewLines(line);
-            QTextDecoder decoder(QTextCodec::codecForLocale());
-            // text = text + decoder.toUnicode(line);
-            if (!line.endsWith("\n"))
-                text += "\n";
-            lines << text + decoder.toUnicode(line);
-        }
-        else {
-            // text += line;
-            lines << line;
-            if (line.contains("</CsFileB>" && !line.contains("<CsFileB " )) ) {
-                inEncFile = false;
-            }
-        }
-    }
-    text = lines.join("");
     if (m_options->autoJoin) {
         // QString companionFileName = fileName;
         if (fileName.endsWith(".orc"))
@@ -304,6 +304,7 @@ private slots:
     void tabMoved(int to, int from);
     void openExamplesFolder();
     void setLineAndColumn(int line, int column);
+    void showFrameStats(double frameTime, int frameInterval);
 
     DocumentPage *getCurrentDocumentPage() {
         if(curPage >= documentPages.size())
@@ -558,6 +559,7 @@ private:
         "--format"
     };
     QLabel *lineAndColumnLabel;
+    QLabel *frameStatsLabel; // Shown while widget updates are slowed down
 };
 
 class FileOpenEater : public QObject
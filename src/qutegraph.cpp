@@ -23,6 +23,8 @@
 #include "qutegraph.h"
 #include "curve.h"
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 #include <QPalette>
 
 
@@ -702,7 +704,7 @@ void QuteGraph::changeCurve(int index)
         int ftable = getTableNumForIndex(index);
         if (m_value2 != ftable) {
             m_value2 = ftable;
-            m_value2Changed = true;
+            markValue2Changed();
         }
         if(m_drawTableInfo) {
             auto curve = curves[index];
@@ -770,6 +772,9 @@ void QuteGraph::clearCurves()
     graphtypes.clear();
 	lines.clear();
 	polygons.clear();
+    m_envelopes.clear();
+    m_envelopeSnapshots.clear();
+    m_envelopePaths.clear();
 	m_gridlines.clear();
     m_gridTextsX.clear();
     m_gridTextsY.clear();
@@ -911,6 +916,19 @@ void QuteGraph::addCurve(Curve * curve)
     item->show();
     polygons.append(item);
     scene->addItem(item);
+    m_envelopes.append(TableEnvelope());
+    m_envelopeSnapshots.append(0);
+    QGraphicsPathItem *pathItem = nullptr;
+    if (graphType != GraphType::GRAPH_SPECTRUM) {
+        auto pen = graphType == GraphType::GRAPH_FTABLE ? QPen(QColor(255, 255, 50), 0)
+                                                        : QPen(QColor(255, 193, 7), 0);
+        pen.setCosmetic(true);
+        pathItem = scene->addPath(QPainterPath(), pen);
+        // Only the visible part is drawn, at the resolution of the view
+        connect(view->horizontalScrollBar(), SIGNAL(valueChanged(int)),
+                this, SLOT(viewScrolled()));
+    }
+    m_envelopePaths.append(pathItem);
     view->setResizeAnchor (QGraphicsView::NoAnchor);
     // view->setFocusPolicy(Qt::NoFocus);
 	m_pageComboBox->blockSignals(true);
@@ -1020,38 +1038,61 @@ void QuteGraph::applyInternalProperties()
 
 void QuteGraph::drawFtablePath(Curve *curve, int index) {
     Q_ASSERT(index >= 0);
-    QGraphicsScene *scene = this->getView(index)->scene();
-    // QGraphicsScene *scene = static_cast<QGraphicsView *>(static_cast<StackedLayoutWidget *>(m_widget)->widget(index))->scene();
-
-    double max = curve->get_max();
-    max = max == 0 ? 1: max;
-    int curveSize = curve->get_size();
+    Q_UNUSED(curve);
+    // Drawn by scaleGraph(), for the part of the table in view
+    updateEnvelope(index);
+}
 
-    int decimate = curveSize /1024;
-    if (decimate == 0) {
-        decimate = 1;
+void QuteGraph::updateEnvelope(int index) {
+    // Rebuilt only when the curve got new data
+    auto curve = curves[index];
+    TableEnvelope &envelope = m_envelopes[index];
+    if (envelope.size() != (int) curve->get_size()
+            || m_envelopeSnapshots[index] != curve->snapshotCount()) {
+        envelope.build(curve->data(), (int) curve->get_size());
+        m_envelopeSnapshots[index] = curve->snapshotCount();
     }
-    auto pen = QPen(QColor(255, 255, 50), 0);
-    // auto pen = QPen(QColor(255, 45, 7), 0);
-
-    auto rect = this->rect();
-    int width = rect.width();
-    int step = curveSize / width;
-    if(step == 0)
-        step = 1;
+}
 
-    QPainterPath path;
-    for (int i = 0; i < curveSize; i+=step) {
-        double value = curve->get_data(i);
-        path.lineTo(QPointF(i, -value));
-    }
-    scene->clear();
-    if(step > 1) {
-        pen.setWidth(0);
+void QuteGraph::drawEnvelope(int index) {
+    QGraphicsPathItem *item = m_envelopePaths.value(index, nullptr);
+    if (item == nullptr) {
+        return;
     }
-    scene->addPath(path, pen);
+    updateEnvelope(index);
+    const TableEnvelope &envelope = m_envelopes[index];
+    auto curve = curves[index];
+    auto view = getView(index);
+    QRectF visible = view->mapToScene(view->viewport()->rect()).boundingRect();
+    qint64 first = (qint64) floor(visible.left());
+    qint64 last = (qint64) ceil(visible.right()) + 1;
+    envelope.polyline(curve->data(), first, last, view->viewport()->width(), m_polygonBuffer);
+    // Tables are drawn upwards, signals relative to 0dbfs
+    double yscale = -1.0;
+    if (graphtypes[index] != GraphType::GRAPH_FTABLE) {
+        yscale = m_ud != nullptr ? 1.0 / m_ud->zerodBFS : 1.0;
+    }
+    QPointF *points = m_polygonBuffer.data();
+    for (int i = 0; i < m_polygonBuffer.size(); i++) {
+        points[i].ry() *= yscale;
+    }
+    // Release the item's copy first, so the path is rebuilt in place
+    item->setPath(QPainterPath());
+#if QT_VERSION >= QT_VERSION_CHECK(5,14,0)
+    m_pathBuffer.clear();
+#else
+    m_pathBuffer = QPainterPath();
+#endif
+    m_pathBuffer.addPolygon(m_polygonBuffer);
+    item->setPath(m_pathBuffer);
 }
 
+void QuteGraph::viewScrolled() {
+    int index = (int) m_value;
+    if (index >= 0 && index < curves.size()) {
+        drawEnvelope(index);
+    }
+}
 
 void QuteGraph::drawFtable(Curve * curve, int index)
 {
@@ -1149,6 +1190,88 @@ void QuteGraph::drawSpectrumPath(Curve *curve, int index) {
     scene->addPath(path, pen);
 }
 
+// log2 approximation for display purposes (error below 0.005, i.e. 0.03 dB).
+// x must be finite, the sign is ignored.
+static inline float fastLog2(float x)
+{
+    quint32 bits;
+    memcpy(&bits, &x, sizeof(bits));
+    float exponent = (float) (int) ((bits >> 23) & 255) - 128.0f;
+    bits = (bits & 0x007FFFFF) | 0x3F800000; // mantissa in [1, 2)
+    float mantissa;
+    memcpy(&mantissa, &bits, sizeof(mantissa));
+    return exponent + (-0.34484843f * mantissa + 2.02466578f) * mantissa - 0.67487759f;
+}
+
+// Converts amplitudes to dB relative to db0, amplitudes below 0.000001 are set to
+// -dbRange. The loop has no branches so the compiler can vectorize it.
+template <typename T>
+static void amplitudesToDb(const T *in, int size, double db0, double dbRange, float *out)
+{
+    const float scale = 6.0205999f; // 20 * log10(2)
+    const float offset = (float) (20.0 * log10(db0));
+    const float floorDb = (float) -dbRange;
+    for (int i = 0; i < size; i++) {
+        float amp = (float) in[i];
+        float db = scale * fastLog2(amp) - offset;
+        float keep = amp > 0.000001f;
+        out[i] = floorDb + keep * (db - floorDb);
+    }
+}
+
+// Spectrum outline as a polygon closed on the base line. With several bins
+// per pixel, each group of step bins is reduced to its maximum and minimum,
+// in the order they appear.
+static void spectrumPolygon(const float *db, int size, int step, double dbRange,
+                            QPolygonF &polygon)
+{
+    int columns = step > 1 ? (size + step - 1) / step : 0;
+    polygon.resize(step > 1 ? columns * 2 + 2 : size + 2);
+    QPointF *points = polygon.data();
+    int n = 0;
+    points[n++] = QPointF(0, dbRange);
+    if (step <= 1) {
+        for (int i = 0; i < size; i++) {
+            points[n++] = QPointF(i, -db[i]);
+        }
+    }
+    else {
+        for (int start = 0; start < size; start += step) {
+            int end = qMin(start + step, size);
+            int maxIndex = start, minIndex = start;
+            for (int i = start + 1; i < end; i++) {
+                if (db[i] > db[maxIndex])
+                    maxIndex = i;
+                if (db[i] < db[minIndex])
+                    minIndex = i;
+            }
+            int first = qMin(maxIndex, minIndex), second = qMax(maxIndex, minIndex);
+            points[n++] = QPointF(first, -db[first]);
+            points[n++] = QPointF(second, -db[second]);
+        }
+    }
+    points[n++] = QPointF(size - 1, dbRange);
+}
+
+// Index of the largest value in [first, last), or 0 if none is above 0.
+// The maximum is found first with a reduction that vectorizes.
+template <typename T>
+static size_t peakIndex(const T *data, size_t first, size_t last)
+{
+    T maxvalue = 0;
+    for (size_t i = first; i < last; i++) {
+        maxvalue = data[i] > maxvalue ? data[i] : maxvalue;
+    }
+    if (maxvalue <= 0) {
+        return 0;
+    }
+    for (size_t i = first; i < last; i++) {
+        if (data[i] == maxvalue)
+            return i;
+    }
+    return 0;
+}
+
 size_t QuteGraph::spectrumGetPeak(Curve *curve, double freq, double bandwidth) {
     qreal sr = this->getSr(44100.);
     qreal nyquist = sr * 0.5;
@@ -1161,27 +1284,15 @@ size_t QuteGraph::spectrumGetPeak(Curve *curve, double freq, double bandwidth) {
     index0 = index0 < curveSize - 1 ? index0 : curveSize - 1;
     size_t index1 = (size_t)(maxfreq / nyquist * curveSize);
     index1 = index1 < curveSize - 1 ? index1 : curveSize - 1;
-    qreal maxvalue = 0;
-    size_t maxindex = 0;
+    size_t maxindex;
     if(!m_frozen) {
-        for(int i=index0; i<index1; i++) {
-            auto data = curve->get_data(i);
-            if (data > maxvalue) {
-                maxvalue = data;
-                maxindex = i;
-            }
-        }
+        maxindex = peakIndex(curve->data(), index0, index1);
     }
     else {
-        for(int i=index0; i<index1; i++) {
-            auto data = frozenCurve[i];
-            if (data > maxvalue) {
-                maxvalue = data;
-                maxindex = i;
-            }
-        }
+        maxindex = peakIndex(frozenCurve.constData(), index0,
+                             qMin(index1, (size_t) frozenCurve.size()));
     }
-    if(maxindex > curveSize - 1 || maxindex < 0) {
+    if(maxindex > curveSize - 1) {
         qDebug() << "spectrum peak: wrong index " << maxindex;
         return 0;
     }
@@ -1269,30 +1380,27 @@ void QuteGraph::drawSpectrum(Curve *curve, int index) {
         freezeSpectrum(false);
     // auto view = getView(index);
     // QGraphicsScene *scene = static_cast<QGraphicsView *>(static_cast<StackedLayoutWidget *>(m_widget)->widget(index))->scene();
-    QVector<QPointF> polygonPoints;
-    polygonPoints.resize(curveSize + 2);
     double dbRange = m_dbRange;
-    polygonPoints[0] = QPointF(0, dbRange);
     double db0 = m_ud->zerodBFS;
 
+    // All bins are converted in one pass over the contiguous data
+    m_dbBuffer.resize(curveSize);
     if(!m_frozen) {
-        for (int i = 0; i < (int) curveSize; i++) {
-            auto data = curve->get_data(i);
-            double db = data > 0.000001 ? 20.0*log10(data/db0) : -dbRange;
-            // double value = 20.0*log10(fabs(curve->get_data(i))/db0);
-            polygonPoints[i+1] = QPointF(i, -db); //skip first item, which is base line
-        }
+        amplitudesToDb(curve->data(), curveSize, db0, dbRange, m_dbBuffer.data());
     } else {
-        for (int i = 0; i < frozenCurve.size(); i++) {
-            auto data = frozenCurve[i];
-            double db = data > 0.000001 ? 20.0*log10(data/db0) : -dbRange;
-            // double value = 20.0*log10(fabs(curve->get_data(i))/db0);
-            polygonPoints[i+1] = QPointF(i, -db); //skip first item, which is base line
-        }
+        int frozenSize = qMin(curveSize, frozenCurve.size());
+        amplitudesToDb(frozenCurve.constData(), frozenSize, db0, dbRange, m_dbBuffer.data());
+        std::fill(m_dbBuffer.begin() + frozenSize, m_dbBuffer.end(), (float) -dbRange);
     }
 
-    polygonPoints.back() = QPointF(curveSize - 1, dbRange);
-    polygons[index]->setPolygon(QPolygonF(polygonPoints));
+    // No need for more than two points per pixel
+    int viewWidth = getView(index)->viewport()->width();
+    double zoomx = property("QCS_zoomx").toDouble();
+    int step = viewWidth > 0 && zoomx > 0 ? (int) (curveSize / (zoomx * viewWidth)) : 1;
+    // Release the item's copy first, so the buffer is refilled in place
+    polygons[index]->setPolygon(QPolygonF());
+    spectrumPolygon(m_dbBuffer.constData(), curveSize, step, dbRange, m_polygonBuffer);
+    polygons[index]->setPolygon(m_polygonBuffer);
 
     // m_pageComboBox->setItemText(index, curve->get_caption());
     // draw Grid
@@ -1421,21 +1529,13 @@ void QuteGraph::drawSpectrum(Curve *curve, int index) {
 
 void QuteGraph::drawSignalPath(Curve *curve, int index) {
     int curveSize = curve->get_size();
-    QPainterPath path;
-    auto zerodbfs = m_ud->zerodBFS;
-    for(int i=0; i<curveSize; i++) {
-        auto value = curve->get_data(i)/zerodbfs;
-        path.lineTo(i, value);
+    if (lines[index].isEmpty()) { // Base line
+        lines[index].append(getView(index)->scene()->addLine(0, 0, curveSize, 0,
+                                                             QPen(QColor(40, 40, 40), 0)));
     }
-    QPainterPath grid;
-    grid.moveTo(0, 0);
-    grid.lineTo(curveSize, 0);
-
-    QGraphicsScene *scene = static_cast<QGraphicsView *>(static_cast<StackedLayoutWidget *>(m_widget)->widget(index))->scene();
-    auto pen = QPen(QColor(255, 193, 7), 0);
-    scene->clear();
-    scene->addPath(grid, QPen(QColor(40, 40, 40), 0));
-    scene->addPath(path, pen);
+    lines[index][0]->setLine(0, 0, curveSize, 0);
+    // Drawn by scaleGraph(), for the part of the signal in view
+    updateEnvelope(index);
 }
 
 void QuteGraph::drawSignal(Curve *curve, int index)
@@ -1486,7 +1586,7 @@ void QuteGraph::scaleGraph(int index)
         // view->fitInView(0, -10./zoomy, (double) size/zoomx, 10./zoomy);
         view->fitInView(0, -2./zoomy, sizef/zoomx, 2./zoomy);
 	}
-
+    drawEnvelope(index);
 }
 
 int QuteGraph::getTableNumForIndex(int index) {
@@ -1525,7 +1625,7 @@ int QuteGraph::getIndexForTableNum(int ftable)
 void QuteGraph::setInternalValue(double value)
 {
 	m_value = value;
-	m_valueChanged = true;
+	markValueChanged();
 }
 
 void QuteGraph::showScrollbars(bool show) {
@@ -1551,11 +1651,8 @@ void QuteTableWidget::reset() {
         m_maxy = 1.0;
         m_miny = -1.0;
     }
-#if QT_VERSION >= QT_VERSION_CHECK(5,14,0)
-    m_path.clear();
-#else
-    m_path = QPainterPath(); // not sure if it works
-#endif
+    m_envelope.clear();
+    m_polygon.clear();
 }
 
 
@@ -1645,11 +1742,17 @@ void QuteTableWidget::paintEvent(QPaintEvent *event) {
         this->paintGrid(&painter);
     }
     painter.setPen(QPen(m_color, 0));
-    painter.drawPath(m_path);
+    painter.drawPolyline(m_polygon);
     mutex.unlock();
     blockSignals(false);
 }
 
+void QuteTableWidget::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    QMutexLocker locker(&mutex);
+    updatePolygon();
+}
+
 void QuteTableWidget::setRange(double maxy) {
     if(maxy == 0.0) {
         m_autorange = true;
@@ -1660,70 +1763,83 @@ void QuteTableWidget::setRange(double maxy) {
     }
 }
 
-void QuteTableWidget::updatePath() {
+bool QuteTableWidget::updatePath(QRect *dirty) {
+    // Returns true if the table changed since the last call, with the part
+    // of the widget to repaint in dirty
     if(!m_running || m_tabnum <= 0) {
-        return;
+        return false;
     }
 
     MYFLT *data;
     int tabsize = csoundGetTable(m_ud->csound, &data, m_tabnum);
     if(tabsize == 0 || data == nullptr) {
         QDEBUG << "Table not found" << m_tabnum;
-        return;
+        return false;
     }
 
-    m_tabsize = tabsize;
-    int margin = m_margin;
+    qint64 first = 0, last = tabsize;
+    if(data != m_data || tabsize != m_tabsize) {
+        // Another table, or the table was replaced (ftgen)
+        m_data = data;
+        m_tabsize = tabsize;
+        m_envelope.build(data, tabsize);
+    }
+    else if(!m_envelope.update(data, tabsize, first, last)) {
+        return false;
+    }
 
+    double maxy = m_maxy, miny = m_miny;
+    if(m_autorange) {
+        // The envelope has the real extremes, not just the sampled points
+        double newmaxy = qMax(m_maxy, (double)m_envelope.max());
+        double newminy = qMin(m_miny, (double)m_envelope.min());
+        m_maxy = ceil(newmaxy);
+        m_miny = floor(newminy);
+    }
+    updatePolygon();
+    if(dirty != nullptr) {
+        *dirty = this->rect();
+        if(m_maxy == maxy && m_miny == miny) {
+            // Only the columns of the changed samples, and the lines joining them
+            int width = dirty->width() - m_margin*2;
+            double xscale = width / (double)tabsize;
+            int x0 = dirty->x() + m_margin + (int)floor((first - 1) * xscale) - 1;
+            int x1 = dirty->x() + m_margin + (int)ceil((last + 1) * xscale) + 1;
+            dirty->setLeft(qMax(x0, dirty->left()));
+            dirty->setRight(qMin(x1, dirty->right()));
+        }
+    }
+    return true;
+}
+
+void QuteTableWidget::updatePolygon() {
+    // This needs to be called with the lock
+    if(m_data == nullptr || m_envelope.size() != m_tabsize) {
+        m_polygon.clear();
+        return;
+    }
+    int margin = m_margin;
     auto rect = this->rect();
     auto width = rect.width() - margin*2;
     auto height = rect.height() - margin*2;
+    if(width <= 0 || height <= 0) {
+        m_polygon.clear();
+        return;
+    }
 
+    // At most two points per pixel column (its min and max)
+    m_envelope.polyline(m_data, 0, m_tabsize, width, m_polygon);
 
-    double xscale = width / (double)tabsize;
-    double y0 = rect.y() + margin;
+    double xscale = width / (double)m_tabsize;
+    double yscale = -height / (m_maxy - m_miny);
     double x0 = rect.x() + margin;
-
-    int step = tabsize / width;
-    if(step == 0)
-        step = 1;
-
-    double maxy = m_maxy;
+    double y0 = rect.y() + margin + height;
     double miny = m_miny;
-
-    if(m_autorange) {
-        double newmaxy = m_maxy;
-        double newminy = m_miny;
-        for(int i=0; i < tabsize; i += step) {
-            double y = data[i];
-            if(y > newmaxy)
-                newmaxy = y;
-            else if (y < newminy)
-                newminy = y;
-        }
-        maxy = m_maxy = ceil(newmaxy);
-        miny = m_miny = floor(newminy);
-    }
-
-#if QT_VERSION >= QT_VERSION_CHECK(5,14,0)
-    m_path.clear();
-#else
-    m_path = QPainterPath(); // not sure if it works
-#endif
-    QPolygonF poly;
-    double yscale = -height / (maxy-miny);
-
-    double ydata = data[0];
-    poly.append(QPoint(x0, (ydata-miny)*yscale+y0+height));
-
-    for(int i=1; i < tabsize; i+=step) {
-        ydata = data[i];
-        double x2 = i*xscale + x0;
-        double y2 = (ydata - miny) * yscale + (y0+height);
-        // path->lineTo(x2, y2);
-        poly.append(QPointF(x2, y2));
+    QPointF *points = m_polygon.data();
+    for(int i=0; i < m_polygon.size(); i++) {
+        points[i].setX(points[i].x() * xscale + x0);
+        points[i].setY((points[i].y() - miny) * yscale + y0);
     }
-    m_path.addPolygon(poly);
 }
 
 void QuteTableWidget::updateData(int tabnum) {
@@ -1737,9 +1853,16 @@ void QuteTableWidget::updateData(int tabnum) {
             m_miny = 0;
         }
         m_tabnum = tabnum;
+        m_data = nullptr;
+        this->updatePath();
+        this->update();
+    }
+    else {
+        QRect dirty;
+        if(this->updatePath(&dirty)) {
+            this->update(dirty);
+        }
     }
-    this->updatePath();
-    this->update();
 }
 
 
@@ -1871,7 +1994,7 @@ void QuteTable::onStop() {
     mutex.lock();
     m_tabnum = 0;
     m_value = 0;
-    m_valueChanged = true;
+    markValueChanged();
 
     static_cast<QuteTableWidget*>(m_widget)->stop(m_csoundUserData);
     mutex.unlock();
@@ -1907,7 +2030,7 @@ void QuteTable::setWidgetGeometry(int x, int y, int width, int height) {
 void QuteTable::setTableNumber(int tabnum) {
     if(tabnum == m_tabnum)
         return;
-    m_valueChanged = true;
+    markValueChanged();
     m_value = tabnum;
     m_tabnum = tabnum;
     auto w = static_cast<QuteTableWidget*>(m_widget);
@@ -1925,7 +2048,7 @@ void QuteTable::setValue(double value) {
             return;
         }
         // update data, don't change table number
-        m_valueChanged = true;
+        markValueChanged();
         // auto w = static_cast<QuteTableWidget*>(m_widget);
         // w->updateData(m_tabnum);
         return;
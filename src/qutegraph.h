@@ -27,6 +27,7 @@
 #include "csoundengine.h"  //necessary for the CsoundUserData struct
 #include "selectcolorbutton.h"
 #include "curve.h"         // necessary for CurveType
+#include "tableenvelope.h"
 
 class Curve;
 
@@ -90,6 +91,12 @@ protected:
 	QVector<Curve *> curves;
 	QVector<QVector <QGraphicsLineItem *> > lines;
 	QVector<QGraphicsPolygonItem *> polygons;
+    // Min/max summaries of the f-table and signal curves, and the items
+    // they are drawn to (nullptr for spectra)
+    QVector<TableEnvelope> m_envelopes;
+    QVector<unsigned int> m_envelopeSnapshots; // snapshotCount() of the curve when built
+    QVector<QGraphicsPathItem *> m_envelopePaths;
+    QPainterPath m_pathBuffer;
     QVector<QPainterPath *>painterPaths;
     QVector<GraphType>graphtypes;
 
@@ -116,6 +123,7 @@ public slots:
 	void changeCurve(int index);
 	void indexChanged(int index);
     void mouseReleased();
+    void viewScrolled();
 
 private:
 	void drawFtable(Curve * curve, int index);
@@ -128,6 +136,8 @@ private:
     void drawSignalPath(Curve * curve, int index);
 
 	void scaleGraph(int index);
+    void updateEnvelope(int index);
+    void drawEnvelope(int index);
 	int getTableNumForIndex(int index);
     int getIndexForTableNum(int GRAPH_FTABLE);
 	void setInternalValue(double value);
@@ -136,6 +146,8 @@ private:
     void freezeSpectrum(bool status);
 
     QVector<double> frozenCurve;
+    QVector<float> m_dbBuffer; // Reused by drawSpectrum()
+    QPolygonF m_polygonBuffer;
 
     QGraphicsView* getView(int index);
 
@@ -233,7 +245,8 @@ public:
     void updateData(int tabnum);
     void setRunningStatus(int csoundRunning) { m_running = csoundRunning; }
     int currentTableNumber() { return m_tabnum; }
-    void updatePath();
+    bool updatePath(QRect *dirty = nullptr);
+    void updatePolygon();
     void setColor(QColor color) { m_color = color; }
     void setRange(double maxy=1.0);
     void showGrid(bool show) { m_showGrid = show; }
@@ -248,6 +261,7 @@ public:
 
 protected:
     virtual void paintEvent(QPaintEvent *event) override;
+    virtual void resizeEvent(QResizeEvent *event) override;
 
 private:
     int m_tabnum;
@@ -260,8 +274,8 @@ private:
     double m_maxy;
     double m_miny;
     bool m_autorange;
-    QPainterPath m_path;
-    // QPainterPath *m_path;
+    TableEnvelope m_envelope;
+    QPolygonF m_polygon; // in widget coordinates
     QMutex mutex;
     bool m_showGrid;
     QFont gridFont;
@@ -210,7 +210,7 @@ void QuteKnob::setRange(double min, double max)
 		m_value = min;
     setProperty("QCS_maximum", max);
 	setProperty("QCS_minimum", min);
-	m_valueChanged = true;
+	markValueChanged();
     static_cast<QVdial *>(m_widget)->setDisplayRange(min, max);
 
 }
@@ -587,7 +587,7 @@ void QuteKnob::knobChanged(int value)
             / (double) (knob->maximum() - knob->minimum());
 	m_value =  min + (normalized * (max-min));
     // setInternalValue(scaledValue);
-    m_valueChanged = true;
+    markValueChanged();
 	QPair<QString, double> channelValue(m_channel, m_value);
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
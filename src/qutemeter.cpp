@@ -583,7 +583,7 @@ void QuteMeter::valueChanged(double value1)
     widgetLock.lockForRead();
 #endif
     m_value = value1;
-    m_valueChanged = true;
+    markValueChanged();
 #ifdef  USE_WIDGET_MUTEX
     widgetLock.unlock();
 #endif
@@ -600,7 +600,7 @@ void QuteMeter::value2Changed(double value2)
     widgetLock.lockForRead();
 #endif
     m_value2 = value2;
-    m_value2Changed = true;
+    markValue2Changed();
 #ifdef  USE_WIDGET_MUTEX
     widgetLock.unlock();
 #endif
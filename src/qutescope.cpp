@@ -358,9 +358,7 @@ void ScopeData::updateData(int channel, double zoomx, double zoomy, bool freeze)
 		return;
 	if (freeze)
 		return;
-	double value;
 	int numChnls = ud->numChnls;
-	MYFLT newValue;
     if (channel == 0 || channel > numChnls ) {
         return;
 	}
@@ -370,103 +368,57 @@ void ScopeData::updateData(int channel, double zoomx, double zoomy, bool freeze)
     QReadWriteLock *mutex = m_params->mutex;
 	mutex->lockForWrite();
 #endif
-    // FIXME how to make sure the buffer is read before it is flushed when recorded?
-    // Have another buffer?
-	RingBuffer *buffer = &ud->audioOutputBuffer;
-	buffer->lock();
-	QList<MYFLT> list = buffer->buffer;
-	buffer->unlock();
-	long listSize = list.size();
-    long offset = buffer->currentPos;
-    long dataToRead = width;
-    // search for trig
-    long trigOffset = 0;
-    double lastValue = 1.0;
-    long maxFrames = width < dataToRead ? width: dataToRead;
-
+    // Decimate directly from the ring buffer memory. The newest frames are
+    // shown, each pixel column holds the peak of the frames it covers.
+    RingBufferSnapshot snap = ud->audioOutputBuffer.snapshot();
+    long totalFrames = snap.size() / numChnls;
+    double framesPerPixel = zoomx > 0 ? zoomx : 1.0;
+    long maxFrames = qMin((long) width, (long) (totalFrames / framesPerPixel));
+    long span = (long) ceil(maxFrames * framesPerPixel);
+    long startFrame = totalFrames - span;
+    int firstChan = channel >= 0 ? channel : 0;
+    int lastChan = channel >= 0 ? channel : numChnls - 1;
     if(m_params->triggerMode == TriggerMode::TriggerUp) {
-        if(channel >= 0) {
-            for(int i=0; i < maxFrames; i++) {
-                int idx = (int)((offset + (int)(i*numChnls*zoomx) + channel) % listSize);
-                double value = list[idx];
-                if(value >= 0 && lastValue < 0) {
-                    trigOffset = idx - offset - channel;
-                    break;
-                }
-                lastValue = value;
+        // search for a rising zero crossing in the frames preceding the
+        // displayed window, so the whole window is still available
+        long searchStart = qMax(0L, startFrame - span);
+        double lastValue = 1.0;
+        for (long frame = searchStart; frame < startFrame; frame++) {
+            long base = frame * numChnls;
+            double value = 0;
+            for (int chan = firstChan; chan <= lastChan; chan++) {
+                double newValue = snap.at(base + chan);
+                if (fabs(newValue) > fabs(value))
+                    value = newValue;
             }
-        }
-        else {
-            for(int i=0; i < maxFrames; i++) {
-                int baseidx = (int)((offset + (int)(i*numChnls*zoomx)) % listSize);
-                double value = 0;
-                for(int chan = 0; chan < numChnls; chan++) {
-                    double newValue = list[baseidx+chan];
-                    if(fabs(newValue) > fabs(value))
-                        value = newValue;
-                }
-                if(value >= 0 && lastValue < 0) {
-                    trigOffset = baseidx - offset;
-                    break;
-                }
-                lastValue = value;
+            if (value >= 0 && lastValue < 0) {
+                startFrame = frame;
+                break;
             }
-
+            lastValue = value;
         }
-        offset += trigOffset;
     }
-    double factor = numChnls * zoomx;
-    int halfheight = height/2;
-    if(channel >= 0) {
-        for(int i = 0; i < maxFrames; i++) {
-            int idx = (int)((offset+channel+ (int)(i*factor)) % listSize);
-            value = (double) list[idx];
-            curveData[i+1] = QPoint(i, -zoomy*value*halfheight);
-        }
-    } else {
-        for(int i = 0; i < maxFrames; i++) {
-            value = 0;
-            for(int chan = 0; chan < numChnls; chan++) {
-                int idx = (int)((offset+chan+ (int)(i*factor)) % listSize);
-                newValue = (double) list[idx];
-                if(fabs(newValue) > fabs(value))
+    double halfheight = height/2;
+    for (long i = 0; i < maxFrames; i++) {
+        long frame = startFrame + (long) (i*framesPerPixel);
+        long endFrame = qMax(frame + 1, startFrame + (long) ((i + 1)*framesPerPixel));
+        double value = 0;
+        for (; frame < endFrame; frame++) {
+            long base = frame * numChnls;
+            for (int chan = firstChan; chan <= lastChan; chan++) {
+                double newValue = snap.at(base + chan);
+                if (fabs(newValue) > fabs(value))
                     value = newValue;
             }
-            curveData[i+1] = QPoint(i, -zoomy*value*halfheight);
         }
-
+        curveData[i+1] = QPointF(i, -zoomy*value*halfheight);
+    }
+    for (long i = maxFrames; i < width; i++) {
+        curveData[i+1] = QPointF(i, 0);
     }
-
-
-    /*
-    for (int i = 0; i < width; i++) {
-		value = 0;
-        for (int j = 0; j < (int) zoomx; j++) {
-			if (channel == -1) {
-                // all channels
-				newValue = 0;
-				for (int k = 0; k < numChnls; k++) {
-                    int bufIdx = (int)((((i*zoomx)+j)*numChnls) + offset + k) % listSize;
-                    newValue += list[bufIdx];
-				}
-				newValue /= numChnls;
-				if (fabs(newValue) > fabs(value))
-					value = -(double) newValue;
-			}
-			else {
-                int bufIdx = (int)((((i*zoomx)+j)*numChnls) + offset + channel) % listSize;
-                if (fabs(list[bufIdx]) > fabs(value))
-                    value = (double) -list[bufIdx];
-			}
-		}
-        curveData[i+1] = QPoint(i, zoomy*value*height/2);
-	}
-    */
-    // buffer->currentReadPos += width;
-    buffer->currentReadPos = (offset + dataToRead) % buffer->size;
 	m_params->widget->setSceneRect(0, -height/2, width, height );
-	curveData.last() = QPoint(width-4, 0);
-	curveData.first() = QPoint(0, 0);
+	curveData.last() = QPointF(width-4, 0);
+	curveData.first() = QPointF(0, 0);
 	curve->setPolygon(curveData);
 #ifdef  USE_WIDGET_MUTEX
 	mutex->unlock();
@@ -524,18 +476,17 @@ void LissajouData::updateData(int channel, double zoomx, double zoomy, bool free
 	QReadWriteLock *mutex = m_params->mutex;
 	mutex->lockForWrite();
 #endif
-	RingBuffer *buffer = &ud->audioOutputBuffer;
-	buffer->lock();
-	QList<MYFLT> list = buffer->buffer;
-	buffer->unlock();
-	long listSize = list.size();
-	long offset = buffer->currentPos;
-	for (int i = 0; i < curveData.size(); i++) {
-		int bufferIndex = (int)((i*numChnls) + offset + channel) % listSize;
-		x = (double)list[bufferIndex];
-        bufferIndex = (bufferIndex + 1) % listSize;
-        y = (double) -list[bufferIndex];
-		curveData[i] = QPoint(x*width*zoomx/4, y*height*zoomy/4);
+	RingBufferSnapshot snap = ud->audioOutputBuffer.snapshot();
+	long frames = qMin((long) curveData.size(), snap.size() / numChnls);
+	long start = snap.size() - frames * numChnls + channel;
+	for (long i = 0; i < frames; i++) {
+		long bufferIndex = start + i*numChnls;
+		x = (double) snap.at(bufferIndex);
+		y = (double) -snap.at(bufferIndex + 1);
+		curveData[i] = QPointF(x*width*zoomx/4, y*height*zoomy/4);
+	}
+	for (long i = frames; i < curveData.size(); i++) {
+		curveData[i] = QPointF(0, 0);
 	}
 	m_params->widget->setSceneRect(-width/2, -height/2, width, height );
 	curve->setPolygon(curveData);
@@ -591,18 +542,20 @@ void PoincareData::updateData(int channel, double zoomx, double zoomy, bool free
 	QReadWriteLock *mutex = m_params->mutex;
 	mutex->lockForWrite();
 #endif
-	RingBuffer *buffer = &ud->audioOutputBuffer;
-	buffer->lock();
-	QList<MYFLT> list = buffer->buffer;
-	buffer->unlock();
-	long listSize = list.size();
-	long offset = buffer->currentPos;
-	for (int i = 0; i < curveData.size(); i++) {
-		int bufferIndex = (int)((i*zoomx*numChnls) + offset + channel) % listSize;
-		value = (double)list[bufferIndex];
-		curveData[i] = QPoint(lastValue*width*zoomx/2, -value*height*zoomy/2);
+	RingBufferSnapshot snap = ud->audioOutputBuffer.snapshot();
+	double step = zoomx > 0 ? zoomx : 1.0;
+	long totalFrames = snap.size() / numChnls;
+	long points = qMin((long) curveData.size(), (long) (totalFrames / step));
+	long startFrame = totalFrames - (long) (points * step);
+	for (long i = 0; i < points; i++) {
+		long bufferIndex = (startFrame + (long) (i*step)) * numChnls + channel;
+		value = (double) snap.at(bufferIndex);
+		curveData[i] = QPointF(lastValue*width*zoomx/2, -value*height*zoomy/2);
 		lastValue = value;
 	}
+	for (long i = points; i < curveData.size(); i++) {
+		curveData[i] = QPointF(0, 0);
+	}
 	m_params->widget->setSceneRect(-width/2, -height/2, width, height );
 	curve->setPolygon(curveData);
 #ifdef  USE_WIDGET_MUTEX
@@ -332,6 +332,6 @@ void QuteSlider::setInternalValue(double value)
 		m_value = min;
 	else
 		m_value = value;
-	m_valueChanged = true;
+	markValueChanged();
 	//  setProperty("QCS_value", m_value);
 }
@@ -285,7 +285,7 @@ void QuteSpinBox::applyInternalProperties()
     w->setRange(property("QCS_minimum").toDouble(),property("QCS_maximum").toDouble());
 	m_value = property("QCS_value").toDouble();
 	double resolution = property("QCS_resolution").toDouble();
-	m_valueChanged = true;
+	markValueChanged();
 	int i;
     for (i=0; i < 8; i++) {//     Check for used decimal places.
 		double fractpart, intpart;
@@ -462,5 +462,5 @@ void QuteSpinBox::editingFinishedSlot()
 void QuteSpinBox::setInternalValue(double value)
 {
 	m_value = value;
-    m_valueChanged = true;
+    markValueChanged();
 }
@@ -71,7 +71,7 @@ void QuteText::setValue(double value)
 #endif
 	m_value = value;
     m_stringValue = QString::number(value, 'f', m_precision);
-    m_valueChanged = true;
+    markValueChanged();
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
 #endif
@@ -85,7 +85,7 @@ void QuteText::setValue(QString value)
 	//  setText(value);
 	m_stringValue = value;
 	m_value = value.toDouble();
-	m_valueChanged = true;
+	markValueChanged();
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
 #endif
@@ -173,7 +173,7 @@ void QuteText::setText(QString text)
 	setProperty("QCS_label", text);
 	QString displayText = text;
 	m_stringValue = text;
-	m_valueChanged = true;
+	markValueChanged();
 	displayText.replace("\n", "<br />");
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
@@ -200,7 +200,7 @@ void QuteText::applyInternalProperties()
     m_precision = property("QCS_precision").toInt();
     m_stringValue = property("QCS_label").toString();
 	m_value = m_stringValue.toDouble();
-	m_valueChanged = true;
+	markValueChanged();
 
     Qt::Alignment align;
     QString horizontalAlignment = property("QCS_alignment").toString();
@@ -848,7 +848,7 @@ void QuteLineEdit::applyInternalProperties()
 
 	//  static_cast<QLineEdit*>(m_widget)->setText(property("QCS_label").toString());
 	m_stringValue = property("QCS_label").toString();
-	m_valueChanged = true;
+	markValueChanged();
 	Qt::Alignment align;
 
 	QString alignText = property("QCS_alignment").toString();
@@ -972,7 +972,7 @@ void QuteLineEdit::textEdited(QString text)
 	widgetLock.lockForRead();
 #endif
 	m_stringValue = text;
-	m_valueChanged = true;
+	markValueChanged();
 	QPair<QString, QString> channelValue(m_channel, m_stringValue);
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
@@ -1302,7 +1302,7 @@ void QuteScrollNumber::applyInternalProperties()
 	//  qDebug() << property("QCS_bgcolormode").toBool();
 	//  qDebug() << "QuteScrollNumber::applyInternalProperties() sylesheet" <<  m_widget->styleSheet();
     */
-	m_valueChanged = true;
+	markValueChanged();
 }
 
 QString QuteScrollNumber::getCabbageLine()
@@ -1370,7 +1370,7 @@ void QuteScrollNumber::setValue(double value)
 		displayValue = m_max;
 	}
 	m_stringValue = QString::number(displayValue, 'f', m_places);
-	m_valueChanged = true;
+	markValueChanged();
 	//   qDebug("QuteScrollNumber::setValue places = %i value = %f", m_places, m_value);
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
@@ -39,6 +39,10 @@ QuteWidget::QuteWidget(QWidget *parent):
 	m_stringValue = "";
 	m_valueChanged = false;
 	m_value2Changed = false;
+	m_dirtyList.store(nullptr);
+	m_valueChannels.store(nullptr);
+	dirtyNext.store(nullptr);
+	dirtyQueued.store(false);
 	m_locked = false;
     m_description = "";
     // used by all widgets which need access to the api (TableDisplay)
@@ -83,10 +87,10 @@ void QuteWidget::setValue(double value)
 	widgetLock.lockForWrite();
 #endif
 	m_value = value;
-	m_valueChanged = true;
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
 #endif
+	markValueChanged(); // Reads the value back, so outside the lock
 }
 
 void QuteWidget::setValue2(double value)
@@ -95,10 +99,10 @@ void QuteWidget::setValue2(double value)
 	widgetLock.lockForWrite();
 #endif
 	m_value2 = value;
-	m_value2Changed = true;
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
 #endif
+	markValue2Changed(); // Reads the value back, so outside the lock
 }
 
 void QuteWidget::setValue(QString value)
@@ -107,10 +111,10 @@ void QuteWidget::setValue(QString value)
 	widgetLock.lockForWrite();
 #endif
 	m_stringValue = value;
-	m_valueChanged = true;
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
 #endif
+	markValueChanged(); // Reads the value back, so outside the lock
 }
 
 void QuteWidget::setMidiValue(int /* value */)
@@ -257,16 +261,21 @@ void QuteWidget::applyInternalProperties()
 	width = property("QCS_width").toInt();
 	height = property("QCS_height").toInt();
 	setWidgetGeometry(x,y,width, height);
+	QString oldChannel = m_channel;
+	QString oldChannel2 = m_channel2;
 	m_channel = property("QCS_objectName").toString();
     m_channel2 = property("QCS_objectName2").toString();
 	m_midicc = property("QCS_midicc").toInt();
 	m_midichan = property("QCS_midichan").toInt();
 	setVisible(property("QCS_visible").toBool());
-	m_valueChanged = true;
+	markValueChanged();
     m_description = property("QCS_description").toString();
 #ifdef  USE_WIDGET_MUTEX
 	widgetLock.unlock();
 #endif
+	if (m_channel != oldChannel || m_channel2 != oldChannel2) {
+		emit channelsChanged(this);
+	}
 }
 
 void QuteWidget::markChanged()
@@ -556,7 +565,7 @@ void QuteWidget::applyProperties()
 	emit(widgetChanged(this));
 	emit propertiesAccepted();
 	parentWidget()->setFocus(Qt::PopupFocusReason); // For some reason focus is grabbed away from the layout
-	m_valueChanged = true;
+	markValueChanged();
 }
 
 QList<QAction *> QuteWidget::getParentActionList()
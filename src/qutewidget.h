@@ -27,7 +27,6 @@
 #include <QtXml>
 
 #define QCS_CURRENT_XML_VERSION "2"
-#define QCS_CURVE_BUFFER_SIZE 256
 //#define USE_WIDGET_MUTEX
 
 #include "csoundengine.h"
@@ -97,6 +96,33 @@ public:
 
 	bool m_valueChanged;
 	bool m_value2Changed;
+	// Flag a new value, publish it for invalue and queue the widget for the
+	// next refresh of its layout. Every change of a widget value goes
+	// through here.
+	// Called from other threads only with the layout's widgetsMutex held,
+	// which the layout also holds while unlinking the widget to delete it.
+	void markValueChanged() {
+		m_valueChanged = true;
+		publishValue(m_channel, getValue());
+		DirtyList<QuteWidget> *list = m_dirtyList.load(std::memory_order_acquire);
+		if (list != nullptr)
+			list->push(this);
+	}
+	void markValue2Changed() {
+		m_value2Changed = true;
+		publishValue(m_channel2, getValue2());
+		DirtyList<QuteWidget> *list = m_dirtyList.load(std::memory_order_acquire);
+		if (list != nullptr)
+			list->push(this);
+	}
+	void setDirtyList(DirtyList<QuteWidget> *list) {
+		m_dirtyList.store(list, std::memory_order_release);
+	}
+	void setValueChannels(ValueChannelTable *channels) {
+		m_valueChannels.store(channels, std::memory_order_release);
+	}
+	std::atomic<QuteWidget *> dirtyNext;  // Used by DirtyList
+	std::atomic<bool> dirtyQueued;
 
 
 public slots:
@@ -125,6 +151,17 @@ protected:
 	bool m_locked; // Allow modification of widget (properties, alignment, etc.)
     CsoundUserData *m_csoundUserData;
     QString m_description;
+	std::atomic<DirtyList<QuteWidget> *> m_dirtyList;
+	std::atomic<ValueChannelTable *> m_valueChannels; // Input slots read by invalue
+
+	void publishValue(const QString &channel, double value) {
+		ValueChannelTable *channels = m_valueChannels.load(std::memory_order_acquire);
+		if (channels == nullptr || channel.isEmpty())
+			return;
+		int id = channels->id(channel);
+		if (id >= 0)
+			channels->setInput(id, value);
+	}
 
 
 #ifdef  USE_WIDGET_MUTEX
@@ -162,6 +199,7 @@ signals:
 	void newValue(QPair<QString,double> channelValue);
 	void newValue(QPair<QString,QString> channelValue);
 	void widgetChanged(QuteWidget* widget);
+	void channelsChanged(QuteWidget* widget); // Channel names changed, lookups must be updated
 	void deleteThisWidget(QuteWidget *thisWidget);
 	void propertiesAccepted();
 	void showMidiLearn(QuteWidget* widget);
@@ -29,6 +29,8 @@ HEADERS = "src/about.h" \
     "src/console.h" \
     "src/csoundengine.h" \
     "src/csoundoptions.h" \
+    "src/csdstructureindex.h" \
+    "src/csdloader.h" \
     "src/curve.h" \
     "src/dockhelp.h" \
     "src/documentpage.h" \
@@ -36,6 +38,7 @@ HEADERS = "src/about.h" \
     "src/dotgenerator.h" \
     "src/eventsheet.h" \
     "src/findreplace.h" \
+    "src/framescheduler.h" \
     "src/framewidget.h" \
     "src/graphicwindow.h" \
     "src/highlighter.h" \
@@ -74,6 +77,7 @@ HEADERS = "src/about.h" \
     "src/pluginspage.h" \
     "src/additionalfilespage.h" \
     "src/scoreeditor.h" \
+    "src/tableenvelope.h" \
     "src/filebeditor.h" \
     $$PWD/myslider.h \
     $$PWD/risset.h \
@@ -91,6 +95,8 @@ SOURCES = "src/about.cpp" \
     "src/console.cpp" \
     "src/csoundengine.cpp" \
     "src/csoundoptions.cpp" \
+    "src/csdstructureindex.cpp" \
+    "src/csdloader.cpp" \
     "src/curve.cpp" \
     "src/dockhelp.cpp" \
     "src/documentpage.cpp" \
@@ -98,6 +104,7 @@ SOURCES = "src/about.cpp" \
     "src/dotgenerator.cpp" \
     "src/eventsheet.cpp" \
     "src/findreplace.cpp" \
+    "src/framescheduler.cpp" \
     "src/framewidget.cpp" \
     "src/graphicwindow.cpp" \
     "src/highlighter.cpp" \
@@ -136,6 +143,7 @@ SOURCES = "src/about.cpp" \
     "src/pluginspage.cpp" \
     "src/additionalfilespage.cpp" \
     "src/scoreeditor.cpp" \
+    "src/tableenvelope.cpp" \
     "src/filebeditor.cpp" \
     $$PWD/risset.cpp \
     $$PWD/selectcolorbutton.cpp \
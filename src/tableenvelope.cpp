@@ -0,0 +1,309 @@
+/*
+	Copyright (C) 2026 The CsoundQt contributors
+
+	This file is part of CsoundQt.
+
+	CsoundQt is free software; you can redistribute it
+	and/or modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	CsoundQt is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with Csound; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+	02111-1307 USA
+*/
+
+#include "tableenvelope.h"
+
+#include <cstring>
+
+void TableEnvelope::build(const MYFLT *data, int size)
+{
+	m_size = size;
+	int levelCount = 0;
+	for (qint64 block = QCS_ENVELOPE_BLOCK; block < size; block *= QCS_ENVELOPE_FACTOR) {
+		levelCount++;
+	}
+	m_levels.resize(levelCount); // Levels keep their buffers when rebuilt
+	int blockCount = (int) ((size + QCS_ENVELOPE_BLOCK - 1) / QCS_ENVELOPE_BLOCK);
+	m_checksums.resize(blockCount);
+	for (int b = 0; b < blockCount; b++) {
+		m_checksums[b] = blockChecksum(data, b);
+	}
+	m_nextCheck = 0;
+	m_hotFirst = m_hotLast = -1;
+	qint64 blockSize = QCS_ENVELOPE_BLOCK;
+	for (int l = 0; l < levelCount; l++) {
+		Level &level = m_levels[l];
+		level.blockSize = blockSize;
+		int count = (int) ((size + blockSize - 1) / blockSize);
+		level.mins.resize(count);
+		level.maxs.resize(count);
+		float *mins = level.mins.data();
+		float *maxs = level.maxs.data();
+		if (l == 0) {
+			for (int b = 0; b < count; b++) {
+				int start = b * QCS_ENVELOPE_BLOCK;
+				int end = qMin(start + QCS_ENVELOPE_BLOCK, size);
+				MYFLT blockMin = data[start], blockMax = data[start];
+				for (int i = start + 1; i < end; i++) {
+					blockMin = data[i] < blockMin ? data[i] : blockMin;
+					blockMax = data[i] > blockMax ? data[i] : blockMax;
+				}
+				mins[b] = (float) blockMin;
+				maxs[b] = (float) blockMax;
+			}
+		}
+		else {
+			const Level &finer = m_levels[l - 1];
+			int finerCount = finer.mins.size();
+			for (int b = 0; b < count; b++) {
+				int start = b * QCS_ENVELOPE_FACTOR;
+				int end = qMin(start + QCS_ENVELOPE_FACTOR, finerCount);
+				float blockMin = finer.mins[start], blockMax = finer.maxs[start];
+				for (int i = start + 1; i < end; i++) {
+					blockMin = qMin(blockMin, finer.mins[i]);
+					blockMax = qMax(blockMax, finer.maxs[i]);
+				}
+				mins[b] = blockMin;
+				maxs[b] = blockMax;
+			}
+		}
+		blockSize *= QCS_ENVELOPE_FACTOR;
+	}
+	if (size > 0) {
+		range(data, 0, size, m_min, m_max);
+	}
+	else {
+		m_min = m_max = 0;
+	}
+}
+
+bool TableEnvelope::update(const MYFLT *data, int size, qint64 &first, qint64 &last)
+{
+	if (size != m_size || m_checksums.isEmpty()) {
+		build(data, size);
+		first = 0;
+		last = size;
+		return size > 0;
+	}
+	// The table still has to be read, but checksums are much cheaper than
+	// rebuilding every level, and usually only a few blocks are written
+	int firstBlock = -1, lastBlock = -1;
+	int blockCount = m_checksums.size();
+	if (blockCount <= QCS_ENVELOPE_CHECK_BLOCKS) {
+		checkBlocks(data, 0, blockCount, firstBlock, lastBlock);
+	}
+	else {
+		// Bounded work per call whatever the size of the table. Tables are
+		// mostly written progressively, so the neighbourhood of the last
+		// change is checked every time, the rest in turn.
+		int hotFirst = -1, hotLast = -1;
+		if (m_hotFirst >= 0) {
+			int end = qMin(m_hotLast + 1 + QCS_ENVELOPE_CHECK_BLOCKS / 4, blockCount);
+			int begin = qMax(m_hotFirst - QCS_ENVELOPE_CHECK_BLOCKS / 4,
+							 end - QCS_ENVELOPE_CHECK_BLOCKS);
+			checkBlocks(data, qMax(begin, 0), end, hotFirst, hotLast);
+		}
+		int end = qMin(m_nextCheck + QCS_ENVELOPE_CHECK_BLOCKS, blockCount);
+		checkBlocks(data, m_nextCheck, end, firstBlock, lastBlock);
+		m_nextCheck = end < blockCount ? end : 0;
+		if (hotFirst >= 0) { // Still being written there
+			m_hotFirst = hotFirst;
+			m_hotLast = hotLast;
+			firstBlock = firstBlock < 0 ? hotFirst : qMin(firstBlock, hotFirst);
+			lastBlock = qMax(lastBlock, hotLast);
+		}
+		else {
+			m_hotFirst = firstBlock;
+			m_hotLast = lastBlock;
+		}
+	}
+	if (firstBlock < 0) {
+		first = last = 0;
+		return false;
+	}
+	updateTotal(data);
+	first = (qint64) firstBlock * QCS_ENVELOPE_BLOCK;
+	last = qMin((qint64) (lastBlock + 1) * QCS_ENVELOPE_BLOCK, (qint64) size);
+	return true;
+}
+
+// Updates the blocks of [begin, end) whose checksum changed, widening
+// [firstBlock, lastBlock] to include them
+void TableEnvelope::checkBlocks(const MYFLT *data, int begin, int end,
+								int &firstBlock, int &lastBlock)
+{
+	quint64 *checksums = m_checksums.data();
+	for (int b = begin; b < end; b++) {
+		quint64 checksum = blockChecksum(data, b);
+		if (checksum != checksums[b]) {
+			checksums[b] = checksum;
+			updateBlock(data, b);
+			if (firstBlock < 0 || b < firstBlock)
+				firstBlock = b;
+			lastBlock = qMax(lastBlock, b);
+		}
+	}
+}
+
+quint64 TableEnvelope::blockChecksum(const MYFLT *data, int block) const
+{
+	// Fletcher style sums of the raw words, so that moved values count too.
+	// Eight interleaved lanes keep the loop free of dependencies between
+	// consecutive words.
+	const char *bytes = reinterpret_cast<const char *>(data + (qint64) block * QCS_ENVELOPE_BLOCK);
+	int count = (int) (qMin((qint64) QCS_ENVELOPE_BLOCK,
+							m_size - (qint64) block * QCS_ENVELOPE_BLOCK)
+					   * sizeof(MYFLT) / sizeof(quint32));
+	quint32 words[QCS_ENVELOPE_BLOCK * sizeof(MYFLT) / sizeof(quint32)];
+	memcpy(words, bytes, count * sizeof(quint32));
+	quint64 sums[8] = {0}, sumsOfSums[8] = {0};
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		for (int k = 0; k < 8; k++) {
+			sums[k] += words[i + k];
+			sumsOfSums[k] += sums[k];
+		}
+	}
+	for (; i < count; i++) {
+		sums[0] += words[i];
+		sumsOfSums[0] += sums[0];
+	}
+	quint64 checksum = 0;
+	for (int k = 0; k < 8; k++) {
+		checksum = checksum * 31 + (sums[k] ^ (sumsOfSums[k] << 32 | sumsOfSums[k] >> 32));
+	}
+	return checksum;
+}
+
+void TableEnvelope::updateBlock(const MYFLT *data, int block)
+{
+	// The block itself, then its parent at each coarser level
+	qint64 start = (qint64) block * QCS_ENVELOPE_BLOCK;
+	qint64 end = qMin(start + QCS_ENVELOPE_BLOCK, (qint64) m_size);
+	MYFLT blockMin = data[start], blockMax = data[start];
+	for (qint64 i = start + 1; i < end; i++) {
+		blockMin = data[i] < blockMin ? data[i] : blockMin;
+		blockMax = data[i] > blockMax ? data[i] : blockMax;
+	}
+	if (m_levels.isEmpty())
+		return;
+	m_levels[0].mins[block] = (float) blockMin;
+	m_levels[0].maxs[block] = (float) blockMax;
+	for (int l = 1; l < m_levels.size(); l++) {
+		const Level &finer = m_levels[l - 1];
+		block /= QCS_ENVELOPE_FACTOR;
+		int first = block * QCS_ENVELOPE_FACTOR;
+		int last = qMin(first + QCS_ENVELOPE_FACTOR, finer.mins.size());
+		float levelMin = finer.mins[first], levelMax = finer.maxs[first];
+		for (int i = first + 1; i < last; i++) {
+			levelMin = qMin(levelMin, finer.mins[i]);
+			levelMax = qMax(levelMax, finer.maxs[i]);
+		}
+		m_levels[l].mins[block] = levelMin;
+		m_levels[l].maxs[block] = levelMax;
+	}
+}
+
+void TableEnvelope::updateTotal(const MYFLT *data)
+{
+	if (m_levels.isEmpty()) { // A single block
+		range(data, 0, m_size, m_min, m_max);
+		return;
+	}
+	const Level &coarsest = m_levels.last();
+	m_min = coarsest.mins[0];
+	m_max = coarsest.maxs[0];
+	for (int b = 1; b < coarsest.mins.size(); b++) {
+		m_min = qMin(m_min, (MYFLT) coarsest.mins[b]);
+		m_max = qMax(m_max, (MYFLT) coarsest.maxs[b]);
+	}
+}
+
+void TableEnvelope::clear()
+{
+	m_levels.clear();
+	m_checksums.clear();
+	m_size = 0;
+	m_min = m_max = 0;
+	m_nextCheck = 0;
+	m_hotFirst = m_hotLast = -1;
+}
+
+void TableEnvelope::range(const MYFLT *data, qint64 first, qint64 last,
+						  MYFLT &min, MYFLT &max) const
+{
+	min = max = data[first];
+	accumulate(data, first, last, m_levels.size() - 1, min, max);
+}
+
+void TableEnvelope::accumulate(const MYFLT *data, qint64 first, qint64 last, int level,
+							   MYFLT &min, MYFLT &max) const
+{
+	// Whole blocks of the coarsest level that has some inside the range, then
+	// the remainders on each side from finer levels, down to the samples.
+	qint64 firstBlock = 0, lastBlock = 0;
+	for (; level >= 0; level--) {
+		qint64 blockSize = m_levels[level].blockSize;
+		firstBlock = (first + blockSize - 1) / blockSize;
+		lastBlock = last / blockSize;
+		if (firstBlock < lastBlock)
+			break;
+	}
+	if (level < 0) {
+		for (qint64 i = first; i < last; i++) {
+			min = data[i] < min ? data[i] : min;
+			max = data[i] > max ? data[i] : max;
+		}
+		return;
+	}
+	const Level &l = m_levels[level];
+	for (qint64 b = firstBlock; b < lastBlock; b++) {
+		min = qMin(min, (MYFLT) l.mins[b]);
+		max = qMax(max, (MYFLT) l.maxs[b]);
+	}
+	if (first < firstBlock * l.blockSize) {
+		accumulate(data, first, firstBlock * l.blockSize, level - 1, min, max);
+	}
+	if (lastBlock * l.blockSize < last) {
+		accumulate(data, lastBlock * l.blockSize, last, level - 1, min, max);
+	}
+}
+
+void TableEnvelope::polyline(const MYFLT *data, qint64 first, qint64 last, int columns,
+							 QPolygonF &polygon) const
+{
+	first = qMax(first, (qint64) 0);
+	last = qMin(last, (qint64) m_size);
+	if (last <= first || columns <= 0) {
+		polygon.resize(0);
+		return;
+	}
+	if (last - first <= 2 * columns) {
+		polygon.resize((int) (last - first));
+		QPointF *points = polygon.data();
+		for (qint64 i = first; i < last; i++) {
+			*points++ = QPointF(i, data[i]);
+		}
+		return;
+	}
+	polygon.resize(columns * 2);
+	QPointF *points = polygon.data();
+	double span = (double) (last - first) / columns;
+	for (int c = 0; c < columns; c++) {
+		qint64 start = first + (qint64) (c * span);
+		qint64 end = c == columns - 1 ? last : first + (qint64) ((c + 1) * span);
+		MYFLT min, max;
+		range(data, start, end, min, max);
+		// Alternate the direction so consecutive columns join at one end
+		*points++ = QPointF(start, c % 2 == 0 ? min : max);
+		*points++ = QPointF(start, c % 2 == 0 ? max : min);
+	}
+}
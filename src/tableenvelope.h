@@ -0,0 +1,88 @@
+/*
+	Copyright (C) 2026 The CsoundQt contributors
+
+	This file is part of CsoundQt.
+
+	CsoundQt is free software; you can redistribute it
+	and/or modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	CsoundQt is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with Csound; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+	02111-1307 USA
+*/
+
+#ifndef TABLEENVELOPE_H
+#define TABLEENVELOPE_H
+
+#include <QVector>
+#include <QPolygonF>
+
+#include "types.h"
+
+#define QCS_ENVELOPE_BLOCK 32  // Samples summarized by each entry of the finest level
+#define QCS_ENVELOPE_FACTOR 4  // Entries of a level summarized by one entry of the next
+#define QCS_ENVELOPE_CHECK_BLOCKS 2048  // Blocks of a large table checked by one update()
+
+// Minimum and maximum of a table at decreasing resolutions (a mipmap), so
+// the envelope of any range can be drawn in time proportional to the number
+// of pixel columns instead of the number of samples, without missing peaks.
+// The table itself is not copied: the queries take the same data pointer
+// that was passed to build().
+class TableEnvelope
+{
+public:
+	TableEnvelope() : m_size(0), m_min(0), m_max(0), m_nextCheck(0), m_hotFirst(-1), m_hotLast(-1) {}
+
+	void build(const MYFLT *data, int size);
+	// Updates the envelope for the blocks of data that changed since the
+	// last build() or update() with the same size (a table written in
+	// place). The changed samples are [first, last), empty if nothing
+	// changed. Returns false if nothing changed.
+	// Tables of more than QCS_ENVELOPE_CHECK_BLOCKS blocks are checked a
+	// window at a time, plus the blocks around the last change, so a write
+	// far from the previous ones may only be seen a few calls later.
+	bool update(const MYFLT *data, int size, qint64 &first, qint64 &last);
+	void clear();
+	int size() const { return m_size; }
+	MYFLT min() const { return m_min; }
+	MYFLT max() const { return m_max; }
+
+	// Minimum and maximum of data[first, last), first < last
+	void range(const MYFLT *data, qint64 first, qint64 last, MYFLT &min, MYFLT &max) const;
+	// Fills polygon with a polyline of data[first, last) drawn over columns
+	// pixels, in (sample index, value) coordinates. With more than two
+	// samples per column, each column becomes a vertical line from its
+	// minimum to its maximum, otherwise all samples are used.
+	void polyline(const MYFLT *data, qint64 first, qint64 last, int columns,
+				  QPolygonF &polygon) const;
+
+private:
+	struct Level {
+		qint64 blockSize;
+		QVector<float> mins;
+		QVector<float> maxs;
+	};
+	void accumulate(const MYFLT *data, qint64 first, qint64 last, int level,
+					MYFLT &min, MYFLT &max) const;
+	void updateBlock(const MYFLT *data, int block);
+	void updateTotal(const MYFLT *data);
+	quint64 blockChecksum(const MYFLT *data, int block) const;
+	void checkBlocks(const MYFLT *data, int begin, int end, int &firstBlock, int &lastBlock);
+
+	QVector<Level> m_levels; // Finest first
+	QVector<quint64> m_checksums; // Of each block of the finest level
+	int m_size;
+	MYFLT m_min, m_max;
+	int m_nextCheck; // First block of the next window checked in a large table
+	int m_hotFirst, m_hotLast; // Blocks changed on the last update(), -1 if none
+};
+
+#endif // TABLEENVELOPE_H
@@ -26,6 +26,14 @@
 #include <QMutex>
 #include <QtGlobal>
 #include <QDebug>
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <memory>
 #include <csound.h>
 
 
@@ -35,12 +43,19 @@
 #define QCS_QUEUETIMER_DEFAULT_TIME 50
 // Maximum number of files in recent files menu
 #define QCS_MAX_RECENT_FILES 20
-// Maximum undo history depth for widget panel and event sheet
+// Maximum undo history depth for the event sheet
 #define QCS_MAX_UNDO 256
+// Maximum memory used by the widget panel undo history
+#define QCS_MAX_UNDO_BYTES (8*1024*1024)
+// Scores with more lines are kept out of the editor if enabled in the options
+#define QCS_EXTERNAL_SCORE_LINES 100000
 
 // Maximum MIDI message queue size for internal control
 #define QCS_MAX_MIDI_QUEUE 128
 
+// Used to keep data shared between the performance thread and the GUI apart
+#define QCS_CACHE_LINE_SIZE 64
+
 #ifdef Q_OS_LINUX
 #define DEFAULT_HTML_DIR "/usr/share/doc/csound-doc/html"
 #define DEFAULT_TERM_EXECUTABLE "/usr/bin/xterm"
@@ -131,124 +146,824 @@ public:
 
 };
 
+struct RingBufferSpan
+{
+    const MYFLT *data;
+    long size;
+};
+
+// A view of the whole ring buffer: head holds the oldest samples (from the
+// write cursor to the end of the memory), tail the newest ones.
+// Index 0 is always frame aligned, as the writer only writes whole frames.
+struct RingBufferSnapshot
+{
+    RingBufferSpan head;
+    RingBufferSpan tail;
+    long writePos;
+    quint64 written;
+
+    long size() const {
+        return head.size + tail.size;
+    }
+
+    MYFLT at(long i) const {
+        return i < head.size ? head.data[i] : tail.data[i - head.size];
+    }
+};
+
+// Single producer/single consumer audio tap.
+// The performance thread writes with putManyScaled(), the GUI reads through
+// readSpans()/consume(), copyAvailableBuffer() or snapshot(). Neither side
+// ever takes a lock: the writer publishes a running sample count and
+// overwrites the oldest data when the reader falls behind, the reader then
+// skips ahead.
+// resize() and allZero() must only be called while the writer is stopped.
 class RingBuffer
 {
 public:
-    RingBuffer() {
-        size = 4096 * 4;
-		resize(size);
-		currentPos = 0;
-		currentReadPos = 0;
-    }
-    ~RingBuffer() = default;
-    QList<MYFLT> buffer;
-	long currentPos;
-	long currentReadPos;
-	int size;
-	QMutex mutex;
-
-	void lock() {
-		mutex.lock();
-	}
-
-	void unlock() {
-		mutex.unlock();
-	}
-
-    long availableWriteSpace() {
-        if(currentReadPos <= currentPos)
-            return size - currentPos + currentReadPos;
-        return currentReadPos - currentPos;
-    }
-
-    long availableReadSpace() {
-        return (currentReadPos <= currentPos ?
-                currentPos - currentReadPos :
-                currentPos - currentReadPos + size);
-    }
-
-	void put(MYFLT value) {
-        mutex.lock();
-        // qDebug() << "RingBuffer::put currentPos " << currentPos << " value " << value;
-		buffer[currentPos] = value;
-		currentPos++;
-        // if (currentPos == currentReadPos) {
-        //     qDebug("RingBuffer: Buffer overflow!");
-        // }
-		if (currentPos >= size)
-			currentPos = 0;
-		mutex.unlock();
-	}
-
-    void putManyScaled(MYFLT *data, long dataSize, MYFLT scaleFactor) {
-        long space = availableWriteSpace();
-        if(dataSize >= space) {
-            // qDebug("RingBuffer: Buffer overflow, only writing %ld elements!", space);
-            currentReadPos = currentPos;
-        }
-        mutex.lock();
-        if(scaleFactor != 1.0) {
-            for(int i=0; i<dataSize; i++) {
-                int idx = (currentPos + i) % size;
-                buffer[idx] = data[i] * scaleFactor;
-            }
+    RingBuffer() : m_data(nullptr), m_size(0), m_writePos(0), m_written(0), m_readCount(0) {
+        resize(4096 * 4);
+    }
+
+    ~RingBuffer() {
+        qFreeAligned(m_data);
+    }
+
+    int size() const {
+        return m_size;
+    }
+
+    // Total number of samples written since the last resize()/allZero()
+    quint64 written() const {
+        return m_written.load(std::memory_order_acquire);
+    }
+
+    long availableReadSpace() const {
+        quint64 pending = written() - m_readCount;
+        return pending > (quint64) m_size ? m_size : (long) pending;
+    }
+
+    void put(MYFLT value) {
+        putManyScaled(&value, 1, 1.0);
+    }
+
+    void putManyScaled(const MYFLT *data, long dataSize, MYFLT scaleFactor) {
+        if (dataSize > m_size) {
+            // Only the newest samples fit
+            data += dataSize - m_size;
+            dataSize = m_size;
+        }
+        long pos = m_writePos;
+        long first = qMin(dataSize, (long) m_size - pos);
+        MYFLT *out = m_data + pos;
+        if (scaleFactor != 1.0) {
+            for (long i = 0; i < first; i++)
+                out[i] = data[i] * scaleFactor;
+            for (long i = first; i < dataSize; i++)
+                m_data[i - first] = data[i] * scaleFactor;
         } else {
-            for(int i=0; i<dataSize; i++) {
-                int idx = (currentPos + i) % size;
-                buffer[idx] = data[i];
-            }
+            memcpy(out, data, first * sizeof(MYFLT));
+            memcpy(m_data, data + first, (dataSize - first) * sizeof(MYFLT));
+        }
+        pos += dataSize;
+        if (pos >= m_size)
+            pos -= m_size;
+        m_writePos = pos;
+        m_written.store(m_written.load(std::memory_order_relaxed) + dataSize,
+                        std::memory_order_release);
+    }
+
+    // Returns the number of unread samples (at most maxCount) and points
+    // first/second to them in the buffer memory. Nothing is copied and
+    // nothing is consumed. The writer may overwrite the data if the reader
+    // holds on to the spans longer than a buffer length.
+    long readSpans(long maxCount, RingBufferSpan &first, RingBufferSpan &second) {
+        quint64 total = written();
+        if (total - m_readCount > (quint64) m_size) {
+            // overrun, drop what has already been overwritten
+            m_readCount = total - m_size;
         }
-        auto previousPos = currentPos;
-        currentPos += dataSize;
-        currentPos %= size;
-        if(currentPos > currentReadPos && previousPos < currentReadPos)
-            currentReadPos = currentPos;
-        else if(currentPos < currentReadPos && previousPos >= currentReadPos)
-            currentReadPos = currentPos;
-        mutex.unlock();
-    }
-
-	bool copyAvailableBuffer(MYFLT *data, int saveSize) {
-		//		qDebug() << "RingBuffer::copyAvailableBuffer saveSize " << saveSize << " currentPos " << currentPos << " currentReadPos " << currentReadPos ;
-		mutex.lock();
-        int available = availableReadSpace();
-        //       qDebug("RingBuffer: Available: %i", available);
-		if (available <= saveSize) { //not enough data in buffer
-			mutex.unlock();
-			return false;
-		}
-		for (int i = 0; i < saveSize; i++) {
-			//         qDebug("RingBuffer: currentPos %li currentReadPos %li value %f", currentPos, currentReadPos, buffer[currentReadPos%size]);
-			data[i] = buffer[currentReadPos];
-			currentReadPos++;
-			if (currentReadPos == size) {
-				currentReadPos = 0;			}
-		}
-		mutex.unlock();
-		return true;
-	}
+        long count = qMin((long) (total - m_readCount), maxCount);
+        long start = (long) (m_readCount % m_size);
+        long firstSize = qMin(count, (long) m_size - start);
+        first.data = m_data + start;
+        first.size = firstSize;
+        second.data = m_data;
+        second.size = count - firstSize;
+        return count;
+    }
+
+    void consume(long count) {
+        m_readCount += count;
+    }
+
+    bool copyAvailableBuffer(MYFLT *data, int saveSize) {
+        if (availableReadSpace() <= saveSize) { //not enough data in buffer
+            return false;
+        }
+        RingBufferSpan first, second;
+        readSpans(saveSize, first, second);
+        memcpy(data, first.data, first.size * sizeof(MYFLT));
+        memcpy(data + first.size, second.data, second.size * sizeof(MYFLT));
+        consume(saveSize);
+        return true;
+    }
+
+    // Returns the whole buffer contents, oldest sample first, as two spans into
+    // the buffer memory together with the write cursor. Nothing is copied.
+    RingBufferSnapshot snapshot() const {
+        RingBufferSnapshot snap;
+        snap.written = written();
+        snap.writePos = (long) (snap.written % m_size);
+        if (snap.written < (quint64) m_size) {
+            snap.head.data = m_data;
+            snap.head.size = (long) snap.written;
+            snap.tail.data = m_data;
+            snap.tail.size = 0;
+        } else {
+            snap.head.data = m_data + snap.writePos;
+            snap.head.size = m_size - snap.writePos;
+            snap.tail.data = m_data;
+            snap.tail.size = snap.writePos;
+        }
+        return snap;
+    }
 
     void resize(int newsize) {
-        qDebug("Resizing scope: %d to %d", buffer.size(), newsize);
-        mutex.lock();
-		buffer.clear();
-        for (int i = 0; i< newsize; i++) {
-			buffer.append(0.0);
-		}
-		currentPos = 0;
-        size = newsize;
-		mutex.unlock();
-	}
-
-	void  allZero() {
-		mutex.lock();
-		for (int i = 0; i< buffer.size(); i++) {
-			buffer[i] = 0;
-		}
-		currentReadPos = 0;
-		currentPos = 0;
-		mutex.unlock();
-	}
+        qDebug("Resizing scope: %d to %d", m_size, newsize);
+        if (newsize != m_size) {
+            qFreeAligned(m_data);
+            m_data = static_cast<MYFLT *>(qMallocAligned(newsize * sizeof(MYFLT),
+                                                         QCS_CACHE_LINE_SIZE));
+            m_size = newsize;
+        }
+        allZero();
+    }
+
+    void allZero() {
+        memset(m_data, 0, m_size * sizeof(MYFLT));
+        m_writePos = 0;
+        m_readCount = 0;
+        m_written.store(0, std::memory_order_release);
+    }
+
+private:
+    Q_DISABLE_COPY(RingBuffer)
+
+    MYFLT *m_data;
+    int m_size;
+    // Writer side
+    long m_writePos;
+    char m_writerPad[QCS_CACHE_LINE_SIZE];
+    std::atomic<quint64> m_written;
+    char m_sharedPad[QCS_CACHE_LINE_SIZE];
+    // Reader side
+    quint64 m_readCount;
+};
+
+// Set of dirty flags that can be marked from one thread and drained from
+// another without locking. Draining costs one load per 64 flags plus the
+// work for the flags actually set.
+class DirtyBitset
+{
+public:
+    DirtyBitset() : m_words(0) {}
+
+    // Not thread safe, call only while nobody marks or drains
+    void reset(int size) {
+        m_words = (size + 63) / 64;
+        m_bits.reset(m_words > 0 ? new std::atomic<quint64>[m_words] : nullptr);
+        for (int i = 0; i < m_words; i++) {
+            m_bits[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void mark(int index) {
+        m_bits[index >> 6].fetch_or(Q_UINT64_C(1) << (index & 63), std::memory_order_release);
+    }
+
+    // Calls func(index) for every flag marked since the last drain
+    template <typename Func>
+    void drain(Func func) {
+        for (int w = 0; w < m_words; w++) {
+            if (m_bits[w].load(std::memory_order_relaxed) == 0)
+                continue;
+            quint64 bits = m_bits[w].exchange(0, std::memory_order_acquire);
+            while (bits) {
+                func((w << 6) + qCountTrailingZeroBits(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(DirtyBitset)
+
+    int m_words;
+    std::unique_ptr<std::atomic<quint64>[]> m_bits;
+};
+
+// Intrusive multiple producer/single consumer list of objects waiting to be
+// refreshed. An object is queued at most once: push() does nothing if it is
+// already in the list. T must have std::atomic<T *> dirtyNext and
+// std::atomic<bool> dirtyQueued members. The consumer takes the whole list
+// at once, so pushing never competes with a partial pop.
+template <typename T>
+class DirtyList
+{
+public:
+    DirtyList() : m_head(nullptr) {}
+
+    void push(T *item) {
+        if (item->dirtyQueued.exchange(true, std::memory_order_acq_rel))
+            return;
+        T *head = m_head.load(std::memory_order_relaxed);
+        do {
+            item->dirtyNext.store(head, std::memory_order_relaxed);
+        } while (!m_head.compare_exchange_weak(head, item, std::memory_order_release,
+                                               std::memory_order_relaxed));
+    }
+
+    // Calls func(item) for every item queued since the last drain. An item
+    // pushed again while func runs is seen on the next drain.
+    template <typename Func>
+    void drain(Func func) {
+        T *item = m_head.exchange(nullptr, std::memory_order_acquire);
+        while (item) {
+            T *next = item->dirtyNext.load(std::memory_order_relaxed);
+            item->dirtyQueued.store(false, std::memory_order_release);
+            func(item);
+            item = next;
+        }
+    }
+
+    // Consumer side only. Nobody may push target while this runs.
+    void remove(T *target) {
+        T *item = m_head.exchange(nullptr, std::memory_order_acquire);
+        while (item) {
+            T *next = item->dirtyNext.load(std::memory_order_relaxed);
+            item->dirtyQueued.store(false, std::memory_order_relaxed);
+            if (item != target)
+                push(item);
+            item = next;
+        }
+    }
+
+    void clear() { drain([](T *) {}); }
+
+private:
+    Q_DISABLE_COPY(DirtyList)
+
+    std::atomic<T *> m_head;
+};
+
+// Control channels resolved to their Csound data pointers once per run and
+// addressed by a small integer id. The GUI publishes values by id without
+// locking, the performance thread stores the values marked dirty into Csound
+// with flush(). setChannels() must only be called while not performing.
+class ChannelTable
+{
+public:
+    ChannelTable() : m_size(0) {}
+
+    void setChannels(const QVector<QString> &names, const QVector<MYFLT *> &pointers) {
+        Q_ASSERT(names.size() == pointers.size());
+        m_names = names;
+        m_pointers = pointers;
+        m_size = names.size();
+        m_ids.clear();
+        for (int i = 0; i < m_size; i++) {
+            m_ids.insert(names[i], i);
+        }
+        m_values.reset(new std::atomic<MYFLT>[m_size]);
+        for (int i = 0; i < m_size; i++) {
+            m_values[i].store(0, std::memory_order_relaxed);
+        }
+        m_dirty.reset(m_size);
+    }
+
+    void clear() {
+        setChannels(QVector<QString>(), QVector<MYFLT *>());
+    }
+
+    int size() const {
+        return m_size;
+    }
+
+    // Returns -1 if the channel was not resolved
+    int id(const QString &name) const {
+        return m_ids.value(name, -1);
+    }
+
+    QString name(int id) const {
+        return m_names[id];
+    }
+
+    MYFLT *pointer(int id) const {
+        return m_pointers[id];
+    }
+
+    void publish(int id, MYFLT value) {
+        m_values[id].store(value, std::memory_order_relaxed);
+        m_dirty.mark(id);
+    }
+
+    // Called from the performance thread, only dirty channels are written
+    void flush() {
+        m_dirty.drain([this](int id) {
+            MYFLT *pointer = m_pointers[id];
+            if (pointer != nullptr)
+                *pointer = m_values[id].load(std::memory_order_relaxed);
+        });
+    }
+
+private:
+    Q_DISABLE_COPY(ChannelTable)
+
+    int m_size;
+    QVector<QString> m_names;
+    QVector<MYFLT *> m_pointers;
+    QHash<QString, int> m_ids;
+    std::unique_ptr<std::atomic<MYFLT>[]> m_values;
+    DirtyBitset m_dirty;
+};
+
+// Channel names used by invalue/outvalue, interned so the value callbacks
+// can find them by their C string without allocating or locking. Each
+// channel has an input slot written by the GUI and read by invalue, and an
+// output slot written by outvalue and drained by the GUI timer.
+// setChannels() must only be called while not performing.
+class ValueChannelTable
+{
+public:
+    ValueChannelTable() : m_size(0), m_mask(0) {}
+
+    void setChannels(const QVector<QString> &names) {
+        m_names = names;
+        m_size = names.size();
+        m_ids.clear();
+        m_keys.clear();
+        int capacity = 16;
+        while (capacity < m_size * 2) {
+            capacity *= 2;
+        }
+        m_mask = capacity - 1;
+        m_slots.fill(-1, capacity);
+        for (int i = 0; i < m_size; i++) {
+            m_ids.insert(names[i], i);
+            m_keys << names[i].toLocal8Bit();
+            quint32 slot = hashName(m_keys[i].constData()) & m_mask;
+            while (m_slots[slot] >= 0) {
+                slot = (slot + 1) & m_mask;
+            }
+            m_slots[slot] = i;
+        }
+        m_inputs.reset(new std::atomic<MYFLT>[m_size]);
+        m_outputs.reset(new std::atomic<MYFLT>[m_size]);
+        for (int i = 0; i < m_size; i++) {
+            m_inputs[i].store(0, std::memory_order_relaxed);
+            m_outputs[i].store(0, std::memory_order_relaxed);
+        }
+        m_dirty.reset(m_size);
+    }
+
+    void clear() {
+        setChannels(QVector<QString>());
+    }
+
+    int size() const {
+        return m_size;
+    }
+
+    // Lookup from the performance thread. Returns -1 if not interned.
+    int id(const char *name) const {
+        if (m_size == 0)
+            return -1;
+        quint32 slot = hashName(name) & m_mask;
+        int id;
+        while ((id = m_slots.at(slot)) >= 0) {
+            if (strcmp(m_keys.at(id).constData(), name) == 0)
+                return id;
+            slot = (slot + 1) & m_mask;
+        }
+        return -1;
+    }
+
+    // Lookup from the GUI thread
+    int id(const QString &name) const {
+        return m_ids.value(name, -1);
+    }
+
+    QString name(int id) const {
+        return m_names[id];
+    }
+
+    void setInput(int id, MYFLT value) {
+        m_inputs[id].store(value, std::memory_order_relaxed);
+    }
+
+    MYFLT input(int id) const {
+        return m_inputs[id].load(std::memory_order_relaxed);
+    }
+
+    void setOutput(int id, MYFLT value) {
+        m_outputs[id].store(value, std::memory_order_relaxed);
+        m_dirty.mark(id);
+    }
+
+    // Calls func(id, value) for every output written since the last call
+    template <typename Func>
+    void drainOutputs(Func func) {
+        m_dirty.drain([this, &func](int id) {
+            func(id, m_outputs[id].load(std::memory_order_relaxed));
+        });
+    }
+
+private:
+    Q_DISABLE_COPY(ValueChannelTable)
+
+    // FNV-1a
+    static quint32 hashName(const char *name) {
+        quint32 h = 2166136261u;
+        while (*name) {
+            h ^= (unsigned char) *name++;
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    int m_size;
+    quint32 m_mask;
+    QVector<QString> m_names;
+    QVector<QByteArray> m_keys;
+    QVector<int> m_slots; // Open addressing table of ids, -1 when empty
+    QHash<QString, int> m_ids;
+    std::unique_ptr<std::atomic<MYFLT>[]> m_inputs;
+    std::unique_ptr<std::atomic<MYFLT>[]> m_outputs;
+    DirtyBitset m_dirty;
+};
+
+// A score event parsed by the thread that sends it, so the performance thread
+// only has to hand the p-fields to csoundScoreEvent(). Lines that can't be
+// expressed that way (string p-fields, carry symbols, several statements)
+// are kept as text in line and sent with csoundInputMessage() instead.
+struct ScoreEvent
+{
+    ScoreEvent() : type(0), time(-1), sequence(0), tag(0), cancel(false), next(nullptr) {}
+
+    char type;
+    QVector<MYFLT> pfields;
+    QByteArray line;
+    qint64 time; // Absolute performance time in samples, -1 for as soon as possible
+    quint64 sequence; // Arrival order, set by the consumer
+    int tag; // Set by the sender to cancel the event while it is pending, 0 if none
+    bool cancel; // Not an event: drops the pending events with the same tag
+    ScoreEvent *next;
+};
+
+// Multiple producer/single consumer FIFO of score events. Any thread may
+// push(), the performance thread takes everything queued so far with
+// takeAll() and owns those events until it hands them back with retire().
+// The consumer never frees memory: retired events are deleted by the
+// producers on their next push().
+class ScoreEventQueue
+{
+public:
+    ScoreEventQueue() {
+        m_head.store(nullptr, std::memory_order_relaxed);
+        m_retired.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~ScoreEventQueue() {
+        freeRetired();
+        freeList(m_head.exchange(nullptr, std::memory_order_acquire));
+    }
+
+    // Takes ownership of event
+    void push(ScoreEvent *event) {
+        freeRetired();
+        pushTo(m_head, event);
+    }
+
+    // Consumer only. Returns the events queued since the last call, oldest
+    // first, linked through next.
+    ScoreEvent *takeAll() {
+        if (m_head.load(std::memory_order_relaxed) == nullptr)
+            return nullptr;
+        ScoreEvent *event = m_head.exchange(nullptr, std::memory_order_acquire);
+        ScoreEvent *reversed = nullptr;
+        while (event) {
+            ScoreEvent *next = event->next;
+            event->next = reversed;
+            reversed = event;
+            event = next;
+        }
+        return reversed;
+    }
+
+    // Consumer only
+    void retire(ScoreEvent *event) {
+        pushTo(m_retired, event);
+    }
+
+    // Deletes everything queued. Only call while nobody is consuming.
+    void discard() {
+        freeRetired();
+        freeList(m_head.exchange(nullptr, std::memory_order_acquire));
+    }
+
+    static void freeList(ScoreEvent *event) {
+        while (event) {
+            ScoreEvent *next = event->next;
+            delete event;
+            event = next;
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(ScoreEventQueue)
+
+    static void pushTo(std::atomic<ScoreEvent *> &top, ScoreEvent *event) {
+        ScoreEvent *old = top.load(std::memory_order_relaxed);
+        do {
+            event->next = old;
+        } while (!top.compare_exchange_weak(old, event,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+    }
+
+    void freeRetired() {
+        if (m_retired.load(std::memory_order_relaxed) == nullptr)
+            return;
+        freeList(m_retired.exchange(nullptr, std::memory_order_acquire));
+    }
+
+    std::atomic<ScoreEvent *> m_head; // Producers
+    char m_pad[QCS_CACHE_LINE_SIZE - sizeof(std::atomic<ScoreEvent *>)];
+    std::atomic<ScoreEvent *> m_retired;
+};
+
+// Min-heap of score events ordered by time, then arrival, used by the
+// performance thread to hold delayed events until their k-cycle. The
+// storage is allocated up front so push() and pop() never allocate; push()
+// returns false when full.
+class ScoreEventScheduler
+{
+public:
+    explicit ScoreEventScheduler(int capacity = 65536)
+        : m_events(new ScoreEvent*[capacity]), m_capacity(capacity), m_size(0), m_sequence(0) {}
+
+    bool isEmpty() const {
+        return m_size == 0;
+    }
+
+    const ScoreEvent *top() const {
+        return m_events[0];
+    }
+
+    bool push(ScoreEvent *event) {
+        if (m_size == m_capacity)
+            return false;
+        event->sequence = m_sequence++;
+        int i = m_size++;
+        while (i > 0) {
+            int parent = (i - 1) / 2;
+            if (!earlier(event, m_events[parent]))
+                break;
+            m_events[i] = m_events[parent];
+            i = parent;
+        }
+        m_events[i] = event;
+        return true;
+    }
+
+    ScoreEvent *pop() {
+        ScoreEvent *first = m_events[0];
+        m_events[0] = m_events[--m_size];
+        siftDown(0);
+        return first;
+    }
+
+    // Calls func(event) for every event with tag and takes them out
+    template <typename Func>
+    void removeTagged(int tag, Func func) {
+        int size = 0;
+        for (int i = 0; i < m_size; i++) {
+            if (m_events[i]->tag == tag)
+                func(m_events[i]);
+            else
+                m_events[size++] = m_events[i];
+        }
+        if (size == m_size)
+            return;
+        m_size = size;
+        for (int i = m_size / 2 - 1; i >= 0; i--) { // Restore the heap
+            siftDown(i);
+        }
+    }
+
+    // Deletes everything held. Only call while the consumer is stopped.
+    void clear() {
+        for (int i = 0; i < m_size; i++) {
+            delete m_events[i];
+        }
+        m_size = 0;
+    }
+
+    ~ScoreEventScheduler() {
+        clear();
+    }
+
+private:
+    Q_DISABLE_COPY(ScoreEventScheduler)
+
+    static bool earlier(const ScoreEvent *a, const ScoreEvent *b) {
+        return a->time < b->time || (a->time == b->time && a->sequence < b->sequence);
+    }
+
+    void siftDown(int i) {
+        ScoreEvent *event = m_events[i];
+        int child;
+        while ((child = 2 * i + 1) < m_size) {
+            if (child + 1 < m_size && earlier(m_events[child + 1], m_events[child]))
+                child++;
+            if (!earlier(m_events[child], event))
+                break;
+            m_events[i] = m_events[child];
+            i = child;
+        }
+        m_events[i] = event;
+    }
+
+    std::unique_ptr<ScoreEvent*[]> m_events;
+    int m_capacity;
+    int m_size;
+    quint64 m_sequence;
+};
+
+
+// Words kept sorted by lower case key, so the candidates for a prefix are a
+// contiguous range found by binary search. Each word carries a use count
+// (for ranking) and a value the owner can use to find its own data.
+class CompletionIndex
+{
+public:
+    struct Entry {
+        QString key;
+        QString word;
+        int count;
+        int value;
+    };
+
+    void clear() { m_entries.clear(); }
+    int size() const { return m_entries.size(); }
+    QStringList words() const {
+        QStringList list;
+        list.reserve(m_entries.size());
+        for (const Entry &entry : m_entries) {
+            list << entry.word;
+        }
+        return list;
+    }
+
+    // Returns true if the word was not in the index
+    bool add(const QString &word, int count = 1, int value = -1) {
+        QString key = word.toLower();
+        int i = lowerBound(key, word);
+        if (i < m_entries.size() && m_entries[i].word == word) {
+            m_entries[i].count += count;
+            return false;
+        }
+        m_entries.insert(i, Entry{key, word, count, value});
+        return true;
+    }
+
+    // Adds many words at once (word -> count): the new ones are sorted once
+    // and merged in, instead of one insertion each. Words that were not in
+    // the index are appended to added.
+    void add(const QHash<QString, int> &counts, QStringList *added = nullptr) {
+        QVector<Entry> fresh;
+        for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+            int i = indexOf(it.key());
+            if (i >= 0)
+                m_entries[i].count += it.value();
+            else
+                fresh << Entry{it.key().toLower(), it.key(), it.value(), -1};
+        }
+        if (fresh.isEmpty())
+            return;
+        std::sort(fresh.begin(), fresh.end(), less);
+        if (added != nullptr) {
+            for (const Entry &entry : fresh) {
+                *added << entry.word;
+            }
+        }
+        QVector<Entry> merged;
+        merged.reserve(m_entries.size() + fresh.size());
+        std::merge(m_entries.begin(), m_entries.end(), fresh.begin(), fresh.end(),
+                   std::back_inserter(merged), less);
+        m_entries.swap(merged);
+    }
+
+    // Removes many words at once (word -> count). Words that are gone from
+    // the index are appended to removed.
+    void remove(const QHash<QString, int> &counts, QStringList *removed = nullptr) {
+        bool gone = false;
+        for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+            int i = indexOf(it.key());
+            if (i < 0)
+                continue;
+            m_entries[i].count -= it.value();
+            if (m_entries[i].count <= 0) {
+                gone = true;
+                if (removed != nullptr)
+                    *removed << it.key();
+            }
+        }
+        if (gone) {
+            m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+                                           [](const Entry &entry) { return entry.count <= 0; }),
+                            m_entries.end());
+        }
+    }
+
+    // Returns true if the word is gone from the index
+    bool remove(const QString &word, int count = 1) {
+        int i = indexOf(word);
+        if (i < 0)
+            return false;
+        m_entries[i].count -= count;
+        if (m_entries[i].count > 0)
+            return false;
+        m_entries.remove(i);
+        return true;
+    }
+
+    int indexOf(const QString &word) const {
+        int i = lowerBound(word.toLower(), word);
+        return (i < m_entries.size() && m_entries[i].word == word) ? i : -1;
+    }
+    bool contains(const QString &word) const { return indexOf(word) >= 0; }
+    int count(const QString &word) const {
+        int i = indexOf(word);
+        return i < 0 ? 0 : m_entries[i].count;
+    }
+    const Entry &at(int i) const { return m_entries[i]; }
+
+    // Entries starting with prefix, most used first (ties in alphabetical
+    // order). If maxResults > 0 only the top maxResults are returned.
+    QVector<Entry> complete(const QString &prefix, int maxResults = 0,
+                            Qt::CaseSensitivity cs = Qt::CaseInsensitive) const {
+        QString key = prefix.toLower();
+        QVector<int> matches;
+        for (int i = lowerBound(key, QString()); i < m_entries.size(); i++) {
+            if (!m_entries[i].key.startsWith(key))
+                break;
+            if (cs == Qt::CaseInsensitive || m_entries[i].word.startsWith(prefix))
+                matches << i;
+        }
+        auto ranked = [this](int a, int b) {
+            return m_entries[a].count > m_entries[b].count
+                    || (m_entries[a].count == m_entries[b].count && a < b);
+        };
+        int n = matches.size();
+        if (maxResults > 0 && maxResults < n) {
+            std::partial_sort(matches.begin(), matches.begin() + maxResults, matches.end(), ranked);
+            n = maxResults;
+        }
+        else {
+            std::sort(matches.begin(), matches.end(), ranked);
+        }
+        QVector<Entry> out;
+        out.reserve(n);
+        for (int i = 0; i < n; i++) {
+            out << m_entries[matches[i]];
+        }
+        return out;
+    }
+
+private:
+    static bool less(const Entry &a, const Entry &b) {
+        int c = a.key.compare(b.key);
+        return c < 0 || (c == 0 && a.word < b.word);
+    }
+
+    // First entry not less than (key, word)
+    int lowerBound(const QString &key, const QString &word) const {
+        int lo = 0, hi = m_entries.size();
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            const Entry &entry = m_entries[mid];
+            int c = entry.key.compare(key);
+            if (c < 0 || (c == 0 && entry.word < word))
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    QVector<Entry> m_entries;
 };
 
 #endif
@@ -21,8 +21,10 @@
 */
 
 #include <cstdlib>
+#include <cstring>
 
 #include <QThread>
+#include <QtConcurrent>
 
 #include "widgetlayout.h"
 #include "qutewidget.h"
@@ -59,12 +61,20 @@ WidgetLayout::WidgetLayout(QWidget* parent) : QWidget(parent)
     auto isLightTheme = palette.text().color().lightness() < palette.window().color().lightness();
 
     m_modified = false;
-    closing = 0;
     mouseX = mouseY = mouseRelX = mouseRelY = mouseBut1 = mouseBut2 = 0;
     m_posx = m_posy =  m_w =  m_h = 0;
     xOffset = yOffset = 0;
     mouseRelX = mouseRelY = 0;
     m_contained = false;
+    m_panelParsePending = false;
+    m_widgetsPending = false;
+    m_panelGeneration = 0;
+    m_mouseValuesStale = true;
+    m_historyIndex = 0;
+    m_historyBytes = 0;
+    m_historyValid = false;
+    m_historyMarkPending = false;
+    connect(&m_panelWatcher, SIGNAL(finished()), this, SLOT(panelParsed()));
 
     midiWriteCounter = 0;
     midiReadCounter = 0;
@@ -73,8 +83,6 @@ WidgetLayout::WidgetLayout(QWidget* parent) : QWidget(parent)
         midiQueue[i].resize(3);
     }
 
-    curveUpdateBuffer.resize(QCS_CURVE_BUFFER_SIZE);
-    curveUpdateBufferCount = 0;
 
     createSliderAct = new QAction(tr("Slider"),this);
     connect(createSliderAct, SIGNAL(triggered()), this, SLOT(createNewSlider()));
@@ -209,7 +217,8 @@ WidgetLayout::WidgetLayout(QWidget* parent) : QWidget(parent)
     // unreadable.
     setBackground(true, QColor(240, 240, 240));
     m_updating = true;
-    updateData(); // Starts updateData timer
+    m_lastUpdate.start();
+    FrameScheduler::instance()->addClient(this);
 
     m_widgetNameToType["BSBSpinBox"] = QuteWidgetType::SPINBOX;
     m_widgetNameToType["BSBLineEdit"] = QuteWidgetType::LINEEDIT;
@@ -229,14 +238,9 @@ WidgetLayout::WidgetLayout(QWidget* parent) : QWidget(parent)
 WidgetLayout::~WidgetLayout()
 {
     disconnect(this, 0,0,0);
-    layoutMutex.lock();
-    closing = 1;
-    layoutMutex.unlock();
-    while (closing == 1) {
-        qApp->processEvents();
-        QThread::usleep(10000);
-    }
+    FrameScheduler::instance()->removeClient(this);
     clearGraphs();  // To free memory from curves.
+    qDeleteAll(m_curvePool);
 }
 
 //unsigned int WidgetLayout::widgetCount()
@@ -257,44 +261,201 @@ void WidgetLayout::loadXmlWidgets(QString xmlWidgets)
 {
     m_xmlFormat = true;
     clearWidgetLayout();
-    QDomDocument doc;
-    if (!doc.setContent(xmlWidgets)) {
-        QMessageBox::warning(this, tr("Widget Error"),
-                             tr("Widgets can't be read! No widgets created."));
-        qDebug() << "WidgetLayout::loadXmlWidgets Error parsing xml text! Aborting.";
+    // The xml is parsed in a worker thread. The widgets are created the
+    // first time the panel is shown or something needs them (e.g. running)
+    m_pendingPanel = WidgetPanelDescription();
+    m_pendingXml = xmlWidgets;
+    m_panelParsePending = true;
+    m_widgetsPending = true;
+    m_panelWatcher.setFuture(QtConcurrent::run(&WidgetLayout::describePanel, xmlWidgets,
+                                               m_panelGeneration));
+    if (isVisible()) {
+        ensureWidgets();
+    }
+}
+
+// Values the widget will report once created, following what each type's
+// applyInternalProperties() does with its xml
+static void readInitialValues(WidgetDescriptor &widget)
+{
+    const QDomElement &e = widget.element;
+    QString label = e.firstChildElement("label").text();
+    if (widget.type == "BSBController") {
+        widget.value = e.firstChildElement("xValue").text().toDouble();
+        widget.value2 = e.firstChildElement("yValue").text().toDouble();
+    }
+    else if (widget.type == "BSBCheckBox") {
+        QDomElement pressed = e.firstChildElement("pressedValue");
+        if (e.firstChildElement("selected").text() == "true") {
+            widget.value = pressed.isNull() ? 1.0 : pressed.text().toDouble();
+        }
+    }
+    else if (widget.type == "BSBButton") {
+        widget.stringValue = e.firstChildElement("stringvalue").text();
+    }
+    else if (widget.type == "BSBDropdown") {
+        widget.value = e.firstChildElement("selectedIndex").text().toInt();
+    }
+    else if (widget.type == "BSBLineEdit") {
+        widget.value = label.toDouble();
+        widget.stringValue = label;
+    }
+    else if (widget.type == "BSBLabel" || widget.type == "BSBDisplay"
+             || widget.type == "BSBScrollNumber") {
+        widget.value = e.firstChildElement("value").text().toDouble();
+        widget.stringValue = label;
+    }
+    else {
+        widget.value = e.firstChildElement("value").text().toDouble();
+    }
+    if (widget.type == "BSBButton" && !widget.channel.startsWith("_Browse")
+            && !widget.channel.startsWith("_MBrowse")) {
+        widget.stringValue = QString::number(widget.value);
+    }
+}
+
+WidgetPanelDescription WidgetLayout::describePanel(QString xmlWidgets, int generation)
+{
+    WidgetPanelDescription panel;
+    panel.generation = generation;
+    if (!panel.doc.setContent(xmlWidgets)) {
+        panel.panelCount = -1;
+        return panel;
+    }
+    QDomNodeList panels = panel.doc.elementsByTagName("bsbPanel");
+    panel.panelCount = panels.size();
+    QDomNode p = panels.item(0);
+    if (p.isNull()) {
+        return panel;
+    }
+    panel.valid = true;
+    QDomNodeList c = p.childNodes();
+    for (int i = 0; i < c.size(); i++) {
+        QDomNode node = c.item(i);
+        if (node.nodeName() != "bsbObject") {
+            panel.properties.append(node);
+            continue;
+        }
+        WidgetDescriptor widget;
+        widget.element = node.toElement();
+        widget.type = widget.element.attribute("type");
+        widget.uuid = widget.element.firstChildElement("uuid").text();
+        widget.channel = widget.element.firstChildElement("objectName").text();
+        widget.channel2 = widget.element.firstChildElement("objectName2").text();
+        readInitialValues(widget);
+        QTextStream stream(&widget.xml);
+        node.save(stream, 1);
+        panel.widgets.append(widget);
+    }
+    return panel;
+}
+
+void WidgetLayout::panelParsed()
+{
+    // A parse started before the layout was cleared or loaded again may
+    // still report here, its result is not for this layout anymore
+    if (!m_panelParsePending || !m_panelWatcher.isFinished()
+            || m_panelWatcher.result().generation != m_panelGeneration)
+        return;
+    ensurePanelParsed();
+}
+
+// Applies the panel level properties once the worker is done (waiting for it
+// if needed). The widgets themselves are created by ensureWidgets().
+void WidgetLayout::ensurePanelParsed()
+{
+    if (!m_panelParsePending)
+        return;
+    m_panelParsePending = false;
+    m_pendingPanel = m_panelWatcher.result();
+    if (m_pendingPanel.generation != m_panelGeneration) { // Superseded
+        m_pendingPanel = WidgetPanelDescription();
+        m_widgetsPending = false;
+        return;
+    }
+    if (!m_pendingPanel.valid) {
+        m_widgetsPending = false;
+        if (m_pendingPanel.panelCount < 0) {
+            QMessageBox::warning(this, tr("Widget Error"),
+                                 tr("Widgets can't be read! No widgets created."));
+            qDebug() << "WidgetLayout::loadXmlWidgets Error parsing xml text! Aborting.";
+        }
+        else {
+            qDebug() << "WidgetLayout::loadXmlWidgets no bsbPanel element! Aborting.";
+        }
         return;
     }
-    QDomNodeList panel = doc.elementsByTagName("bsbPanel");
-    if (panel.size() > 1) {
+    if (m_pendingPanel.panelCount > 1) {
         QMessageBox::warning(this, tr("More than one panel"),
                              tr("The csd file contains more than one widget panel!\n"
                                 "This is not supported by the current version,\n"
                                 "Additional widget panels will be lost if the file is saved!"));
     }
-    QDomNode p = panel.item(0);
-    if (p.isNull()) {
-        qDebug() << "WidgetLayout::loadXmlWidgets no bsbPanel element! Aborting.";
-        return;
+    foreach (QDomNode node, m_pendingPanel.properties) {
+        if (parseXmlNode(node) == -1) {
+            qDebug() << "WidgetLayout::loadXmlWidgets Error in Xml node parsing";
+        }
     }
-    QDomNodeList c = p.childNodes();
+    // Answered from here by getValueForChannel() until the widgets exist
+    m_indexLock.lockForWrite();
+    foreach (const WidgetDescriptor &widget, m_pendingPanel.widgets) {
+        if (!widget.channel.isEmpty() && !m_pendingValues.contains(widget.channel)) {
+            m_pendingValues.insert(widget.channel, widget.value);
+            m_pendingStrings.insert(widget.channel, widget.stringValue);
+        }
+    }
+    foreach (const WidgetDescriptor &widget, m_pendingPanel.widgets) {
+        if (!widget.channel2.isEmpty() && !m_pendingValues.contains(widget.channel2)) {
+            m_pendingValues.insert(widget.channel2, widget.value2);
+        }
+    }
+    m_indexLock.unlock();
+}
+
+void WidgetLayout::ensureWidgets()
+{
+    if (!m_widgetsPending || QThread::currentThread() != thread())
+        return;
+    ensurePanelParsed();
+    if (!m_widgetsPending) // Invalid panel
+        return;
+    m_widgetsPending = false;
     int version = 0;
-    for (int i = 0; i < c.size(); i++) {
-        // auto t0 = std::chrono::high_resolution_clock::now();
-        auto item = c.item(i);
-        int ret = parseXmlNode(item);
-        // auto t1 = std::chrono::high_resolution_clock::now();
-        // auto diff = std::chrono::duration<double, std::milli>(t1-t0).count();
-        // QDEBUG << "parseXmlNode" << item.toElement().attribute("type") << diff << "ms";
+    bool unrecognized = false;
+    for (int i = 0; i < m_pendingPanel.widgets.size(); i++) {
+        int ret = parseXmlNode(m_pendingPanel.widgets[i].element);
         if (ret == -1) {
-            qDebug() << "WidgetLayout::loadXmlWidgets Error in Xml node parsing";
-            QMessageBox::warning(this, tr("Unrecognized wigdet format"),
-                                 tr("There is unrecognized widget information in the file\n"
-                                    "It may be saved with errors."));
+            unrecognized = true;
         }
         if (ret > version) {
             version = ret;
         }
     }
+    m_pendingPanel = WidgetPanelDescription();
+    m_pendingXml.clear();
+    // Values Csound sent while the widgets did not exist
+    widgetsMutex.lock();
+    m_indexLock.lockForWrite();
+    QHash<QString, double> outputs = m_pendingOutputs;
+    QHash<QString, QString> stringOutputs = m_pendingStringOutputs;
+    m_pendingOutputs.clear();
+    m_pendingStringOutputs.clear();
+    m_pendingValues.clear();
+    m_pendingStrings.clear();
+    m_indexLock.unlock();
+    widgetsMutex.unlock();
+    for (auto it = outputs.constBegin(); it != outputs.constEnd(); ++it) {
+        setValue(it.key(), it.value());
+    }
+    for (auto it = stringOutputs.constBegin(); it != stringOutputs.constEnd(); ++it) {
+        setValue(it.key(), it.value());
+    }
+    if (unrecognized) {
+        qDebug() << "WidgetLayout::loadXmlWidgets Error in Xml node parsing";
+        QMessageBox::warning(this, tr("Unrecognized wigdet format"),
+                             tr("There is unrecognized widget information in the file\n"
+                                "It may be saved with errors."));
+    }
     if (version > QString(QCS_CURRENT_XML_VERSION).toInt()) {
         qDebug() << "WidgetLayout::loadXmlWidgets Newer Widget Format version";
         QMessageBox::warning(this, tr("Newer Widget Format"),
@@ -307,18 +468,64 @@ void WidgetLayout::loadXmlWidgets(QString xmlWidgets)
     if (m_editMode) {
         setEditMode(true);
     }
-
-    //	if (m_contained) {
-    //		adjustLayoutSize();
-    //	}
-    //	else {
-    //		this->move(m_posx, m_posy);
-    //		this->resize(m_w, m_h);
-    //		//    setOuterGeometry();
-    //	}
+    if (m_historyMarkPending) {
+        markHistory();
+    }
     qDebug() << "Finished loading xml widgets";
 }
 
+QVector<WidgetDescriptor> WidgetLayout::getWidgetChannels()
+{
+    ensurePanelParsed();
+    if (m_widgetsPending) {
+        return m_pendingPanel.widgets;
+    }
+    QVector<WidgetDescriptor> channels;
+    widgetsMutex.lock();
+    channels.reserve(m_widgets.size());
+    foreach (QuteWidget *w, m_widgets) {
+        WidgetDescriptor widget;
+        widget.type = w->getWidgetType();
+        widget.uuid = w->getUuid();
+        widget.channel = w->getChannelName();
+        widget.channel2 = w->getChannel2Name();
+        widget.value = w->getValue();
+        widget.value2 = w->getValue2();
+        widget.stringValue = w->getStringValue();
+        channels.append(widget);
+    }
+    widgetsMutex.unlock();
+    return channels;
+}
+
+// Both with widgetsMutex held, so ensureWidgets() either sees the value or
+// the widgets were already there
+void WidgetLayout::storePendingValue(const QString &channel, double value)
+{
+    m_indexLock.lockForWrite();
+    m_pendingOutputs.insert(channel, value);
+    if (m_pendingValues.contains(channel)) {
+        m_pendingValues[channel] = value;
+    }
+    m_indexLock.unlock();
+}
+
+void WidgetLayout::storePendingValue(const QString &channel, const QString &value)
+{
+    m_indexLock.lockForWrite();
+    m_pendingStringOutputs.insert(channel, value);
+    if (m_pendingStrings.contains(channel)) {
+        m_pendingStrings[channel] = value;
+    }
+    m_indexLock.unlock();
+}
+
+void WidgetLayout::showEvent(QShowEvent *event)
+{
+    ensureWidgets();
+    QWidget::showEvent(event);
+}
+
 void WidgetLayout::loadXmlPresets(QString xmlPresets)
 {
     QDomDocument doc;
@@ -388,7 +595,30 @@ QString WidgetLayout::getWidgetsText()
 {
     // This function must be used with care as it accesses the widgets, which
     // may cause crashing since widgets are not reentrant
-    QStringList txts = {"<bsbPanel>\n"};
+    if (m_panelParsePending) {
+        return m_pendingXml; // Still being parsed, nothing can have changed
+    }
+    QStringList txts = {"<bsbPanel>\n", getPanelPropertiesText()};
+    if (m_widgetsPending) {
+        // Not created yet, save them as they were read
+        foreach (const WidgetDescriptor &widget, m_pendingPanel.widgets) {
+            txts << widget.xml;
+        }
+    }
+    else {
+        widgetsMutex.lock();
+        for (int i = 0; i < m_widgets.size(); i++) {
+            txts << m_widgets[i]->getWidgetXmlText() << "\n";
+        }
+        widgetsMutex.unlock();
+    }
+    txts << "</bsbPanel>";
+    return txts.join("");
+}
+
+QString WidgetLayout::getPanelPropertiesText()
+{
+    QStringList txts;
     layoutMutex.lock();
     txts << "<label>" << windowTitle() << "</label>\n"
          << "<objectName>" << m_objectName << "</objectName>\n"
@@ -408,15 +638,22 @@ QString WidgetLayout::getWidgetsText()
     txts << "</bgcolor>\n";
 
     layoutMutex.unlock();
-    widgetsMutex.lock();
-    for (int i = 0; i < m_widgets.size(); i++) {
-        txts << m_widgets[i]->getWidgetXmlText() << "\n";
-    }
-    widgetsMutex.unlock();
-    txts << "</bsbPanel>";
     return txts.join("");
 }
 
+void WidgetLayout::setPanelPropertiesText(QString xml)
+{
+    QDomDocument doc;
+    if (!doc.setContent("<bsbPanel>" + xml + "</bsbPanel>")) {
+        qDebug() << "WidgetLayout::setPanelPropertiesText error parsing xml";
+        return;
+    }
+    QDomNodeList nodes = doc.documentElement().childNodes();
+    for (int i = 0; i < nodes.size(); i++) {
+        parseXmlNode(nodes.item(i));
+    }
+}
+
 QString WidgetLayout::getPresetsText()
 {
     QStringList txts = {"<bsbPresets>\n"};
@@ -444,6 +681,7 @@ QString WidgetLayout::getSelectedWidgetsText()
 
 QString WidgetLayout::getMacWidgetsText()
 {
+    ensureWidgets();
     // This function must be used with care as it accesses the widgets, which
     // may cause crashing since widgets are not reentrant
     QString text = "";
@@ -483,6 +721,7 @@ QStringList WidgetLayout::getSelectedMacWidgetsText()
 
 QRect WidgetLayout::getOuterGeometry()
 {
+    ensurePanelParsed();
     return QRect(m_posx, m_posy, m_w, m_h);
 }
 
@@ -494,20 +733,28 @@ void WidgetLayout::setKeyRepeatMode(bool repeat)
 void WidgetLayout::setValue(QString channelName, double value)
 {
     // qDebug() << "Setting channel" << channelName << value;
+    // The widgets publish their new values for invalue themselves
+    // Looked up with widgetsMutex held, so they can't be deleted meanwhile
     widgetsMutex.lock();
-    for (int i = 0; i < m_widgets.size(); i++) {
-        if (m_widgets[i]->getUuid() == channelName) {
-            m_widgets[i]->setValue(value);
-            qDebug() << "Setting channel via UUID" << channelName;
-            break;
-        }
-        else if (m_widgets[i]->getChannelName() == channelName) {
-            m_widgets[i]->setValue(value);
-        }
-        if (m_widgets[i]->getChannel2Name() == channelName) {
-            m_widgets[i]->setValue2(value);
-        }
-
+    if (m_widgetsPending) {
+        storePendingValue(channelName, value);
+        widgetsMutex.unlock();
+        return;
+    }
+    QVector<QuteWidget *> widgets = widgetsForChannel(channelName);
+    QVector<QuteWidget *> widgets2 = widgetsForChannel2(channelName);
+    m_indexLock.lockForRead();
+    QuteWidget *uuidWidget = m_uuidIndex.value(channelName, nullptr);
+    m_indexLock.unlock();
+    foreach (QuteWidget *widget, widgets) {
+        widget->setValue(value);
+    }
+    foreach (QuteWidget *widget, widgets2) {
+        widget->setValue2(value);
+    }
+    if (uuidWidget != nullptr && !widgets.contains(uuidWidget)) {
+        uuidWidget->setValue(value);
+        qDebug() << "Setting channel via UUID" << channelName;
     }
     widgetsMutex.unlock();
 }
@@ -515,6 +762,7 @@ void WidgetLayout::setValue(QString channelName, double value)
 
 void WidgetLayout::setOuterGeometry(QRect r)
 {
+    ensurePanelParsed();
     if (!r.isValid()) {
         r = this->geometry();
         m_posx = r.x();
@@ -539,17 +787,14 @@ void WidgetLayout::setOuterGeometry(QRect r)
 void WidgetLayout::setValue(QString channelName, QString value)
 {
     widgetsMutex.lock();
-    for (int i = 0; i < m_widgets.size(); i++) {
-        if (m_widgets[i]->getChannelName() == channelName) {
-            m_widgets[i]->setValue(value);
-        }
-        if (m_widgets[i]->getUuid() == channelName) {
-            m_widgets[i]->setValue(value);
-            break;
-        }
-        //     if (m_widgets[i]->getChannel2Name() == channelName) {
-        //       m_widgets[i]->setValue2(value);
-        //     }
+    if (m_widgetsPending) {
+        storePendingValue(channelName, value);
+        widgetsMutex.unlock();
+        return;
+    }
+    QVector<QuteWidget *> widgets = widgetsForId(channelName);
+    foreach (QuteWidget *widget, widgets) {
+        widget->setValue(value);
     }
     widgetsMutex.unlock();
 }
@@ -577,34 +822,170 @@ void WidgetLayout::setValue(int index, QString value)
 QString WidgetLayout::getStringForChannel(QString channelName, bool *modified)
 {
     (void) modified;
-    for (int i = 0; i < m_activeWidgets ; i++) {
-        if (m_widgets[i]->getChannelName() == channelName) {
-            QString value = m_widgets[i]->getStringValue();
-            return value;
-        } else if (m_widgets[i]->getUuid() == channelName) {
-            QString value = m_widgets[i]->getStringValue();
-            return value;
-        }
+    QString value;
+    m_indexLock.lockForRead();
+    QuteWidget *widget = firstActive(m_channelIndex.value(channelName));
+    if (widget == nullptr) {
+        widget = firstActive(QVector<QuteWidget *>() << m_uuidIndex.value(channelName, nullptr));
+    }
+    if (widget != nullptr) {
+        value = widget->getStringValue();
+    } else {
+        value = m_pendingStrings.value(channelName); // Widgets not created yet
     }
-    return QString();
+    m_indexLock.unlock();
+    return value;
 }
 
 double WidgetLayout::getValueForChannel(QString channelName, bool *modified, double notfound)
 {
     (void) modified;
-    for (int i = 0; i < m_activeWidgets ; i++) {
-        if (m_widgets[i]->getChannelName() == channelName) {
-            double value = m_widgets[i]->getValue();
-            return value;
-        } else if (m_widgets[i]->getChannel2Name() == channelName) {
-            double value = m_widgets[i]->getValue2();
-            return value;
-        } else if (m_widgets[i]->getUuid() == channelName) {
-            double value = m_widgets[i]->getValue();
-            return value;
+    double value = notfound;
+    m_indexLock.lockForRead();
+    QuteWidget *widget = firstActive(m_channelIndex.value(channelName));
+    if (widget != nullptr) {
+        value = widget->getValue();
+    } else if ((widget = firstActive(m_channel2Index.value(channelName))) != nullptr) {
+        value = widget->getValue2();
+    } else {
+        widget = firstActive(QVector<QuteWidget *>() << m_uuidIndex.value(channelName, nullptr));
+        if (widget != nullptr) {
+            value = widget->getValue();
+        } else {
+            value = m_pendingValues.value(channelName, notfound); // Widgets not created yet
+        }
+    }
+    m_indexLock.unlock();
+    return value;
+}
+
+QuteWidget *WidgetLayout::firstActive(const QVector<QuteWidget *> &widgets)
+{
+    // Only the first m_activeWidgets widgets can be read by the value
+    // callbacks (e.g. none while pasting, the ones before a widget being
+    // deleted). Usually they all are, and no search is needed.
+    int active = m_activeWidgets;
+    foreach (QuteWidget *widget, widgets) {
+        if (widget == nullptr)
+            continue;
+        if (active >= m_widgets.size())
+            return widget;
+        int index = m_widgets.indexOf(widget);
+        if (index >= 0 && index < active)
+            return widget;
+    }
+    return nullptr;
+}
+
+QVector<QuteWidget *> WidgetLayout::widgetsForChannel(const QString &channel)
+{
+    QReadLocker locker(&m_indexLock);
+    return m_channelIndex.value(channel);
+}
+
+QVector<QuteWidget *> WidgetLayout::widgetsForChannel2(const QString &channel)
+{
+    QReadLocker locker(&m_indexLock);
+    return m_channel2Index.value(channel);
+}
+
+QVector<QuteWidget *> WidgetLayout::widgetsForId(const QString &widgetid)
+{
+    QReadLocker locker(&m_indexLock);
+    QVector<QuteWidget *> widgets = m_channelIndex.value(widgetid);
+    QuteWidget *widget = m_uuidIndex.value(widgetid, nullptr);
+    if (widget != nullptr && !widgets.contains(widget)) {
+        widgets.prepend(widget);
+    }
+    return widgets;
+}
+
+// Position of a _Mouse* channel in the order of getMouseValues()
+static int mouseChannelIndex(const QString &channel)
+{
+    static const char *names[] = {"_MouseX", "_MouseY", "_MouseRelX", "_MouseRelY",
+                                  "_MouseBut1", "_MouseBut2"};
+    if (!channel.startsWith("_Mouse")) {
+        return -1;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (channel == QLatin1String(names[i])) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void WidgetLayout::indexWidget(QuteWidget *widget)
+{
+    QWriteLocker locker(&m_indexLock);
+    WidgetKeys keys;
+    keys.channel = widget->getChannelName();
+    keys.channel2 = widget->getChannel2Name();
+    keys.uuid = widget->getUuid();
+    if (!keys.channel.isEmpty()) {
+        m_channelIndex[keys.channel].append(widget);
+    }
+    if (!keys.channel2.isEmpty()) {
+        m_channel2Index[keys.channel2].append(widget);
+    }
+    if (!keys.uuid.isEmpty()) {
+        m_uuidIndex.insert(keys.uuid, widget);
+    }
+    m_indexedKeys.insert(widget, keys);
+    MouseBinding binding;
+    binding.widget = widget;
+    binding.value = mouseChannelIndex(keys.channel);
+    binding.value2 = mouseChannelIndex(keys.channel2);
+    if (binding.value >= 0 || binding.value2 >= 0) {
+        m_mouseBindings.append(binding);
+        m_mouseValuesStale = true;
+    }
+}
+
+void WidgetLayout::unindexWidget(QuteWidget *widget)
+{
+    QWriteLocker locker(&m_indexLock);
+    removeFromIndex(widget);
+}
+
+void WidgetLayout::removeFromIndex(QuteWidget *widget)
+{
+    QHash<QuteWidget *, WidgetKeys>::iterator it = m_indexedKeys.find(widget);
+    if (it == m_indexedKeys.end()) {
+        return;
+    }
+    const WidgetKeys &keys = it.value();
+    if (!keys.channel.isEmpty()) {
+        QVector<QuteWidget *> &list = m_channelIndex[keys.channel];
+        list.removeAll(widget);
+        if (list.isEmpty())
+            m_channelIndex.remove(keys.channel);
+    }
+    if (!keys.channel2.isEmpty()) {
+        QVector<QuteWidget *> &list = m_channel2Index[keys.channel2];
+        list.removeAll(widget);
+        if (list.isEmpty())
+            m_channel2Index.remove(keys.channel2);
+    }
+    if (m_uuidIndex.value(keys.uuid, nullptr) == widget) {
+        m_uuidIndex.remove(keys.uuid);
+    }
+    m_indexedKeys.erase(it);
+    for (int i = m_mouseBindings.size() - 1; i >= 0; i--) {
+        if (m_mouseBindings[i].widget == widget) {
+            m_mouseBindings.remove(i);
         }
     }
-    return notfound;
+}
+
+void WidgetLayout::reindexWidget(QuteWidget *widget)
+{
+    if (!m_indexedKeys.contains(widget)) {
+        return; // Not registered yet, it is indexed on registration
+    }
+    unindexWidget(widget);
+    indexWidget(widget);
 }
 
 void WidgetLayout::getMouseValues(QVector<double> *values)
@@ -659,21 +1040,20 @@ int WidgetLayout::getMouseBut2()
 
 void WidgetLayout::setWidgetProperty(QString widgetid, QString property, QVariant value)
 {
-    for (int i = 0; i < m_widgets.size(); i++) {
-        if ( (m_widgets[i]->getUuid() == widgetid) || (m_widgets[i]->getChannelName() == widgetid) ) {
-            m_widgets[i]->setProperty(property.toLocal8Bit(), value);
-            m_widgets[i]->applyInternalProperties();
-            widgetChanged();
-        }
+    ensureWidgets();
+    foreach (QuteWidget *widget, widgetsForId(widgetid)) {
+        widget->setProperty(property.toLocal8Bit(), value);
+        widget->applyInternalProperties();
+        widgetChanged();
     }
 }
 
 QVariant WidgetLayout::getWidgetProperty(QString widgetid, QString property)
 {
-    for (int i = 0; i < m_widgets.size(); i++) {
-        if ( (m_widgets[i]->getUuid() == widgetid) || (m_widgets[i]->getChannelName() == widgetid) ) {
-            return m_widgets[i]->property(property.toLocal8Bit());
-        }
+    ensureWidgets();
+    QVector<QuteWidget *> widgets = widgetsForId(widgetid);
+    if (!widgets.isEmpty()) {
+        return widgets.first()->property(property.toLocal8Bit());
     }
     return QVariant();
 }
@@ -925,16 +1305,9 @@ int WidgetLayout::newXmlWidget(QDomNode mainnode, bool offset, bool newId)
 
 bool WidgetLayout::uuidFree(QString uuid)
 {
-    bool isFree = true; // TODO need to check against uuid for widget panels and widget groups
-    widgetsMutex.lock();
-    for (int i = 0; i < m_widgets.size(); i++) {
-        if (m_widgets[i]->getUuid() == uuid) {
-            isFree = false;
-            break;
-        }
-    }
-    widgetsMutex.unlock();
-    return isFree;
+    // TODO need to check against uuid for widget panels and widget groups
+    QReadLocker locker(&m_indexLock);
+    return !m_uuidIndex.contains(uuid);
 }
 
 QString WidgetLayout::newMacWidget(QString widgetLine, bool offset)
@@ -1027,7 +1400,15 @@ void WidgetLayout::registerWidget(QuteWidget * widget)
             this, SIGNAL(showMidiLearn(QuteWidget *)));
     connect(widget, SIGNAL(addChn_kSignal(QString)),
             this, SIGNAL(addChn_kSignal(QString)) );
+    connect(widget, SIGNAL(channelsChanged(QuteWidget *)),
+            this, SLOT(reindexWidget(QuteWidget *)));
     m_widgets.append(widget);
+    indexWidget(widget);
+    widget->setDirtyList(&m_dirtyWidgets);
+    widget->setValueChannels(&valueChannels);
+    if (widget->m_valueChanged || widget->m_value2Changed) {
+        m_dirtyWidgets.push(widget);
+    }
     //  qDebug() << "WidgetLayout::registerWidget " << m_widgets.size() << widget;
     if (m_editMode) {
         createEditFrame(widget);
@@ -1042,6 +1423,7 @@ void WidgetLayout::registerWidget(QuteWidget * widget)
 
 QString WidgetLayout::getMidiControllerInstrument()
 {
+    ensureWidgets();
 	// returns full Csound instrument to pass CC values to channels
 	// and/or start events (if eventButton)
 	if (registeredControllers.isEmpty()) {
@@ -1160,6 +1542,7 @@ void WidgetLayout::flush()
 void WidgetLayout::engineStopped()
 {
     flushGraphBuffer();
+    QDEBUG << "Curves use" << curveMemoryUsage() << "bytes";
 }
 
 void WidgetLayout::showWidgetTooltips(bool show)
@@ -1284,24 +1667,20 @@ void WidgetLayout::appendCurve(WINDAT *windat)
     // Csound itself deletes the WINDAT structures, that's why we retain a copy of
     // the data for when Csound stops
     // It would be nice if Csound used a single windat for every f-table, but it reuses them...
-    //  for (int i = 0; i < curves.size(); i++) {
-    //    // Check if windat is already handled by one of the existing curves
-    //    if (windat == curves[i]->getOriginal()) {
-    //      return;
-    //    }
-    //  }
-    for (int i = 0; i < curves.size(); i++) {
-        // Check if caption is already present to replace curve rather than create a new one.
-        if (curves[i]->get_caption() == windat->caption) {
-            windat->windid = (uintptr_t) curves[i];
-            return;
-        }
+    windat->caption[CAPSIZE - 1] = 0; // Just in case...
+    QString caption(windat->caption);
+    QMutexLocker locker(&m_curveLock);
+    // Check if caption is already present to replace curve rather than create a new one.
+    Curve *curve = m_curvesByCaption.value(caption, nullptr);
+    if (curve != nullptr) {
+        windat->windid = (uintptr_t) curve;
+        return;
     }
-    if (curves.size() > QCS_CURVE_BUFFER_MAX) {
+    if (m_curveIds.size() >= QCS_CURVE_BUFFER_MAX) {
         qDebug() << "WidgetLayout::appendCurve curve size exceeded. Curve discarded!";
+        windat->windid = 0;
         return;
     }
-    windat->caption[CAPSIZE - 1] = 0; // Just in case...
     Polarity polarity;
     switch (windat->polarity) {
     case NEGPOL:
@@ -1316,41 +1695,83 @@ void WidgetLayout::appendCurve(WINDAT *windat)
     default:
         polarity = POLARITY_NOPOL;
     }
-    int indexInBuffer = -1;
-    //This is not working... makes fft graphs ge ignored...
-    //  for (int i = 0; i < newCurveBuffer.size(); i++) {
-    //    if (strcmp(newCurveBuffer[i]->getOriginal()->caption,windat->caption) && strlen(newCurveBuffer[i]->getOriginal()->caption) > 0) {
-    //      indexInBuffer = i;
-    //      break;
-    //    }
-    //  }
-    if (indexInBuffer < 0) {
-        auto curve = new Curve(windat->fdata,
-                               (size_t)windat->npts,
-                               windat->caption,
-                               polarity,
-                               windat->max,
-                               windat->min,
-                               windat->absmax,
-                               windat->oabsmax,
-                               windat->danflag,
-                               windat);  //FIXME delete these when starting a new run
-        windat->windid = (uintptr_t) curve;
-        newCurveBuffer.append(curve);
-        // qDebug() << "WidgetLayout::appendCurve " << curve << "__--__" << windat;
+    curve = takePooledCurve((size_t)windat->npts);
+    if (curve != nullptr) {
+        curve->reset(windat->fdata, (size_t)windat->npts, caption, polarity,
+                     windat->max, windat->min, windat->absmax, windat->oabsmax,
+                     windat->danflag, windat);
+    }
+    else {
+        curve = new Curve(windat->fdata,
+                          (size_t)windat->npts,
+                          caption,
+                          polarity,
+                          windat->max,
+                          windat->min,
+                          windat->absmax,
+                          windat->oabsmax,
+                          windat->danflag,
+                          windat);
+    }
+    windat->windid = (uintptr_t) curve;
+    m_curvesByCaption.insert(caption, curve);
+    m_curveIds.insert((uintptr_t) curve);
+    newCurveBuffer.append(curve);
+    // qDebug() << "WidgetLayout::appendCurve " << curve << "__--__" << windat;
+}
+
+Curve *WidgetLayout::takePooledCurve(size_t size)
+{
+    // Smallest pooled curve that fits. m_curveLock must be held.
+    int best = -1;
+    for (int i = 0; i < m_curvePool.size(); i++) {
+        size_t capacity = m_curvePool[i]->capacity();
+        if (capacity >= size && (best < 0 || capacity < m_curvePool[best]->capacity())) {
+            best = i;
+        }
+    }
+    if (best < 0 && !m_curvePool.isEmpty()) {
+        best = 0; // Its buffers grow on reset()
+    }
+    return best < 0 ? nullptr : m_curvePool.takeAt(best);
+}
+
+void WidgetLayout::recycleCurve(Curve *curve)
+{
+    // The curve must not be shown or queued anymore. m_curveLock must be held.
+    m_curveIds.remove((uintptr_t) curve);
+    if (m_curvesByCaption.value(curve->get_caption(), nullptr) == curve) {
+        m_curvesByCaption.remove(curve->get_caption());
+    }
+    curve->setOriginal(nullptr);
+    if (m_curvePool.size() < QCS_CURVE_POOL_MAX) {
+        m_curvePool.append(curve);
     }
     else {
-        qDebug() << "WidgetLayout::appendCurve reusing curve buffer " << indexInBuffer;
-        newCurveBuffer[indexInBuffer]->set_data(windat->fdata);
-        newCurveBuffer[indexInBuffer]->setOriginal(windat);
+        delete curve;
+    }
+}
+
+qint64 WidgetLayout::curveMemoryUsage()
+{
+    QMutexLocker locker(&m_curveLock);
+    qint64 bytes = 0;
+    foreach (uintptr_t id, m_curveIds) {
+        bytes += ((Curve *) id)->memoryUsage();
     }
+    foreach (Curve *curve, m_curvePool) {
+        bytes += curve->memoryUsage();
+    }
+    return bytes;
 }
 
 void WidgetLayout::killCurve(WINDAT *windat)
 {
     qDebug() << "WidgetLayout::killCurve()";
     Curve *curve = (Curve *) getCurveById(windat->windid);
-    curve->setOriginal(nullptr);
+    if (curve != nullptr) {
+        curve->setOriginal(nullptr);
+    }
 }
 
 void WidgetLayout::newCurve(Curve* curve)
@@ -1384,28 +1805,24 @@ void WidgetLayout::setCurveData(Curve *curve)
 
 uintptr_t WidgetLayout::getCurveById(uintptr_t id)
 {
-    //  qDebug() << "WidgetLayout::getCurveById ";
-    foreach (Curve *thisCurve, curves) {
-        // qDebug() << "WidgetLayout::getCurveById " << (uintptr_t)thisCurve << "id" << id;
-        if ((uintptr_t) thisCurve == id)
-            return (uintptr_t) thisCurve;
-    }
-    return 0;
+    QMutexLocker locker(&m_curveLock);
+    return m_curveIds.contains(id) ? id : 0;
 }
 
 void WidgetLayout::updateCurve(WINDAT *windat)
 {
-    //  qDebug() << "WidgetLayout::updateCurve(WINDAT *windat) " << windat->windid;
-    if (curveUpdateBufferCount+1 < QCS_CURVE_BUFFER_SIZE) {
-        curveUpdateBufferCount++;
-        curveUpdateBuffer[curveUpdateBufferCount] = *windat;
+    // Called from the Csound display callback. The data is copied right away,
+    // as Csound may change it as soon as this returns.
+    Curve *curve = (Curve *) windat->windid;
+    if (curve == nullptr) {
+        return;
     }
+    curve->write(windat);
+    m_dirtyCurves.push(curve);
 }
 
 void WidgetLayout::processUpdateCurve(Curve *curve) {
-    WINDAT *orig = curve->getOriginal();
-    qDebug() << "processUpdateCurve" << orig->npts << orig->caption;
-    this->updateCurve(orig);
+    setCurveData(curve);
 }
 
 
@@ -1443,9 +1860,10 @@ void WidgetLayout::clearGraphs()
     for (int i = 0; i < graphWidgets.size(); i++) {
         graphWidgets[i]->clearCurves();
     }
+    m_dirtyCurves.clear();
+    QMutexLocker curveLocker(&m_curveLock);
     while (curves.size() > 0) {
-        Curve * c = curves.takeFirst();
-        delete c;
+        recycleCurve(curves.takeFirst());
     }
     m_updating = updating;
 }
@@ -1459,11 +1877,13 @@ void WidgetLayout::flushGraphBuffer()
         m_updating = updating;
         return;
     }
+    m_curveLock.lock();
     while (newCurveBuffer.size() > 0) {
         Curve * c = newCurveBuffer.takeFirst();
-        delete c;
+        m_dirtyCurves.remove(c);
+        recycleCurve(c);
     }
-    curveUpdateBufferCount = 0;
+    m_curveLock.unlock();
     layoutMutex.unlock();
     m_updating = updating;
 }
@@ -1489,59 +1909,37 @@ void WidgetLayout::refreshWidgets()
         midiReadCounter = midiReadCounter%QCS_MAX_MIDI_QUEUE;
     }
     QMutexLocker locker(&widgetsMutex);
-    for (int i=0; i < m_widgets.size(); i++) {
-        if (m_widgets[i]->m_valueChanged || m_widgets[i]->m_value2Changed) {
-            m_widgets[i]->refreshWidget();
-        }
-        if (m_trackMouse) {
-            QString ch1name = m_widgets[i]->getChannelName();
-            if (ch1name.startsWith("_Mouse")) {
-                if (ch1name == "_MouseX") {
-                    m_widgets[i]->setValue(getMouseX());
-                }
-                else if (ch1name == "_MouseY") {
-                    m_widgets[i]->setValue(getMouseY());
-                }
-                else if (ch1name == "_MouseRelX") {
-                    m_widgets[i]->setValue(getMouseRelX());
-                }
-                else if (ch1name == "_MouseRelY") {
-                    m_widgets[i]->setValue(getMouseRelY());
-                }
-                else if (ch1name == "_MouseBut1") {
-                    m_widgets[i]->setValue(getMouseBut1());
-                }
-                else if (ch1name == "_MouseBut2") {
-                    m_widgets[i]->setValue(getMouseBut2());
-                }
-            }
-            QString ch2name = m_widgets[i]->getChannel2Name();
-            if (ch2name.startsWith("_Mouse")) {
-                if (ch2name == "_MouseX") {
-                    m_widgets[i]->setValue2(getMouseX());
-                }
-                else if (ch2name == "_MouseY") {
-                    m_widgets[i]->setValue2(getMouseY());
-                }
-                else if (ch2name == "_MouseRelX") {
-                    m_widgets[i]->setValue2(getMouseRelX());
-                }
-                else if (ch2name == "_MouseRelY") {
-                    m_widgets[i]->setValue2(getMouseRelY());
-                }
-                else if (ch2name == "_MouseBut1") {
-                    m_widgets[i]->setValue2(getMouseBut1());
-                }
-                else if (ch2name == "_MouseBut2") {
-                    m_widgets[i]->setValue2(getMouseBut2());
+    if (m_trackMouse) {
+        m_indexLock.lockForRead();
+        if (!m_mouseBindings.isEmpty()) {
+            int values[6] = {getMouseX(), getMouseY(), getMouseRelX(), getMouseRelY(),
+                             getMouseBut1(), getMouseBut2()};
+            if (m_mouseValuesStale || memcmp(values, m_mouseValues, sizeof(values)) != 0) {
+                foreach (const MouseBinding &binding, m_mouseBindings) {
+                    if (binding.value >= 0) {
+                        binding.widget->setValue(values[binding.value]);
+                    }
+                    if (binding.value2 >= 0) {
+                        binding.widget->setValue2(values[binding.value2]);
+                    }
                 }
+                memcpy(m_mouseValues, values, sizeof(values));
+                m_mouseValuesStale = false;
             }
         }
+        m_indexLock.unlock();
     }
+    // Only widgets that got a new value since the last refresh are queued
+    m_dirtyWidgets.drain([](QuteWidget *widget) {
+        if (widget->m_valueChanged || widget->m_value2Changed) {
+            widget->refreshWidget();
+        }
+    });
 }
 
 QString WidgetLayout::getCsladspaLines()
 {
+    ensureWidgets();
     QString text = "";
     int unsupported = 0;
     widgetsMutex.lock();
@@ -1561,6 +1959,7 @@ QString WidgetLayout::getCsladspaLines()
 
 QString WidgetLayout::getQml()
 {
+    ensureWidgets();
     QString qml = "import QtQuick 2.0\nimport QtQuick.Controls 2.0 // NB! Requires Qt 5.7 or later. Rewrite with QtQuick.Controls 1.X if using older Qt versions \n\n";
     QString s2 = QString(R"()");
     qml += "Rectangle {\n";
@@ -1625,6 +2024,7 @@ QString WidgetLayout::getQml()
 
 QString WidgetLayout::getCabbageWidgets()
 {
+    ensureWidgets();
     QString title = windowTitle();
     QString text = "form caption(\"" + title  + "\"),";
     //text += "size(" + QString::number(m_w+20) + "," + QString::number(m_h+20) +")\n"; // m_w and m_h not returning correct results always
@@ -1727,6 +2127,7 @@ void WidgetLayout::deselectAll()
 
 void WidgetLayout::selectAll()
 {
+    ensureWidgets();
     for (int i = 0; i< editWidgets.size(); i++) {
         editWidgets[i]->select();
     }
@@ -1789,6 +2190,7 @@ void WidgetLayout::mouseMoveEventParent(QMouseEvent *event)
 
 QSize WidgetLayout::getUsedSize()
 {
+    ensureWidgets();
     int width = 30, height = 30;
     for (int i = 0; i< m_widgets.size(); i++) {
         if (m_widgets[i]->x() + m_widgets[i]->width() > width) {
@@ -1816,6 +2218,7 @@ void WidgetLayout::adjustLayoutSize()
 
 void WidgetLayout::adjustWidgetSize()
 {
+    ensurePanelParsed();
     if (!m_contained) {
         this->resize(m_w, m_h);
         this->move(m_posx, m_posy);
@@ -1844,6 +2247,7 @@ void WidgetLayout::selectionChanged(QRect selection)
 
 QString WidgetLayout::createNewSlider(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -1870,6 +2274,7 @@ QString WidgetLayout::createNewSlider(int x, int y, QString channel)
 
 QString WidgetLayout::createNewLabel(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -1893,6 +2298,7 @@ QString WidgetLayout::createNewLabel(int x, int y, QString channel)
 
 QString WidgetLayout::createNewDisplay(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -1916,6 +2322,7 @@ QString WidgetLayout::createNewDisplay(int x, int y, QString channel)
 
 QString WidgetLayout::createNewScrollNumber(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -1939,6 +2346,7 @@ QString WidgetLayout::createNewScrollNumber(int x, int y, QString channel)
 
 QString WidgetLayout::createNewLineEdit(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -1968,6 +2376,7 @@ QString WidgetLayout::createNewLineEdit(int x, int y, QString channel)
 
 QString WidgetLayout::createNewSpinBox(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -1991,6 +2400,7 @@ QString WidgetLayout::createNewSpinBox(int x, int y, QString channel)
 
 QString WidgetLayout::createNewButton(int x, int y, QString channel)
 {
+    ensureWidgets();
     qDebug() << "WidgetLayout::createNewButton";
     QString uuid;
     bool dialog;
@@ -2016,6 +2426,7 @@ QString WidgetLayout::createNewButton(int x, int y, QString channel)
 
 QString WidgetLayout::createNewKnob(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -2038,6 +2449,7 @@ QString WidgetLayout::createNewKnob(int x, int y, QString channel)
 
 QString WidgetLayout::createNewCheckBox(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -2060,6 +2472,7 @@ QString WidgetLayout::createNewCheckBox(int x, int y, QString channel)
 
 QString WidgetLayout::createNewMenu(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -2082,6 +2495,7 @@ QString WidgetLayout::createNewMenu(int x, int y, QString channel)
 
 QString WidgetLayout::createNewMeter(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -2105,6 +2519,7 @@ QString WidgetLayout::createNewMeter(int x, int y, QString channel)
 
 QString WidgetLayout::createNewConsole(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -2127,6 +2542,7 @@ QString WidgetLayout::createNewConsole(int x, int y, QString channel)
 
 QString WidgetLayout::createNewGraph(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -2149,6 +2565,7 @@ QString WidgetLayout::createNewGraph(int x, int y, QString channel)
 
 QString WidgetLayout::createNewTableDisplay(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -2172,6 +2589,7 @@ QString WidgetLayout::createNewTableDisplay(int x, int y, QString channel)
 
 QString WidgetLayout::createNewScope(int x, int y, QString channel)
 {
+    ensureWidgets();
     QString uuid;
     bool dialog;
     int posx = x >= 0 ? x : currentPosition.x();
@@ -2204,12 +2622,33 @@ void WidgetLayout::clearWidgets()
 void WidgetLayout::clearWidgetLayout()
 {
     //   qDebug("WidgetLayout::clearWidgetLayout()");
+    // Forget any panel still being parsed or waiting for its widgets
+    m_panelGeneration++;
+    m_panelParsePending = false;
+    m_widgetsPending = false;
+    m_pendingPanel = WidgetPanelDescription();
+    m_pendingXml.clear();
     widgetsMutex.lock();
     m_activeWidgets = 0;
+    m_indexLock.lockForWrite();
+    m_channelIndex.clear();
+    m_channel2Index.clear();
+    m_uuidIndex.clear();
+    m_indexedKeys.clear();
+    m_pendingValues.clear();
+    m_pendingStrings.clear();
+    m_pendingOutputs.clear();
+    m_pendingStringOutputs.clear();
+    m_mouseBindings.clear();
+    // Unlinked before the list is emptied, so nothing can queue them again
     foreach (QuteWidget *widget, m_widgets) {
-        delete widget;
+        widget->setDirtyList(nullptr);
+        widget->setValueChannels(nullptr);
     }
+    m_dirtyWidgets.clear();
+    qDeleteAll(m_widgets);
     m_widgets.clear();
+    m_indexLock.unlock();
     foreach (FrameWidget *widget, editWidgets) {
         //     qDebug("WidgetLayout::clearWidgetLayout() removed editWidget");
         delete widget;
@@ -2223,7 +2662,9 @@ void WidgetLayout::clearWidgetLayout()
 
 
 QStringList WidgetLayout::getUuids()
-{   QStringList uuids = QStringList();
+{
+    ensureWidgets();
+    QStringList uuids = QStringList();
     for (int i=0; i<m_widgets.size(); i++) {
         uuids.append( m_widgets[i]->getUuid() );
     }
@@ -2232,33 +2673,30 @@ QStringList WidgetLayout::getUuids()
 
 QStringList WidgetLayout::listProperties(QString widgetid)
 {
+    ensureWidgets();
 
     QStringList prop_names = QStringList();
-    for (int i = 0; i < m_widgets.size(); i++) {
-        if ( (m_widgets[i]->getUuid() == widgetid) || (m_widgets[i]->getChannelName() == widgetid) ) {
-            QList<QByteArray> props= m_widgets[i]->dynamicPropertyNames();
-
-            foreach (QByteArray prop, props) {
-                prop_names << QString(prop);
-            }
-            return prop_names;
+    QVector<QuteWidget *> widgets = widgetsForId(widgetid);
+    if (!widgets.isEmpty()) {
+        QList<QByteArray> props= widgets.first()->dynamicPropertyNames();
 
+        foreach (QByteArray prop, props) {
+            prop_names << QString(prop);
         }
     }
-    return QStringList();
-
+    return prop_names;
 }
 
 
 bool WidgetLayout::destroyWidget(QString widgetid)
 {
-    for (int i = 0; i < m_widgets.size(); i++) {
-        if ( (m_widgets[i]->getUuid() == widgetid) || (m_widgets[i]->getChannelName() == widgetid) ) {
-            // is it necessary to use widgetsMutex.lock(); / unlock?
-            deleteWidget(m_widgets[i]);
-            markHistory();  // is it necessary here? probably yes, possible to undo
-            return true;
-        }
+    ensureWidgets();
+    QVector<QuteWidget *> widgets = widgetsForId(widgetid);
+    if (!widgets.isEmpty()) {
+        // is it necessary to use widgetsMutex.lock(); / unlock?
+        deleteWidget(widgets.first());
+        markHistory();  // is it necessary here? probably yes, possible to undo
+        return true;
     }
 
     return false;
@@ -2758,6 +3196,7 @@ void WidgetLayout::keyReleaseEvent(QKeyEvent *event)
 void WidgetLayout::widgetChanged(QuteWidget* widget)
 {
     if (widget != nullptr) {
+        m_historyTouched.insert(widget->getUuid());
         //    widgetsMutex.lock();
         int index = m_widgets.indexOf(widget);
         if (index >= 0 && editWidgets.size() > index) {
@@ -3377,9 +3816,12 @@ QString WidgetLayout::createDummy(int x, int y, int width, int height, QString w
     widget->setProperty("QCS_width",width);
     widget->setProperty("QCS_height",height);
     connect(widget, SIGNAL(propertiesAccepted()), this, SLOT(markHistory()));
+    connect(widget, SIGNAL(channelsChanged(QuteWidget *)),
+            this, SLOT(reindexWidget(QuteWidget *)));
     widget->show();
     widgetsMutex.lock();
     m_widgets.append(widget);
+    indexWidget(widget);
     if (m_editMode) {
         createEditFrame(widget);
         editWidgets.last()->select();
@@ -3494,9 +3936,14 @@ void WidgetLayout::setMouseOffset(int x, int y)
 
 void WidgetLayout::clearHistory()
 {
+    // The next markHistory() sets the starting point
     m_history.clear();
-    m_history << "";
     m_historyIndex = 0;
+    m_historyBytes = 0;
+    m_historyValid = false;
+    m_historyState.clear();
+    m_historyOrder.clear();
+    m_historyTouched.clear();
 }
 
 int WidgetLayout::getPresetIndex(int number)
@@ -3566,6 +4013,7 @@ void WidgetLayout::loadPresetFromItem(QTreeWidgetItem * item, int column)
 
 void WidgetLayout::loadPreset(int num)
 {
+    ensureWidgets();
     int index = getPresetIndex(num);
     loadPresetFromIndex(index);
 }
@@ -3592,12 +4040,7 @@ void WidgetLayout::loadPresetFromIndex(int index)
                 QString channel = m_widgets[j]->getChannelName();
                 // Store the value in the changes buffer to read from chnget
                 if (!channel.isEmpty()) {
-                    valueMutex.lock();
-                    if(newValues.contains(channel))
-                        newValues[channel] = p.getValue(i);
-                    else
-                        newValues.insert(channel, p.getValue(i));
-                    valueMutex.unlock();
+                    storeNewValue(channel, p.getValue(i));
                 }
             }
             if (mode & 2) {
@@ -3605,12 +4048,7 @@ void WidgetLayout::loadPresetFromIndex(int index)
                 QString channel = m_widgets[j]->getChannelName();
                 // store the value in the changes buffer to read from chnget
                 if (!channel.isEmpty()) {
-                    valueMutex.lock();
-                    if(newValues.contains(channel))
-                        newValues[channel] = p.getValue2(i);
-                    else
-                        newValues.insert(channel, p.getValue2(i));
-                    valueMutex.unlock();
+                    storeNewValue(channel, p.getValue2(i));
                 }
             }
             if (mode & 4) {
@@ -3715,6 +4153,7 @@ void WidgetLayout::savePreset()
 
 void WidgetLayout::savePreset(int num, QString name)
 {
+    ensureWidgets();
     int index = getPresetIndex(num);
     WidgetPreset p;
     p.setName(name);
@@ -3805,6 +4244,7 @@ QColor WidgetLayout::getColorFromElement(QDomElement elem)
 
 void WidgetLayout::copy()
 {
+    ensureWidgets();
     qDebug() << "WidgetLayout::copy()";
     QString text;
     if (m_editMode) {
@@ -3831,6 +4271,7 @@ void WidgetLayout::copy()
 
 void WidgetLayout::cut()
 {
+    ensureWidgets();
     qDebug() << "WidgetLayout::cut()";
     if (m_editMode) {
         WidgetLayout::copy();
@@ -3849,6 +4290,7 @@ void WidgetLayout::cut()
 
 void WidgetLayout::paste()
 {
+    ensureWidgets();
     qDebug() << "WidgetLayout::paste()";
     if (m_editMode) {
         deselectAll();
@@ -3945,22 +4387,170 @@ void WidgetLayout::createEditFrame(QuteWidget* widget)
 
 void WidgetLayout::markHistory()
 {
-    QString text = m_xmlFormat ? getWidgetsText() : getMacWidgetsText();
-    if (m_history.isEmpty()) {
-        m_history << "";
-        m_historyIndex = 0;
+    if (m_panelParsePending || m_widgetsPending) {
+        // Nothing can change before the widgets exist, mark when they are created
+        m_historyMarkPending = true;
+        return;
+    }
+    m_historyMarkPending = false;
+    QString panel = getPanelPropertiesText();
+    QStringList order;
+    QHash<QString, QString> state;
+    QSet<QString> serialised;
+    widgetsMutex.lock();
+    order.reserve(m_widgets.size());
+    state.reserve(m_widgets.size());
+    for (int i = 0; i < m_widgets.size(); i++) {
+        QString uuid = m_widgets[i]->getUuid();
+        order << uuid;
+        // Edits only reach the selected widgets, the ones that reported a
+        // change and new ones. The others keep their last marked xml.
+        if (!m_historyValid || !m_historyState.contains(uuid)
+                || m_historyTouched.contains(uuid)
+                || (i < editWidgets.size() && editWidgets[i]->isSelected())) {
+            state.insert(uuid, m_widgets[i]->getWidgetXmlText());
+            serialised.insert(uuid);
+        }
+        else {
+            state.insert(uuid, m_historyState.value(uuid));
+        }
+    }
+    widgetsMutex.unlock();
+    m_historyTouched.clear();
+    if (m_historyValid) {
+        WidgetHistoryStep step;
+        if (panel != m_historyPanel) {
+            step.panelBefore = m_historyPanel;
+            step.panelAfter = panel;
+        }
+        QHash<QString, int> newIndexes;
+        newIndexes.reserve(order.size());
+        for (int i = 0; i < order.size(); i++) {
+            newIndexes.insert(order[i], i);
+        }
+        for (int i = 0; i < m_historyOrder.size(); i++) { // Changed or deleted
+            int newIndex = newIndexes.value(m_historyOrder[i], -1);
+            if (newIndex >= 0 && !serialised.contains(m_historyOrder[i])) {
+                continue;
+            }
+            WidgetHistoryChange change;
+            change.uuid = m_historyOrder[i];
+            change.oldIndex = i;
+            change.newIndex = newIndex;
+            change.before = m_historyState.value(change.uuid);
+            change.after = state.value(change.uuid);
+            if (change.before != change.after) {
+                step.changes.append(change);
+            }
+        }
+        for (int i = 0; i < order.size(); i++) { // Created
+            if (!m_historyState.contains(order[i])) {
+                WidgetHistoryChange change;
+                change.uuid = order[i];
+                change.oldIndex = -1;
+                change.newIndex = i;
+                change.after = state.value(order[i]);
+                step.changes.append(change);
+            }
+        }
+        if (!step.changes.isEmpty() || !step.panelAfter.isEmpty()) {
+            pushHistoryStep(step);
+        }
     }
-    if (m_history[m_historyIndex] != text) {
-        if (! m_history[m_historyIndex].isEmpty())
-            m_historyIndex++;
-        if (m_historyIndex >= QCS_MAX_UNDO) {
-            m_history.pop_front();
-            (m_historyIndex)--;
+    m_historyValid = true;
+    m_historyPanel = panel;
+    m_historyOrder = order;
+    m_historyState = state;
+}
+
+void WidgetLayout::pushHistoryStep(WidgetHistoryStep &step)
+{
+    step.bytes = (step.panelBefore.size() + step.panelAfter.size()) * sizeof(QChar);
+    foreach (const WidgetHistoryChange &change, step.changes) {
+        step.bytes += (change.uuid.size() + change.before.size() + change.after.size())
+                * sizeof(QChar);
+    }
+    while (m_history.size() > m_historyIndex) { // Redo steps are lost
+        m_historyBytes -= m_history.last().bytes;
+        m_history.removeLast();
+    }
+    m_history.append(step);
+    m_historyIndex++;
+    m_historyBytes += step.bytes;
+    while (m_historyBytes > QCS_MAX_UNDO_BYTES && m_history.size() > 1) {
+        m_historyBytes -= m_history.first().bytes;
+        m_history.removeFirst();
+        m_historyIndex--;
+    }
+}
+
+// Widgets that change or go away are removed first. The widgets of the
+// target state are then created by increasing position, so the unchanged
+// widgets in between keep their places.
+void WidgetLayout::applyHistoryStep(const WidgetHistoryStep &step, bool undo)
+{
+    QMap<int, QString> restore;
+    foreach (const WidgetHistoryChange &change, step.changes) {
+        const QString &from = undo ? change.after : change.before;
+        const QString &to = undo ? change.before : change.after;
+        if (!from.isEmpty()) {
+            m_indexLock.lockForRead();
+            QuteWidget *widget = m_uuidIndex.value(change.uuid, nullptr);
+            m_indexLock.unlock();
+            if (widget != nullptr) {
+                removeHistoryWidget(widget);
+            }
+            m_historyState.remove(change.uuid);
+        }
+        if (!to.isEmpty()) {
+            restore.insert(undo ? change.oldIndex : change.newIndex, to);
+            m_historyState.insert(change.uuid, to);
+        }
+    }
+    QMap<int, QString>::const_iterator it;
+    for (it = restore.constBegin(); it != restore.constEnd(); ++it) {
+        restoreHistoryWidget(it.value(), it.key());
+    }
+    const QString &panel = undo ? step.panelBefore : step.panelAfter;
+    if (!panel.isEmpty()) {
+        setPanelPropertiesText(panel);
+        m_historyPanel = panel;
+    }
+    widgetsMutex.lock();
+    m_historyOrder.clear();
+    for (int i = 0; i < m_widgets.size(); i++) {
+        m_historyOrder << m_widgets[i]->getUuid();
+    }
+    widgetsMutex.unlock();
+    setModified(true);
+}
+
+void WidgetLayout::removeHistoryWidget(QuteWidget *widget)
+{
+    deleteWidget(widget);
+    unregisterWidgetController(widget);
+    widget->deleteLater();
+}
+
+void WidgetLayout::restoreHistoryWidget(const QString &xml, int index)
+{
+    QDomDocument doc;
+    if (!doc.setContent(xml)) {
+        qDebug() << "WidgetLayout::restoreHistoryWidget error parsing xml";
+        return;
+    }
+    int count = m_widgets.size();
+    newXmlWidget(doc.firstChildElement("bsbObject"));
+    widgetsMutex.lock();
+    int last = m_widgets.size() - 1;
+    if (last == count && index >= 0 && index < last) {
+        m_widgets.move(last, index);
+        if (editWidgets.size() == m_widgets.size()) {
+            editWidgets.move(last, index);
         }
-        if (m_history.size() != m_historyIndex + 1)
-            m_history.resize(m_historyIndex + 1);
-        m_history[m_historyIndex] = text;
+        m_widgets[index]->stackUnder(m_widgets[index + 1]);
     }
+    widgetsMutex.unlock();
 }
 
 void WidgetLayout::deleteWidget(QuteWidget *widget)
@@ -3968,8 +4558,16 @@ void WidgetLayout::deleteWidget(QuteWidget *widget)
     widgetsMutex.lock();
     int index = m_widgets.indexOf(widget);
     m_activeWidgets = index;  // Allow all widgets before this one to be active
+    m_indexLock.lockForWrite();
+    removeFromIndex(widget);
+    // Other threads only change values with widgetsMutex held, so once
+    // unlinked here the widget can't be queued again and may be deleted
+    widget->setDirtyList(nullptr);
+    widget->setValueChannels(nullptr);
+    m_dirtyWidgets.remove(widget);
     widget->close();
     m_widgets.remove(index);
+    m_indexLock.unlock();
     if (!editWidgets.isEmpty()) {
         delete(editWidgets[index]);
         editWidgets.remove(index);
@@ -4003,32 +4601,47 @@ void WidgetLayout::newValue(QPair<QString, double> channelValue)
         path = channelName.mid(idx+1);
         channelName = channelName.left(idx);
     }
-    widgetsMutex.lock();
     if (!channelName.isEmpty()) {
         // Pass the value on to the other widgets
-        for (int i = 0; i < m_widgets.size(); i++){
-            if (m_widgets[i]->getChannelName() == channelName) {
-                if (path.isEmpty()) {
-                    m_widgets[i]->setValue(channelValue.second);
-                }
-                else
-                    m_widgets[i]->widgetMessage(path,channelValue.second);
-            }
-            if (m_widgets[i]->getChannel2Name() == channelValue.first) {
-                m_widgets[i]->setValue2(channelValue.second);
+        widgetsMutex.lock();
+        if (m_widgetsPending && path.isEmpty()) {
+            storePendingValue(channelName, channelValue.second);
+        }
+        QVector<QuteWidget *> widgets = widgetsForChannel(channelName);
+        QVector<QuteWidget *> widgets2 = widgetsForChannel2(channelValue.first);
+        foreach (QuteWidget *widget, widgets) {
+            if (path.isEmpty()) {
+                widget->setValue(channelValue.second);
             }
+            else
+                widget->widgetMessage(path,channelValue.second);
         }
+        foreach (QuteWidget *widget, widgets2) {
+            widget->setValue2(channelValue.second);
+        }
+        widgetsMutex.unlock();
     }
-    widgetsMutex.unlock();
     // Now store the value in the changes buffer to read from chnget
     if (!channelValue.first.isEmpty()) {
-        valueMutex.lock();
-        if(newValues.contains(channelValue.first))
-            newValues[channelValue.first] = channelValue.second;
-        else
-            newValues.insert(channelValue.first, channelValue.second);
-        valueMutex.unlock();
+        storeNewValue(channelValue.first, channelValue.second);
+    }
+}
+
+void WidgetLayout::storeNewValue(const QString &channel, double value)
+{
+    // Also for widgets that send a value without changing their own
+    int valueId = valueChannels.id(channel);
+    if (valueId >= 0) {
+        valueChannels.setInput(valueId, value);
     }
+    int id = inputChannels.id(channel);
+    if (id >= 0) {
+        inputChannels.publish(id, value);
+        return;
+    }
+    valueMutex.lock();
+    newValues.insert(channel, value);
+    valueMutex.unlock();
 }
 
 //FIXME there's no need to go through here coming from the widgets...
@@ -4041,18 +4654,20 @@ void WidgetLayout::newValue(QPair<QString, QString> channelValue)
     }
     QString path = channelValue.first.mid(channelValue.first.indexOf("/") + 1);
     // Send value to a widget if channel matches
-    widgetsMutex.lock();
     if (!channelName.isEmpty()) {
-        for (int i = 0; i < m_widgets.size(); i++){
-            if (m_widgets[i]->getChannelName() != channelName)
-                continue;
+        widgetsMutex.lock();
+        if (m_widgetsPending && path == channelName) {
+            storePendingValue(channelName, channelValue.second);
+        }
+        QVector<QuteWidget *> widgets = widgetsForChannel(channelName);
+        foreach (QuteWidget *widget, widgets) {
             if (path == channelName)
-                m_widgets[i]->setValue(channelValue.second);
+                widget->setValue(channelValue.second);
             else
-                m_widgets[i]->widgetMessage(path,channelValue.second);
+                widget->widgetMessage(path,channelValue.second);
         }
+        widgetsMutex.unlock();
     }
-    widgetsMutex.unlock();
     // Now store the value in the changes buffer to read from chnget
     if (!channelValue.first.isEmpty()) {
         stringValueMutex.lock();
@@ -4066,86 +4681,10 @@ void WidgetLayout::newValue(QPair<QString, QString> channelValue)
 
 void WidgetLayout::processNewValues()
 {
-    // Apply values received
-    //   qDebug("WidgetPanel::processNewValues");
-
-    //  if (closing != 0)
-    //    return;
-    //  QList<QString> channelNames;
-    //  valueMutex.lock();
-    //  channelNames = newValues.keys();
-    //  valueMutex.unlock();
-    //  widgetsMutex.lock();
-    //  foreach(QString name, channelNames) {
-    //    for (int i = 0; i < m_widgets.size(); i++){
-    //      if (m_widgets[i]->getChannelName() == name) {
-    //        m_widgets[i]->setValue(newValues.value(name));
-    //      }
-    //      if (m_widgets[i]->getChannel2Name() == name) {
-    //        m_widgets[i]->setValue2(newValues.value(name));
-    //      }
-    //      if (m_trackMouse) {
-    //        QString ch1name = m_widgets[i]->getChannelName();
-    //        if (ch1name == "_MouseX") {
-    //          m_widgets[i]->setValue(getMouseX());
-    //        }
-    //        else if (ch1name == "_MouseY") {
-    //          m_widgets[i]->setValue(getMouseY());
-    //        }
-    //        else if (ch1name == "_MouseRelX") {
-    //          m_widgets[i]->setValue(getMouseRelX());
-    //        }
-    //        else if (ch1name == "_MouseRelY") {
-    //          m_widgets[i]->setValue(getMouseRelY());
-    //        }
-    //        else if (ch1name == "_MouseBut1") {
-    //          m_widgets[i]->setValue(getMouseBut1());
-    //        }
-    //        else if (ch1name == "_MouseBut2") {
-    //          m_widgets[i]->setValue(getMouseBut2());
-    //        }
-    //        QString ch2name = m_widgets[i]->getChannel2Name();
-    //        if (ch2name == "_MouseX") {
-    //          m_widgets[i]->setValue2(getMouseX());
-    //        }
-    //        else if (ch2name == "_MouseY") {
-    //          m_widgets[i]->setValue2(getMouseY());
-    //        }
-    //        else if (ch2name == "_MouseRelX") {
-    //          m_widgets[i]->setValue2(getMouseRelX());
-    //        }
-    //        else if (ch2name == "_MouseRelY") {
-    //          m_widgets[i]->setValue2(getMouseRelY());
-    //        }
-    //        else if (ch2name == "_MouseBut1") {
-    //          m_widgets[i]->setValue2(getMouseBut1());
-    //        }
-    //        else if (ch2name == "_MouseBut2") {
-    //          m_widgets[i]->setValue2(getMouseBut2());
-    //        }
-    //      }
-    //    }
-    //  }
-    //  widgetsMutex.unlock();
-    //  valueMutex.lock();
-    //  newValues.clear();
-    //  valueMutex.unlock();
-    //  stringValueMutex.lock();
-    //  channelNames = newStringValues.keys();
-    //  // Now set string values
-    //  stringValueMutex.unlock();
-    //  widgetsMutex.lock();
-    //  foreach(QString name, channelNames) {
-    //    for (int i = 0; i < m_widgets.size(); i++){
-    //      if (m_widgets[i]->getChannelName() == name) {
-    //        m_widgets[i]->setValue(newStringValues.value(name));
-    //      }
-    //    }
-    //  }
-    //  widgetsMutex.unlock();
-    //  stringValueMutex.lock();
-    //  newStringValues.clear();
-    //  stringValueMutex.unlock();
+    // Apply values received from outvalue on interned channels
+    valueChannels.drainOutputs([this](int id, MYFLT value) {
+        newValue(QPair<QString, double>(valueChannels.name(id), value));
+    });
 }
 
 void WidgetLayout::queueEvent(QString eventLine)
@@ -4155,6 +4694,7 @@ void WidgetLayout::queueEvent(QString eventLine)
 
 void WidgetLayout::duplicate()
 {
+    ensureWidgets();
     if(!m_editMode)
         return;
     widgetsMutex.lock();
@@ -4188,6 +4728,7 @@ void WidgetLayout::duplicate()
 
 void WidgetLayout::deleteSelected()
 {
+    ensureWidgets();
     widgetsMutex.lock();
     for (int i = editWidgets.size() - 1; i >= 0 ; i--) {
         if (!editWidgets[i]->isSelected())
@@ -4228,77 +4769,74 @@ void WidgetLayout::moveSelected(int horiz, int vert, int grid) {
 
 void WidgetLayout::undo()
 {
-    if(m_historyIndex <= 0)
+    ensureWidgets();
+    if (m_historyIndex <= 0)
         return;
     m_historyIndex--;
-    if (m_xmlFormat)
-        loadXmlWidgets(m_history[m_historyIndex]);
-    else
-        loadMacWidgets(m_history[m_historyIndex]);
+    applyHistoryStep(m_history[m_historyIndex], true);
 }
 
 void WidgetLayout::reloadWidgets() {
-    if(m_historyIndex <= 0)
-        return;
-    loadXmlWidgets(m_history[m_historyIndex]);
+    // Recreates all widgets from their current state
+    loadXmlWidgets(getWidgetsText());
+    ensureWidgets();
 }
 
 void WidgetLayout::redo()
 {
-    if (m_historyIndex >= m_history.size() - 1)
+    ensureWidgets();
+    if (m_historyIndex >= m_history.size())
         return;
+    applyHistoryStep(m_history[m_historyIndex], false);
     m_historyIndex++;
-    if (m_xmlFormat)
-        loadXmlWidgets(m_history[m_historyIndex]);
-    else
-        loadMacWidgets(m_history[m_historyIndex]);
 }
 
 
-void WidgetLayout::updateData()
+bool WidgetLayout::frameVisible()
 {
-    if (closing == 1) {
-        closing = 0;
+    return isVisible() && !window()->isMinimized();
+}
+
+void WidgetLayout::updateFrame()
+{
+    // The update rate of the panel is an upper limit, the scheduler ticks once
+    // per display frame. Half a frame of slack keeps 30 Hz at 60 Hz displays.
+    qint64 period = 1000 / qMax(1, m_updateRate);
+    if (m_lastUpdate.elapsed() + FrameScheduler::instance()->screenInterval() / 2 < period) {
         return;
     }
+    m_lastUpdate.restart();
+    updateData();
+}
 
+void WidgetLayout::updateData()
+{
     if(!m_updating)
         return;
 
+    processNewValues();
     refreshWidgets();
-    int const refresh_rate = m_updateRate;
-    int const msec = 1000 / refresh_rate;
-    if (!layoutMutex.tryLock(1)) {
-        updateTimer.singleShot(msec, this, SLOT(updateData()));
-        return;
-    }
-    while (!newCurveBuffer.isEmpty()) {
-        Curve * curve = newCurveBuffer.takeFirst();
+    if (!layoutMutex.tryLock()) {
+        return; // Curves and scopes are updated on the next frame
+    }
+    m_curveLock.lock();
+    QList<Curve *> createdCurves = newCurveBuffer;
+    newCurveBuffer.clear();
+    m_curveLock.unlock();
+    foreach (Curve *curve, createdCurves) {
         newCurve(curve);  // Register new curve
     }
-    // Check for graph updates after creating new curves
-    while (curveUpdateBufferCount > 0) {
-        WINDAT * curveData = &curveUpdateBuffer[curveUpdateBufferCount--];
-        Curve *curve = (Curve *) getCurveById(curveData->windid);
-        if (curve != nullptr && curveData != nullptr) {
-            curve->set_size(curveData->npts);    // number of points
-            curve->set_data(curveData->fdata);
-            curve->set_caption(curveData->caption);
-            curve->set_max(curveData->max);
-            curve->set_min(curveData->min);
-            curve->set_absmax(curveData->absmax);
-            // Y axis scaling factor
-            // curve->set_y_scale(windat->y_scale);
+    // Check for graph updates after creating new curves. Only the latest
+    // snapshot of each curve is drawn, however many Csound sent.
+    m_dirtyCurves.drain([this](Curve *curve) {
+        if (curve->readSnapshot()) {
             setCurveData(curve);
         }
-        // delete curveData; //FIXME don't do this deleting here...
-    }
+    });
     for (int i = 0; i < scopeWidgets.size(); i++) {
         scopeWidgets[i]->updateData();
     }
     layoutMutex.unlock();
-    closing = 0;
-    updateTimer.singleShot(msec, this, SLOT(updateData()));
 }
 
 void WidgetLayout::widgetSelected(QuteWidget *widget)
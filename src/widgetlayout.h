@@ -24,13 +24,15 @@
 #define WIDGETLAYOUT_H
 
 #include <QtGui>
+#include <QFutureWatcher>
 
-#define QCS_MAX_EVENTS 4096
-#define QCS_CURVE_BUFFER_MAX 4096
+#define QCS_CURVE_BUFFER_MAX 1024 // Curves per layout, further displays are ignored
+#define QCS_CURVE_POOL_MAX 64 // Curves kept after a run to be reused by the next one
 
 #include "qutewidget.h"
 #include "curve.h"
 #include "widgetpreset.h"
+#include "framescheduler.h"
 
 class QuteConsole;
 class QuteGraph;
@@ -51,7 +53,56 @@ public:
 	QuteWidget * widget;
 };
 
-class WidgetLayout : public QWidget
+// A widget of a panel read from xml but not created yet
+struct WidgetDescriptor
+{
+	WidgetDescriptor() : value(0), value2(0) {}
+	QString type;
+	QString uuid;
+	QString channel;
+	QString channel2;
+	double value; // Initial values, as getValue(), getValue2() and getStringValue()
+	double value2;
+	QString stringValue;
+	QString xml; // The bsbObject element as text, for saving without creating it
+	QDomElement element;
+};
+
+// Panel xml parsed away from the GUI thread. The Qt widgets are only
+// created from it when the panel is shown or the widgets are needed.
+struct WidgetPanelDescription
+{
+	WidgetPanelDescription() : valid(false), panelCount(0), generation(0) {}
+	bool valid;
+	int panelCount;
+	int generation; // WidgetLayout::m_panelGeneration when the parse started
+	QDomDocument doc;
+	QVector<QDomNode> properties; // Panel level nodes (geometry, bgcolor...)
+	QVector<WidgetDescriptor> widgets;
+};
+
+// A widget touched by an undo step. Empty xml means the widget does not
+// exist on that side of the step.
+struct WidgetHistoryChange
+{
+	QString uuid;
+	int oldIndex; // Position in the widget list before the step
+	int newIndex; // Position after the step
+	QString before;
+	QString after;
+};
+
+// Undo step holding only the widgets that changed since the previous one
+struct WidgetHistoryStep
+{
+	WidgetHistoryStep() : bytes(0) {}
+	QString panelBefore; // Panel properties, only set if they changed
+	QString panelAfter;
+	QVector<WidgetHistoryChange> changes;
+	int bytes;
+};
+
+class WidgetLayout : public QWidget, public FrameClient
 {
 	Q_OBJECT
 	Q_PROPERTY(bool openProperties READ getOpenProperties WRITE setOpenProperties) // To make sure only one properties dialog is displayed at any one time
@@ -72,7 +123,14 @@ public:
 	QString getCabbageWidgets();
 	bool openMidiPort(int port);
 	void closeMidiPort();
-	QVector<QuteWidget *> getWidgets() {return m_widgets;}
+	QVector<QuteWidget *> getWidgets() { ensureWidgets(); return m_widgets; }
+	// Creates the widgets of a panel loaded with loadXmlWidgets, if that has
+	// not happened yet. Does nothing when called from another thread.
+	void ensureWidgets();
+	bool widgetsPending() { return m_widgetsPending; }
+	// Channels and values of the widgets, read from the panel description
+	// while the widgets are pending, so this does not create them
+	QVector<WidgetDescriptor> getWidgetChannels();
 
 	// Data to/from widgets
 	void setValue(QString channelName, double value);
@@ -141,6 +199,7 @@ public:
 	void newCurve(Curve* curve);
 	void setCurveData(Curve *curve);
 	uintptr_t getCurveById(uintptr_t id);
+	qint64 curveMemoryUsage(); // Bytes used by the curves, including the pooled ones
 	void updateCurve(WINDAT *windat);
 	int killCurves(CSOUND *csound);
 	void clearGraphs(); // This also frees the memory allocated by curves.
@@ -197,6 +256,11 @@ public:
 	QAction *newPresetAct;
 	QAction *recallPresetAct;
 
+	// Control channels resolved by the engine at the start of a run. Values
+	// for those are published by id, other channels go through newValues
+	ChannelTable inputChannels;
+	// Widget channels interned by the engine for invalue/outvalue
+	ValueChannelTable valueChannels;
     // Value changes buffer to store all value changes from widgets that
     // have been triggered from the GUI
 	QHash<QString, double> newValues;
@@ -313,6 +377,7 @@ protected:
 	virtual void keyReleaseEvent(QKeyEvent *event);
 	virtual void contextMenuEvent(QContextMenuEvent *event);
     virtual void closeEvent(QCloseEvent *event);
+	virtual void showEvent(QShowEvent *event);
 	QRubberBand *selectionFrame;
 	int startx, starty;
 
@@ -321,10 +386,18 @@ private:
 	QMutex widgetsMutex;
 	QMutex layoutMutex;
 	QList<Curve *> newCurveBuffer;  // To store curves from Csound for widget panel Graph widgets
-	QVector<WINDAT> curveUpdateBuffer; // FIXME move these buffers to documentpage to avoid duplication when having multiple panels
-	int curveUpdateBufferCount;
+	DirtyList<Curve> m_dirtyCurves; // Curves with a new snapshot from Csound
+	// Curves of this run (in curves or newCurveBuffer), by caption and by id.
+	// These, newCurveBuffer and m_curvePool are protected by m_curveLock, as
+	// curves are created from the Csound thread.
+	QHash<QString, Curve *> m_curvesByCaption;
+	QSet<uintptr_t> m_curveIds;
+	QList<Curve *> m_curvePool;
+	QMutex m_curveLock;
+	Curve *takePooledCurve(size_t size);
+	void recycleCurve(Curve *curve);
 	QList<Curve *> curves;
-	QTimer updateTimer;
+	QElapsedTimer m_lastUpdate; // Time since the last updateData()
 
 	unsigned long m_ksmpscount;  // Ksmps counter for Csound engine (Really needed here?)
 
@@ -338,6 +411,7 @@ private:
 	bool m_repeatKeys;
 	bool m_xmlFormat;
 	bool m_trackMouse;
+	DirtyList<QuteWidget> m_dirtyWidgets; // Widgets with a new value to show
 	bool m_openProperties; // Open widget properties when creating widgets
 	bool m_enableEdit; // Enable editing and properties dialog
 	bool m_tooltips;  // Show widget tooltips
@@ -350,12 +424,18 @@ private:
 	QPoint currentPosition;  //TODO use proper variables instead of storing data in the widgets...
 	QCheckBox *bgCheckBox;
 	QPushButton *bgButton;
-	int closing; // to control timer when destroying this object
     // XXXX: flag to control updateData
     bool m_updating;
 
-	QVector<QString> m_history;  // Undo/ Redo history
-	int m_historyIndex; // Current point in history
+	QVector<WidgetHistoryStep> m_history;  // Undo/ Redo history
+	int m_historyIndex; // Number of steps in m_history currently applied
+	int m_historyBytes; // Kept under QCS_MAX_UNDO_BYTES
+	bool m_historyValid; // m_historyState holds the last marked state
+	bool m_historyMarkPending; // markHistory() called while the widgets were pending
+	QString m_historyPanel; // Last marked state
+	QStringList m_historyOrder;
+	QHash<QString, QString> m_historyState; // Widget xml by uuid
+	QSet<QString> m_historyTouched; // Uuids of widgets changed since the last mark
 	bool m_modified;
 	bool m_editMode;
 	//    QString m_clipboard;
@@ -380,6 +460,24 @@ private:
 	int m_activeWidgets; // Keeps a number of widgets that can be currently accessed by value callbacks (e.g. set to 0 during paste). This is done to avoid locking the callbacks, which are called from a realtime thread
 
 	int parseXmlNode(QDomNode node);
+	static WidgetPanelDescription describePanel(QString xmlWidgets, int generation);
+	void ensurePanelParsed();
+
+	// Panel loaded by loadXmlWidgets whose widgets have not been created
+	QFutureWatcher<WidgetPanelDescription> m_panelWatcher;
+	WidgetPanelDescription m_pendingPanel;
+	QString m_pendingXml;
+	bool m_panelParsePending; // m_panelWatcher result not applied yet
+	std::atomic<bool> m_widgetsPending; // m_pendingPanel widgets not created yet, read from any thread
+	int m_panelGeneration; // Changed when the layout is cleared, older parses are dropped
+	// Channel values of the pending widgets, for invalue (m_indexLock)
+	QHash<QString, double> m_pendingValues;
+	QHash<QString, QString> m_pendingStrings;
+	// Values sent to the pending widgets, set once they are created (m_indexLock)
+	QHash<QString, double> m_pendingOutputs;
+	QHash<QString, QString> m_pendingStringOutputs;
+	void storePendingValue(const QString &channel, double value);
+	void storePendingValue(const QString &channel, const QString &value);
 	QString createSlider(int x, int y, int width, int height, QString widgetLine);
 	QString createText(int x, int y, int width, int height, QString widgetLine);
 	QString createScrollNumber(int x, int y, int width, int height, QString widgetLine);
@@ -405,8 +503,52 @@ private:
 	void unregisterWidgetController(QuteWidget *widget);
 	void clearWidgetControllers();
 
+	// Store a value to be read by chnget
+	void storeNewValue(const QString &channel, double value);
+
+	// Widget lookup by channel, second channel and uuid. Kept in sync by
+	// registerWidget(), deleteWidget() and the widgets' channelsChanged()
+	// signal. The value callbacks read it from the performance thread, so
+	// it is protected by m_indexLock instead of widgetsMutex. Widgets are
+	// only deleted with both locks held (widgetsMutex first), so pointers
+	// read from the index stay valid while either lock is kept.
+	struct WidgetKeys {
+		QString channel;
+		QString channel2;
+		QString uuid;
+	};
+	QHash<QString, QVector<QuteWidget *> > m_channelIndex;
+	QHash<QString, QVector<QuteWidget *> > m_channel2Index;
+	QHash<QString, QuteWidget *> m_uuidIndex;
+	QHash<QuteWidget *, WidgetKeys> m_indexedKeys;
+	// Widgets bound to the _Mouse* channels, resolved when indexed. The
+	// values are indexes into the _MouseX, _MouseY, _MouseRelX, _MouseRelY,
+	// _MouseBut1, _MouseBut2 order, or -1 if the channel is not a mouse one.
+	struct MouseBinding {
+		QuteWidget *widget;
+		int value;
+		int value2;
+	};
+	QVector<MouseBinding> m_mouseBindings;
+	int m_mouseValues[6]; // Last values sent to the bound widgets
+	bool m_mouseValuesStale; // Send them on the next refresh even if unchanged
+	QReadWriteLock m_indexLock;
+	void indexWidget(QuteWidget *widget);
+	void unindexWidget(QuteWidget *widget);
+	void removeFromIndex(QuteWidget *widget); // m_indexLock held for writing
+	QuteWidget *firstActive(const QVector<QuteWidget *> &widgets); // m_indexLock held
+	QVector<QuteWidget *> widgetsForChannel(const QString &channel);
+	QVector<QuteWidget *> widgetsForChannel2(const QString &channel);
+	QVector<QuteWidget *> widgetsForId(const QString &widgetid); // uuid or channel
+
 	//Undo history
 	void clearHistory();
+	QString getPanelPropertiesText();
+	void setPanelPropertiesText(QString xml);
+	void pushHistoryStep(WidgetHistoryStep &step);
+	void applyHistoryStep(const WidgetHistoryStep &step, bool undo);
+	void removeHistoryWidget(QuteWidget *widget);
+	void restoreHistoryWidget(const QString &xml, int index);
 
 	// Preset Methods
 	int getPresetIndex(int number);
@@ -416,8 +558,14 @@ private:
 
     QHash<QString, QuteWidgetType> m_widgetNameToType;
 
-private slots:
+	// FrameClient
+	bool frameVisible();
+	void updateFrame();
 	void updateData();
+
+private slots:
+	void panelParsed();
+	void reindexWidget(QuteWidget *widget);
 	void widgetSelected(QuteWidget *widget);
 	void widgetUnselected(QuteWidget *widget);
 